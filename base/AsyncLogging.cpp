@@ -11,7 +11,7 @@ AsyncLogging::AsyncLogging(std::string logFileName_, int flushInterval)
       running_(false),
       basename_(logFileName_),
       thread_(std::bind(&AsyncLogging::threadFunc, this), "Logging"),
-      mutex_(),
+      mutex_("AsyncLogging"),
       cond_(mutex_),
       currentBuffer_(new Buffer),
       nextBuffer_(new Buffer),
@@ -1,21 +1,51 @@
 #include "Condition.h"
 
-#include <errno.h>
-
 // returns true if time out, false otherwise.
 bool Condition::waitForSeconds(double seconds)
 {
-  struct timespec abstime;
-  // FIXME: use CLOCK_MONOTONIC or CLOCK_MONOTONIC_RAW to prevent time rewind.
-  clock_gettime(CLOCK_REALTIME, &abstime);
-
+  // FUTEX_WAIT takes a relative timeout on CLOCK_MONOTONIC,
+  // setting the clock does not stretch or cut the wait
   const int64_t kNanoSecondsPerSecond = 1000000000;
   int64_t nanoseconds = static_cast<int64_t>(seconds * kNanoSecondsPerSecond);
+  if (nanoseconds < 0) nanoseconds = 0;
 
-  abstime.tv_sec += static_cast<time_t>((abstime.tv_nsec + nanoseconds) / kNanoSecondsPerSecond);
-  abstime.tv_nsec = static_cast<long>((abstime.tv_nsec + nanoseconds) % kNanoSecondsPerSecond);
+  struct timespec timeout;
+  timeout.tv_sec = static_cast<time_t>(nanoseconds / kNanoSecondsPerSecond);
+  timeout.tv_nsec = static_cast<long>(nanoseconds % kNanoSecondsPerSecond);
+  return waitFor(&timeout);
+}
 
-  MutexLock::UnassignGuard ug(mutex_);
-  return ETIMEDOUT == pthread_cond_timedwait(&pcond_, mutex_.getPthreadMutex(), &abstime);
+bool Condition::waitFor(const struct timespec* timeout)
+{
+  __atomic_add_fetch(&waiters_, 1, __ATOMIC_SEQ_CST);
+  // a notification after this read changes seq_, and the futex wait returns at once
+  int seq = __atomic_load_n(&seq_, __ATOMIC_SEQ_CST);
+  mutex_.unlock();
+  bool timedOut = !futex::wait(&seq_, seq, timeout);
+  mutex_.lockAfterWait();
+  mutex_.assignHolder();
+  __atomic_sub_fetch(&waiters_, 1, __ATOMIC_RELAXED);
+  return timedOut;
 }
 
+void Condition::notifyAll()
+{
+  int seq = __atomic_add_fetch(&seq_, 1, __ATOMIC_SEQ_CST);
+  int waiters = __atomic_load_n(&waiters_, __ATOMIC_SEQ_CST);
+  if (waiters == 0)
+  {
+    return;
+  }
+  // requeued waiters are woken by unlock(), which must find the lock contended;
+  // without holding the lock there may be no unlock() to come
+  if (waiters > 1 && mutex_.isLockedByThisThread())
+  {
+    __atomic_store_n(&mutex_.state_, 2, __ATOMIC_RELAXED);
+    if (futex::requeue(&seq_, 1, &mutex_.state_, seq))
+    {
+      return;
+    }
+    // another notification came in between, everyone is due to wake anyway
+  }
+  futex::wake(&seq_, INT_MAX);
+}
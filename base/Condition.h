@@ -1,27 +1,26 @@
 #pragma once
 
+#include "Futex.h"
 #include "MutexLock.h"
 
-#include <pthread.h>
-
+/*
+ * 基于futex的条件变量。seq_每次通知加一，等待者在seq_上休眠；没有等待者时notify()
+ * 不做系统调用。持有锁调用notifyAll()时只唤醒一个等待者，其余的用FUTEX_CMP_REQUEUE
+ * 转移到mutex的状态字上，随着锁的释放逐个唤醒，不会一起醒来争抢同一把锁。
+ */
 class Condition : noncopyable
 {
  public:
   explicit Condition(MutexLock& mutex)
-    : mutex_(mutex)
-  {
-    MCHECK(pthread_cond_init(&pcond_, NULL));
-  }
-
-  ~Condition()
+    : mutex_(mutex),
+      seq_(0),
+      waiters_(0)
   {
-    MCHECK(pthread_cond_destroy(&pcond_));
   }
 
   void wait()
   {
-    MutexLock::UnassignGuard ug(mutex_);//将mutex的holder_设为0，解除mutex_和线程的关系，wait调用完成再恢复
-    MCHECK(pthread_cond_wait(&pcond_, mutex_.getPthreadMutex()));
+    waitFor(NULL);
   }
 
   // returns true if time out, false otherwise.
@@ -29,16 +28,20 @@ class Condition : noncopyable
 
   void notify()
   {
-    MCHECK(pthread_cond_signal(&pcond_));
+    __atomic_add_fetch(&seq_, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&waiters_, __ATOMIC_SEQ_CST) > 0)
+    {
+      futex::wake(&seq_, 1);
+    }
   }
 
-  void notifyAll()
-  {
-    MCHECK(pthread_cond_broadcast(&pcond_));
-  }
+  void notifyAll();
 
  private:
+  bool waitFor(const struct timespec* timeout);
+
   MutexLock& mutex_;
-  pthread_cond_t pcond_;
+  int seq_;      // atomic, futex word, bumped by every notification
+  int waiters_;  // atomic
 };
 
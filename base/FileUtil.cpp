@@ -35,4 +35,20 @@ void AppendFile::flush() { fflush(fp_); }
 
 size_t AppendFile::write(const char* logline, size_t len) {
   return fwrite_unlocked(logline, 1, len, fp_);
-}
\ No newline at end of file
+}
+
+ReadOnlyFile::ReadOnlyFile(const string& filename)
+    : fd_(::open(filename.c_str(), O_RDONLY | O_CLOEXEC)), size_(0), modifyTime_(0) {
+  struct stat statbuf;
+  if (fd_ >= 0 && ::fstat(fd_, &statbuf) == 0 && S_ISREG(statbuf.st_mode)) {
+    size_ = statbuf.st_size;
+    modifyTime_ = statbuf.st_mtime;
+  } else if (fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+}
+
+ReadOnlyFile::~ReadOnlyFile() {
+  if (fd_ >= 0) ::close(fd_);
+}
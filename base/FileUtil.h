@@ -1,5 +1,7 @@
 #pragma once
 #include <string>
+#include <sys/types.h>
+#include <time.h>
 #include "noncopyable.h"
 
 
@@ -14,4 +16,22 @@ class AppendFile : noncopyable {
   size_t write(const char *logline, size_t len);
   FILE *fp_;
   char buffer_[64 * 1024];
-};
\ No newline at end of file
+};
+
+// 只读打开一个普通文件，供sendfile(2)零拷贝发送，析构时关闭fd
+class ReadOnlyFile : noncopyable {
+ public:
+  explicit ReadOnlyFile(const std::string& filename);
+  ~ReadOnlyFile();
+
+  // false if the file can't be opened or isn't a regular file
+  bool valid() const { return fd_ >= 0; }
+  int fd() const { return fd_; }
+  off_t size() const { return size_; }
+  time_t modifyTime() const { return modifyTime_; }
+
+ private:
+  int fd_;
+  off_t size_;
+  time_t modifyTime_;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+///
+/// Thin wrappers of the Linux futex(2) calls on a process private int.
+///
+namespace futex
+{
+
+  /// Sleeps while *addr == expected, until wake() or timeout.
+  /// @return false on timeout, true otherwise, including spurious wakeups
+  /// and *addr != expected on entry.
+  inline bool wait(int* addr, int expected, const struct timespec* timeout = NULL)
+  {
+    long ret = ::syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, expected, timeout, NULL, 0);
+    return ret == 0 || errno != ETIMEDOUT;
+  }
+
+  /// Wakes up to n threads sleeping in wait(addr).
+  /// @return the number of threads woken.
+  inline int wake(int* addr, int n)
+  {
+    return static_cast<int>(::syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0));
+  }
+
+  /// If *addr == expected, wakes up to n threads sleeping in wait(addr) and
+  /// moves all the others to sleep in wait(target) instead.
+  /// @return false if *addr != expected, nothing is done then.
+  inline bool requeue(int* addr, int n, int* target, int expected)
+  {
+    // the number to requeue goes where FUTEX_WAIT takes the timeout
+    return ::syscall(SYS_futex, addr, FUTEX_CMP_REQUEUE_PRIVATE, n,
+                     reinterpret_cast<void*>(static_cast<long>(INT_MAX)), target, expected) >= 0;
+  }
+
+}
@@ -0,0 +1,95 @@
+#include "Histogram.h"
+
+#include <math.h>
+
+const int Histogram::kSubBucketBits;
+const int Histogram::kMaxBits;
+
+Histogram::Histogram()
+  : counts_((kMaxBits - kSubBucketBits + 1) << kSubBucketBits),
+    count_(0),
+    sum_(0),
+    min_(UINT64_MAX),
+    max_(0)
+{
+}
+
+void Histogram::merge(const Histogram& rhs)
+{
+  for (size_t i = 0; i < counts_.size(); ++i)
+  {
+    counts_[i] += rhs.counts_[i];
+  }
+  count_ += rhs.count_;
+  sum_ += rhs.sum_;
+  if (rhs.min_ < min_) min_ = rhs.min_;
+  if (rhs.max_ > max_) max_ = rhs.max_;
+}
+
+void Histogram::reset()
+{
+  counts_.assign(counts_.size(), 0);
+  count_ = 0;
+  sum_ = 0;
+  min_ = UINT64_MAX;
+  max_ = 0;
+}
+
+double Histogram::stddev() const
+{
+  if (count_ == 0)
+  {
+    return 0.0;
+  }
+  // from the buckets, good to the precision of the histogram
+  double mu = mean();
+  double squares = 0.0;
+  for (size_t i = 0; i < counts_.size(); ++i)
+  {
+    if (counts_[i])
+    {
+      double d = static_cast<double>(upperBoundOf(i)) - mu;
+      squares += d * d * static_cast<double>(counts_[i]);
+    }
+  }
+  return sqrt(squares / static_cast<double>(count_));
+}
+
+uint64_t Histogram::percentile(double percentile) const
+{
+  if (count_ == 0)
+  {
+    return 0;
+  }
+  if (percentile <= 0.0)
+  {
+    return min_;
+  }
+  uint64_t rank = static_cast<uint64_t>(ceil(percentile / 100.0 * static_cast<double>(count_)));
+  if (rank < 1)
+  {
+    rank = 1;
+  }
+  uint64_t seen = 0;
+  for (size_t i = 0; i < counts_.size(); ++i)
+  {
+    seen += counts_[i];
+    if (seen >= rank)
+    {
+      uint64_t bound = upperBoundOf(i);
+      return bound < max_ ? bound : max_;
+    }
+  }
+  return max_;
+}
+
+uint64_t Histogram::upperBoundOf(size_t index)
+{
+  if (index < (1U << kSubBucketBits))
+  {
+    return index;
+  }
+  int shift = static_cast<int>(index >> kSubBucketBits) - 1;
+  uint64_t sub = index - (static_cast<uint64_t>(shift) << kSubBucketBits);
+  return ((sub + 1) << shift) - 1;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "copyable.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+///
+/// Log-linear histogram of non-negative integer values, such as latencies
+/// in nanoseconds, in the manner of HdrHistogram.
+///
+/// Values below 2^kSubBucketBits are counted exactly, each larger power of
+/// two is split into 2^kSubBucketBits buckets, so any value is reported
+/// within 1/2^kSubBucketBits of what was recorded. Values from 2^kMaxBits on
+/// fall into the last bucket. Recording is a few shifts and one increment.
+///
+/// Not thread safe, keep one per thread and merge() them for reporting.
+///
+class Histogram : public copyable
+{
+ public:
+  static const int kSubBucketBits = 6;
+  static const int kMaxBits = 40;
+
+  Histogram();
+
+  void record(uint64_t value)
+  {
+    ++counts_[indexOf(value)];
+    ++count_;
+    sum_ += value;
+    if (value < min_) min_ = value;
+    if (value > max_) max_ = value;
+  }
+
+  void merge(const Histogram& rhs);
+  void reset();
+
+  uint64_t count() const { return count_; }
+  uint64_t min() const { return count_ ? min_ : 0; }
+  uint64_t max() const { return max_; }
+  double mean() const
+  { return count_ ? static_cast<double>(sum_) / static_cast<double>(count_) : 0.0; }
+  double stddev() const;
+
+  /// The smallest recorded value that at least percentile% of the values
+  /// are not above, e.g. percentile(99.9), as the top of its bucket.
+  uint64_t percentile(double percentile) const;
+
+  /// Calls f(upperBound, count) for each non-empty bucket, in order.
+  template<typename F>
+  void forEachBucket(F f) const
+  {
+    for (size_t i = 0; i < counts_.size(); ++i)
+    {
+      if (counts_[i])
+      {
+        f(upperBoundOf(i), counts_[i]);
+      }
+    }
+  }
+
+ private:
+  static size_t indexOf(uint64_t value)
+  {
+    if (value < (1ULL << kSubBucketBits))
+    {
+      return static_cast<size_t>(value);
+    }
+    if (value >= (1ULL << kMaxBits))
+    {
+      value = (1ULL << kMaxBits) - 1;
+    }
+    int shift = 63 - __builtin_clzll(value) - kSubBucketBits;
+    return (static_cast<size_t>(shift) << kSubBucketBits) + static_cast<size_t>(value >> shift);
+  }
+
+  static uint64_t upperBoundOf(size_t index);
+
+  std::vector<uint64_t> counts_;
+  uint64_t count_;
+  uint64_t sum_;
+  uint64_t min_;
+  uint64_t max_;
+};
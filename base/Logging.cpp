@@ -46,8 +46,9 @@ void Logger::Impl::formatTime()//打印时间
     char str_t[26] = {0};
     gettimeofday (&tv, NULL);//不是系统调用，不会陷入内核
     time = tv.tv_sec;
-    struct tm* p_time = localtime(&time);   
-    strftime(str_t, 26, "%Y-%m-%d %H:%M:%S\n", p_time);
+    struct tm tm_time;
+    localtime_r(&time, &tm_time);//localtime()不是线程安全的，而且每次都重新读取时区并strdup
+    strftime(str_t, 26, "%Y-%m-%d %H:%M:%S\n", &tm_time);
     stream_ << str_t;
 }
 
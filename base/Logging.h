@@ -25,7 +25,7 @@ class Logger {
 
     LogStream stream_;
     int line_;
-    std::string basename_;
+    const char* basename_;  // __FILE__, a literal
   };
   Impl impl_;
   static std::string logFileName_;
@@ -0,0 +1,176 @@
+#include "MutexLock.h"
+#include "Futex.h"
+
+#include <algorithm>
+#include <set>
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace
+{
+
+// upper bound of spins before sleeping, about a microsecond
+const int kMaxSpins = 100;
+
+int maxSpins()
+{
+  // spinning only delays the holder when it waits for our CPU
+  static const int spins = ::sysconf(_SC_NPROCESSORS_ONLN) > 1 ? kMaxSpins : 0;
+  return spins;
+}
+
+int64_t nowNanos()
+{
+  struct timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+// named locks come and go with their owners, a collect() is rare
+struct Registry
+{
+  MutexLock mutex;  // unnamed, not registered itself
+  std::set<const MutexLock*> locks;
+};
+
+Registry& registry()
+{
+  // never destroyed, a named lock may be static too
+  static Registry* registry = new Registry;
+  return *registry;
+}
+
+}  // namespace
+
+MutexLock::MutexLock(const char* name)
+  : state_(0),
+    spins_(0),
+    holder_(0),
+    name_(name),
+    acquisitions_(0),
+    contended_(0),
+    waitNanos_(0)
+{
+  if (name_)
+  {
+    Registry& r = registry();
+    MutexLockGuard lock(r.mutex);
+    r.locks.insert(this);
+  }
+}
+
+MutexLock::~MutexLock()
+{
+  assert(holder_ == 0);
+  if (name_)
+  {
+    Registry& r = registry();
+    MutexLockGuard lock(r.mutex);
+    r.locks.erase(this);
+  }
+}
+
+/*
+ * 自旋上限取最近成功自旋次数均值的两倍加10，自旋成功时均值向这次的次数靠拢，
+ * 失败时向0衰减：持有者通常很快释放的锁多自旋，总要休眠的锁少自旋。
+ * 休眠前把状态字置为2，解锁的线程看到2才需要futex唤醒。
+ */
+void MutexLock::lockContended()
+{
+  const int64_t start = nowNanos();
+  const int limit = std::min(maxSpins(), 2 * __atomic_load_n(&spins_, __ATOMIC_RELAXED) + 10);
+  bool acquired = false;
+  int n = 0;
+  for (; n < limit && !acquired; ++n)
+  {
+    cpuRelax();
+    int unlocked = 0;
+    acquired = __atomic_load_n(&state_, __ATOMIC_RELAXED) == 0
+        && __atomic_compare_exchange_n(&state_, &unlocked, 1, false,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+  }
+  if (limit > 0)
+  {
+    int spins = __atomic_load_n(&spins_, __ATOMIC_RELAXED);
+    __atomic_store_n(&spins_, spins + ((acquired ? n : 0) - spins) / 8, __ATOMIC_RELAXED);
+  }
+  if (!acquired)
+  {
+    while (__atomic_exchange_n(&state_, 2, __ATOMIC_ACQUIRE) != 0)
+    {
+      futex::wait(&state_, 2);
+    }
+  }
+  increment(&contended_, 1);
+  increment(&waitNanos_, nowNanos() - start);
+}
+
+/*
+ * 被Condition::notifyAll()转移到state_上等待的线程被唤醒后，可能还有其他线程在state_上
+ * 等待，所以总以2加锁，保证解锁时唤醒下一个。
+ */
+void MutexLock::lockAfterWait()
+{
+  if (__atomic_exchange_n(&state_, 2, __ATOMIC_ACQUIRE) != 0)
+  {
+    const int64_t start = nowNanos();
+    do
+    {
+      futex::wait(&state_, 2);
+    }
+    while (__atomic_exchange_n(&state_, 2, __ATOMIC_ACQUIRE) != 0);
+    increment(&contended_, 1);
+    increment(&waitNanos_, nowNanos() - start);
+  }
+  increment(&acquisitions_, 1);
+}
+
+void MutexLock::wakeOne()
+{
+  futex::wake(&state_, 1);
+}
+
+MutexLock::Stats MutexLock::stats() const
+{
+  Stats stats = { name_,
+                  __atomic_load_n(&acquisitions_, __ATOMIC_RELAXED),
+                  __atomic_load_n(&contended_, __ATOMIC_RELAXED),
+                  __atomic_load_n(&waitNanos_, __ATOMIC_RELAXED) };
+  return stats;
+}
+
+void MutexLock::collect(std::vector<Stats>* stats)
+{
+  size_t first = stats->size();
+  Registry& r = registry();
+  MutexLockGuard lock(r.mutex);
+  for (std::set<const MutexLock*>::const_iterator it = r.locks.begin();
+       it != r.locks.end(); ++it)
+  {
+    Stats s = (*it)->stats();
+    size_t i = first;
+    while (i < stats->size() && strcmp((*stats)[i].name, s.name) != 0)
+    {
+      ++i;
+    }
+    if (i == stats->size())
+    {
+      stats->push_back(s);
+    }
+    else
+    {
+      (*stats)[i].acquisitions += s.acquisitions;
+      (*stats)[i].contended += s.contended;
+      (*stats)[i].waitNanos += s.waitNanos;
+    }
+  }
+}
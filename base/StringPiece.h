@@ -0,0 +1,70 @@
+#pragma once
+
+#include "copyable.h"
+
+#include <string.h>
+#include <string>
+
+/// A non-owning reference to a contiguous range of chars, modeled after
+/// muduo/pcre's StringPiece.
+///
+/// The referenced memory must outlive the StringPiece.
+class StringPiece : public copyable
+{
+ public:
+  StringPiece()
+    : ptr_(NULL), length_(0) { }
+  StringPiece(const char* str)
+    : ptr_(str), length_(static_cast<int>(strlen(str))) { }
+  StringPiece(const std::string& str)
+    : ptr_(str.data()), length_(static_cast<int>(str.size())) { }
+  StringPiece(const char* offset, int len)
+    : ptr_(offset), length_(len) { }
+
+  const char* data() const { return ptr_; }
+  int size() const { return length_; }
+  bool empty() const { return length_ == 0; }
+  const char* begin() const { return ptr_; }
+  const char* end() const { return ptr_ + length_; }
+
+  void clear() { ptr_ = NULL; length_ = 0; }
+  void set(const char* buffer, int len) { ptr_ = buffer; length_ = len; }
+
+  char operator[](int i) const { return ptr_[i]; }
+
+  void remove_prefix(int n)
+  {
+    ptr_ += n;
+    length_ -= n;
+  }
+
+  void remove_suffix(int n)
+  {
+    length_ -= n;
+  }
+
+  bool operator==(const StringPiece& x) const
+  {
+    return ((length_ == x.length_) &&
+            (memcmp(ptr_, x.ptr_, length_) == 0));
+  }
+
+  bool operator!=(const StringPiece& x) const
+  {
+    return !(*this == x);
+  }
+
+  bool starts_with(const StringPiece& x) const
+  {
+    return ((length_ >= x.length_) && (memcmp(ptr_, x.ptr_, x.length_) == 0));
+  }
+
+  std::string as_string() const
+  {
+    return std::string(data(), size());
+  }
+
+ private:
+  const char* ptr_;
+  int length_;
+};
@@ -1,14 +1,65 @@
 #include "ThreadPool.h"
+#include "Futex.h"
+#include "WorkStealingDeque.h"
 
+#include <algorithm>
 #include <assert.h>
+#include <sched.h>
 #include <stdio.h>
 
+struct ThreadPool::Job
+{
+  Job(Task&& f, Priority p, Timestamp d)
+    : task(std::move(f)),
+      priority(p),
+      deadline(d)
+  {
+  }
+
+  Task task;
+  Priority priority;
+  Timestamp deadline;  // invalid for none
+};
+
+struct ThreadPool::Worker
+{
+  Worker(ThreadPool* p, uint32_t s)
+    : pool(p),
+      seed(s),
+      wakeup(0),
+      sinceLow(0)
+  {
+  }
+
+  ThreadPool* pool;
+  WorkStealingDeque<Job> tasks[kNumPriorities];
+  std::unique_ptr<Thread> thread;
+  uint32_t seed;  // xorshift state for picking victims
+  int wakeup;     // futex word, set to 1 by notify() to end park()
+  int sinceLow;   // kHigh tasks taken since the last kLow one
+};
+
+__thread ThreadPool::Worker* ThreadPool::t_worker = NULL;
+
+namespace
+{
+  // most tasks a worker moves from the injection queue at once
+  const size_t kMaxBatch = 32;
+  // times an idle worker yields and looks again before parking
+  const int kSpins = 4;
+}
+
 ThreadPool::ThreadPool(const string& nameArg)
-  : mutex_(),
-    notEmpty_(mutex_),
+  : mutex_("ThreadPool"),
     notFull_(mutex_),
     name_(nameArg),
+    numInjected_(),
     maxQueueSize_(0),
+    pending_(0),
+    idleMutex_("ThreadPool.idle"),
+    numParked_(0),
+    numLow_(0),
+    numExpired_(0),
     running_(false)
 {
 }
@@ -19,20 +70,26 @@ ThreadPool::~ThreadPool()
   {
     stop();
   }
+  drain();  // anything run() raced in with stop()
 }
 
 void ThreadPool::start(int numThreads)
 {
-  assert(threads_.empty());
+  assert(workers_.empty());
   running_ = true;
-  threads_.reserve(numThreads);
+  workers_.reserve(numThreads);
+  // all workers exist before any of them looks for a victim
+  for (int i = 0; i < numThreads; ++i)
+  {
+    workers_.emplace_back(new Worker(this, 2654435761u * (i + 1)));
+  }
   for (int i = 0; i < numThreads; ++i)
   {
     char id[32];
     snprintf(id, sizeof id, "%d", i+1);
-    threads_.emplace_back(new Thread(
-          std::bind(&ThreadPool::runInThread, this), name_+id));//将runInThread绑定到thread，注册回调函数
-    threads_[i]->start();//启动线程，调用回调函数runInThread，也就是处理task
+    workers_[i]->thread.reset(new Thread(
+          std::bind(&ThreadPool::runInThread, this, workers_[i].get()), name_+id));//将runInThread绑定到thread，注册回调函数
+    workers_[i]->thread->start();//启动线程，调用回调函数runInThread，也就是处理task
   }
   if (numThreads == 0 && threadInitCallback_)
   {
@@ -42,36 +99,52 @@ void ThreadPool::start(int numThreads)
 
 /*
  * stop 线程池过程
- * 先将running_设置为false，然后调用notifyAll，激活所有等待的线程,
- * 关闭所有的条件等待,线程退出.
+ * 先将running_设置为false，然后唤醒所有在futex上休眠的工作线程和阻塞在run()中的线程,
+ * 线程退出后释放还没有执行的任务.
  */
 void ThreadPool::stop()
 {
   {
   MutexLockGuard lock(mutex_);
-  running_ = false;
-  notEmpty_.notifyAll();////激活所有的线程
+  __atomic_store_n(&running_, false, __ATOMIC_RELEASE);
   notFull_.notifyAll();
   }
-  for (auto& thr : threads_)
+  while (__atomic_load_n(&numParked_, __ATOMIC_SEQ_CST) > 0)
+  {
+    notify();//激活所有休眠的线程
+  }
+  for (auto& w : workers_)
   {
-    thr->join();//回收停止运行的线程
+    w->thread->join();//回收停止运行的线程
   }
+  drain();
 }
 
 size_t ThreadPool::queueSize() const
 {
   MutexLockGuard lock(mutex_);
-  return queue_.size();
+  size_t size = 0;
+  for (int p = 0; p < kNumPriorities; ++p)
+  {
+    size += injected_[p].size();
+    for (auto& w : workers_)
+    {
+      size += static_cast<size_t>(w->tasks[p].size());
+    }
+  }
+  return size;
 }
 
-void ThreadPool::run(Task task)//添加任务
+void ThreadPool::run(Task task, Priority priority, Timestamp deadline)//添加任务
 {
-  if (threads_.empty())
+  if (workers_.empty())
   {
     task();
+    return;
   }
-  else
+  if (!running()) return;
+
+  if (maxQueueSize_ > 0)
   {
     MutexLockGuard lock(mutex_);
     while (isFull() && running_)
@@ -80,54 +153,281 @@ void ThreadPool::run(Task task)//添加任务
     }
     if (!running_) return;//这里注意，退出while循环后，需要再判断一次bool变量，
     //因为未必是条件满足了，可能是线程池需要退出，调整了running_变量
-    assert(!isFull());
+    ++pending_;
+  }
 
-    queue_.push_back(std::move(task));
-    notEmpty_.notify();
+  Job* job = new Job(std::move(task), priority, deadline);
+  if (priority == kLow)
+  {
+    __atomic_add_fetch(&numLow_, 1, __ATOMIC_SEQ_CST);  // before anyone can take it
+  }
+  Worker* self = t_worker;
+  if (self != NULL && self->pool == this)
+  {
+    self->tasks[priority].push(job);  // spawned by a task, stays on this worker unless stolen
+  }
+  else
+  {
+    MutexLockGuard lock(mutex_);
+    injected_[priority].push_back(job);
+    __atomic_store_n(&numInjected_[priority], injected_[priority].size(), __ATOMIC_RELAXED);
   }
+  notify();
 }
 
-ThreadPool::Task ThreadPool:: take()//取走任务
+/*
+ * 没有线程休眠时run()不加锁也不做系统调用，有线程休眠时从idle_中取出最近休眠的线程，
+ * 只唤醒它一个，已被唤醒、尚未运行的线程不会再收到唤醒。
+ */
+void ThreadPool::notify()
 {
-  MutexLockGuard lock(mutex_);
-  // always use a while-loop, due to spurious wakeup
-  while (queue_.empty() && running_)
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&numParked_, __ATOMIC_RELAXED) == 0)
   {
-    notEmpty_.wait();
+    return;
   }
-  Task task;
-  if (!queue_.empty())
+  Worker* worker = NULL;
+  {
+    MutexLockGuard lock(idleMutex_);
+    if (!idle_.empty())
+    {
+      worker = idle_.back();
+      idle_.pop_back();
+      __atomic_sub_fetch(&numParked_, 1, __ATOMIC_RELAXED);
+      __atomic_store_n(&worker->wakeup, 1, __ATOMIC_RELEASE);
+    }
+  }
+  if (worker != NULL)
+  {
+    futex::wake(&worker->wakeup, 1);
+  }
+}
+
+ThreadPool::Job* ThreadPool::take(Worker* self)//取走任务
+{
+  while (running())
+  {
+    Job* job = findTask(self);
+    // give producers a chance before sleeping, a wakeup costs two context switches
+    for (int i = 0; i < kSpins && job == NULL; ++i)
+    {
+      sched_yield();
+      job = findTask(self);
+    }
+    if (job == NULL)
+    {
+      job = park(self);
+    }
+    if (job != NULL)
+    {
+      return job;
+    }
+  }
+  return NULL;
+}
+
+/*
+ * 先登记到idle_并增加numParked_，再检查一次队列：与notify()中先放入任务再读numParked_
+ * 配对，中间各有一次全屏障，要么notify()看到这个线程并唤醒它，要么这个线程在休眠前
+ * 看到了新任务。
+ */
+ThreadPool::Job* ThreadPool::park(Worker* self)
+{
+  {
+    MutexLockGuard lock(idleMutex_);
+    __atomic_store_n(&self->wakeup, 0, __ATOMIC_RELAXED);
+    idle_.push_back(self);
+    __atomic_add_fetch(&numParked_, 1, __ATOMIC_SEQ_CST);
+  }
+  Job* job = findTask(self);
+  if (job == NULL && running())
+  {
+    while (__atomic_load_n(&self->wakeup, __ATOMIC_ACQUIRE) == 0)
+    {
+      futex::wait(&self->wakeup, 0);
+    }
+    return NULL;
+  }
+
+  MutexLockGuard lock(idleMutex_);
+  std::vector<Worker*>::iterator it = std::find(idle_.begin(), idle_.end(), self);
+  if (it != idle_.end())
   {
-    task = queue_.front();
-    queue_.pop_front();
-    if (maxQueueSize_ > 0)
+    idle_.erase(it);
+    __atomic_sub_fetch(&numParked_, 1, __ATOMIC_RELAXED);
+  }
+  // else a notify() picked this worker already, which is awake anyway
+  return job;
+}
+
+/*
+ * 通常先找kHigh再找kLow的任务，连续取了kLowShare-1个kHigh任务后反过来先找kLow。
+ * 没有kLow任务排队时不去查看kLow的队列，只执行kHigh任务的线程池不为优先级多付开销。
+ */
+ThreadPool::Job* ThreadPool::findTask(Worker* self)
+{
+  // seq_cst for the check in park()
+  const bool anyLow = __atomic_load_n(&numLow_, __ATOMIC_SEQ_CST) > 0;
+  Job* job = NULL;
+  if (anyLow && self->sinceLow >= kLowShare - 1)
+  {
+    job = findTask(self, kLow);
+  }
+  if (job == NULL)
+  {
+    job = findTask(self, kHigh);
+  }
+  if (job == NULL && anyLow)
+  {
+    job = findTask(self, kLow);
+  }
+  if (job != NULL)
+  {
+    if (job->priority == kLow)
+    {
+      __atomic_sub_fetch(&numLow_, 1, __ATOMIC_RELAXED);
+      self->sinceLow = 0;
+    }
+    else
+    {
+      ++self->sinceLow;
+    }
+    taken();
+  }
+  return job;
+}
+
+/*
+ * 先从自己队列的底部取最近放入的任务，再从注入队列取，最后从随机选取的其他工作线程
+ * 队列顶部窃取最早放入的任务。
+ */
+ThreadPool::Job* ThreadPool::findTask(Worker* self, Priority priority)
+{
+  Job* job = self->tasks[priority].pop();
+  if (job == NULL)
+  {
+    job = takeInjected(self, priority);
+  }
+  if (job == NULL)
+  {
+    uint32_t x = self->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    self->seed = x;
+    const size_t n = workers_.size();
+    for (size_t i = 0; i < n && job == NULL; ++i)
     {
-      notFull_.notify();
+      Worker* victim = workers_[(x + i) % n].get();
+      if (victim != self)
+      {
+        job = victim->tasks[priority].steal();
+      }
     }
   }
-  return task;
+  return job;
+}
+
+/*
+ * 注入队列一次取走一批任务：第一个直接执行，其余按原顺序放入自己的队列，
+ * 减少对mutex_的争用，空闲的工作线程也能从这里窃取。
+ */
+ThreadPool::Job* ThreadPool::takeInjected(Worker* self, Priority priority)
+{
+  if (__atomic_load_n(&numInjected_[priority], __ATOMIC_SEQ_CST) == 0)
+  {
+    return NULL;
+  }
+  Job* job = NULL;
+  size_t batch = 0;
+  {
+    MutexLockGuard lock(mutex_);
+    std::deque<Job*>& injected = injected_[priority];
+    if (injected.empty())
+    {
+      return NULL;
+    }
+    job = injected.front();
+    injected.pop_front();
+    batch = std::min(injected.size() / workers_.size(), kMaxBatch);
+    // pushed newest first, so the owner pops them oldest first
+    for (size_t i = batch; i > 0; --i)
+    {
+      self->tasks[priority].push(injected[i-1]);
+    }
+    injected.erase(injected.begin(), injected.begin() + batch);
+    __atomic_store_n(&numInjected_[priority], injected.size(), __ATOMIC_RELAXED);
+  }
+  if (batch > 0)
+  {
+    notify();
+  }
+  return job;
+}
+
+void ThreadPool::taken()
+{
+  if (maxQueueSize_ > 0)
+  {
+    MutexLockGuard lock(mutex_);
+    --pending_;
+    notFull_.notify();
+  }
 }
 
 bool ThreadPool:: isFull() const
 {
   mutex_.assertLocked();
-  return maxQueueSize_ > 0 && queue_.size() >= maxQueueSize_;
+  return maxQueueSize_ > 0 && pending_ >= maxQueueSize_;
 }
 
-void ThreadPool::runInThread()//注册在Thread的回调函数，作用是从queue中take task
+// deletes the tasks never run, once no worker is left
+void ThreadPool::drain()
 {
+  MutexLockGuard lock(mutex_);
+  for (int p = 0; p < kNumPriorities; ++p)
+  {
+    for (auto& w : workers_)
+    {
+      while (Job* job = w->tasks[p].pop())
+      {
+        delete job;
+      }
+    }
+    for (size_t i = 0; i < injected_[p].size(); ++i)
+    {
+      delete injected_[p][i];
+    }
+    injected_[p].clear();
+    numInjected_[p] = 0;
+  }
+  numLow_ = 0;
+  pending_ = 0;
+}
+
+void ThreadPool::runInThread(Worker* self)//注册在Thread的回调函数，作用是取出task执行
+{
+  t_worker = self;
   try
   {
     if (threadInitCallback_)
     {
       threadInitCallback_();
     }
-    while (running_)
+    while (running())
     {
-      Task task(take());//阻塞直到有task添加到队列
-      if (task)
+      std::unique_ptr<Job> job(take(self));//没有task时在futex上休眠
+      if (!job)
+      {
+        continue;
+      }
+      if (job->deadline.valid() && job->deadline < Timestamp::now())
+      {
+        __atomic_add_fetch(&numExpired_, 1, __ATOMIC_RELAXED);
+      }
+      else
       {
-        task();
+        job->task();
       }
     }
   }
@@ -137,4 +437,3 @@ void ThreadPool::runInThread()//注册在Thread的回调函数，作用是从que
     throw; // rethrow
   }
 }
-
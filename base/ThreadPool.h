@@ -3,18 +3,41 @@
 #include "Condition.h"
 #include "MutexLock.h"
 #include "Thread.h"
+#include "Timestamp.h"
 
 #include <deque>
+#include <memory>
 #include <vector>
 #include <string>
 
 using namespace std;
 
+/*
+ * 工作窃取线程池：每个工作线程有自己的Chase-Lev双端队列，工作线程里调用run()的任务
+ * 压入本线程的队列，其他线程调用run()的任务进入全局的注入队列。空闲的工作线程依次
+ * 查看自己的队列、注入队列(一次取一批)，再从其他线程的队列顶部窃取，都没有任务时
+ * 在各自的futex上休眠。run()只在有线程休眠时才加锁唤醒，且每个任务只唤醒一个线程。
+ *
+ * 任务分两个优先级，每个优先级各有一组队列，工作线程总是先找kHigh的任务，
+ * 但连续执行kLowShare个kHigh任务后先找一次kLow，后台任务不会饿死。
+ * 带截止时间的任务在执行前检查，已过期的直接丢弃并计数。
+ */
 class ThreadPool : noncopyable
 {
  public:
   typedef std::function<void ()> Task;//我们使用了function，作为任务队列的任务元素
 
+  enum Priority
+  {
+    kHigh,  // latency sensitive, such as request handlers
+    kLow,   // background jobs
+    kNumPriorities
+  };
+
+  /// A worker takes a kLow task at least once every kLowShare tasks,
+  /// whenever there is one.
+  static const int kLowShare = 8;
+
   explicit ThreadPool(const string& nameArg = string("ThreadPool"));
   ~ThreadPool();
 
@@ -29,29 +52,57 @@ class ThreadPool : noncopyable
   const string& name() const
   { return name_; }
 
+  // approximate unless stopped
   size_t queueSize() const;
 
+  /// Tasks dropped because their deadline had passed when a worker took them.
+  int64_t numExpired() const
+  { return __atomic_load_n(&numExpired_, __ATOMIC_RELAXED); }
+
   // Could block if maxQueueSize > 0
   // Call after stop() will return immediately.
   // There is no move-only version of std::function in C++ as of C++14.
   // So we don't need to overload a const& and an && versions
   // as we do in (Bounded)BlockingQueue.
-  void run(Task f);
+  //
+  // f is dropped instead of run if a worker gets to it after deadline,
+  // unless deadline is invalid. Called without workers, f runs right away.
+  void run(Task f, Priority priority = kHigh, Timestamp deadline = Timestamp());
 
  private:
+  struct Job;
+  struct Worker;
+
   bool isFull() const;
-  void runInThread();
-  Task take();
+  bool running() const
+  { return __atomic_load_n(&running_, __ATOMIC_ACQUIRE); }
+  void runInThread(Worker* self);
+  Job* take(Worker* self);
+  Job* park(Worker* self);
+  Job* findTask(Worker* self);
+  Job* findTask(Worker* self, Priority priority);
+  Job* takeInjected(Worker* self, Priority priority);
+  void notify();
+  void taken();
+  void drain();
 
-  mutable MutexLock mutex_;//ThreadPool需要一把互斥锁和两个同步变量，实现同步与互斥
-  Condition notEmpty_ ;
+  mutable MutexLock mutex_;//保护注入队列和有界模式下的pending_
   Condition notFull_ ;
   string name_;
   Task threadInitCallback_;
-  std::vector<std::unique_ptr<Thread>> threads_;
-  std::deque<Task> queue_ ;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::deque<Job*> injected_[kNumPriorities];
+  size_t numInjected_[kNumPriorities];  // atomic, injected_[i].size() for lock free peeking
   size_t maxQueueSize_;
+  size_t pending_;      // tasks queued but not taken, kept only if maxQueueSize_ > 0
+  MutexLock idleMutex_;
+  std::vector<Worker*> idle_;  // parked workers not yet woken, guarded by idleMutex_
+  int numParked_;       // atomic, idle_.size()
+  int numLow_;          // atomic, kLow tasks queued
+  int64_t numExpired_;  // atomic
   bool running_;//判断线程池是否在工作
+
+  static __thread Worker* t_worker;  // of the pool whose worker this thread is
 };
 
 
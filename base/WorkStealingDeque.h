@@ -0,0 +1,160 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <vector>
+
+///
+/// Chase-Lev work-stealing deque of pointers, with the memory orderings of
+/// Lê, Pop, Cohen and Zappa Nardelli, "Correct and Efficient Work-Stealing
+/// for Weak Memory Models" (PPoPP 2013).
+///
+/// The owner thread push()es and pop()s at the bottom, LIFO, without any
+/// atomic read-modify-write except when taking the last element. Any other
+/// thread steal()s from the top, FIFO, with one CAS. The array doubles when
+/// full; old arrays are kept until destruction because a thief may still be
+/// reading one.
+///
+template<typename T>
+class WorkStealingDeque : noncopyable
+{
+ public:
+  explicit WorkStealingDeque(int64_t capacity = 256)
+    : top_(0),
+      bottom_(0),
+      array_(new Array(capacity))
+  {
+    assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+    garbage_.push_back(array_);
+  }
+
+  ~WorkStealingDeque()
+  {
+    for (size_t i = 0; i < garbage_.size(); ++i)
+    {
+      delete garbage_[i];
+    }
+  }
+
+  /// Owner thread only.
+  void push(T* x)
+  {
+    int64_t b = __atomic_load_n(&bottom_, __ATOMIC_RELAXED);
+    int64_t t = __atomic_load_n(&top_, __ATOMIC_ACQUIRE);
+    Array* a = __atomic_load_n(&array_, __ATOMIC_RELAXED);
+    if (b - t > a->mask)
+    {
+      a = grow(a, t, b);
+    }
+    a->put(b, x);
+    // the paper's release fence + relaxed store, written so that
+    // ThreadSanitizer, which ignores fences, sees the pairing with steal()
+    __atomic_store_n(&bottom_, b + 1, __ATOMIC_RELEASE);
+  }
+
+  /// Owner thread only.
+  /// @return NULL if empty.
+  T* pop()
+  {
+    int64_t b = __atomic_load_n(&bottom_, __ATOMIC_RELAXED) - 1;
+    Array* a = __atomic_load_n(&array_, __ATOMIC_RELAXED);
+    __atomic_store_n(&bottom_, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t t = __atomic_load_n(&top_, __ATOMIC_RELAXED);
+    T* x = NULL;
+    if (t <= b)
+    {
+      x = a->get(b);
+      if (t == b)
+      {
+        // the last one, race the thieves for it
+        if (!__atomic_compare_exchange_n(&top_, &t, t + 1, false,
+                                         __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+        {
+          x = NULL;
+        }
+        __atomic_store_n(&bottom_, b + 1, __ATOMIC_RELAXED);
+      }
+    }
+    else
+    {
+      __atomic_store_n(&bottom_, b + 1, __ATOMIC_RELAXED);
+    }
+    return x;
+  }
+
+  /// Any thread.
+  /// @return NULL if empty or another thread took the top element first.
+  T* steal()
+  {
+    int64_t t = __atomic_load_n(&top_, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t b = __atomic_load_n(&bottom_, __ATOMIC_ACQUIRE);
+    if (t < b)
+    {
+      Array* a = __atomic_load_n(&array_, __ATOMIC_ACQUIRE);
+      T* x = a->get(t);
+      if (!__atomic_compare_exchange_n(&top_, &t, t + 1, false,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+      {
+        return NULL;
+      }
+      return x;
+    }
+    return NULL;
+  }
+
+  /// Any thread, a snapshot that may be stale by the time it returns.
+  int64_t size() const
+  {
+    int64_t b = __atomic_load_n(&bottom_, __ATOMIC_RELAXED);
+    int64_t t = __atomic_load_n(&top_, __ATOMIC_RELAXED);
+    return b > t ? b - t : 0;
+  }
+
+ private:
+  struct Array
+  {
+    explicit Array(int64_t capacity)
+      : mask(capacity - 1),
+        slots(new T*[capacity])
+    {
+    }
+
+    ~Array()
+    {
+      delete[] slots;
+    }
+
+    T* get(int64_t i) const
+    { return __atomic_load_n(&slots[i & mask], __ATOMIC_RELAXED); }
+
+    void put(int64_t i, T* x)
+    { __atomic_store_n(&slots[i & mask], x, __ATOMIC_RELAXED); }
+
+    const int64_t mask;
+    T** const slots;
+  };
+
+  Array* grow(Array* a, int64_t t, int64_t b)
+  {
+    Array* bigger = new Array((a->mask + 1) * 2);
+    for (int64_t i = t; i < b; ++i)
+    {
+      bigger->put(i, a->get(i));
+    }
+    garbage_.push_back(bigger);
+    __atomic_store_n(&array_, bigger, __ATOMIC_RELEASE);
+    return bigger;
+  }
+
+  // top_ is written by thieves, bottom_ by the owner only
+  int64_t top_;
+  char pad1_[64 - sizeof(int64_t)];
+  int64_t bottom_;
+  char pad2_[64 - sizeof(int64_t)];
+  Array* array_;
+  std::vector<Array*> garbage_;  // every array ever used, owner only
+};
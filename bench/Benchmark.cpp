@@ -0,0 +1,229 @@
+#include "Benchmark.h"
+
+#include "../base/Timestamp.h"
+
+#include <algorithm>
+
+#include <math.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace
+{
+
+double nowSeconds()
+{
+  struct timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) * 1e-9;
+}
+
+double timeRun(Benchmark* benchmark, int64_t iterations)
+{
+  double start = nowSeconds();
+  benchmark->run(iterations);
+  return nowSeconds() - start;
+}
+
+double median(std::vector<double> values)
+{
+  std::sort(values.begin(), values.end());
+  size_t n = values.size();
+  return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+}  // namespace
+
+void BenchmarkSuite::add(const std::string& name, Benchmark* benchmark)
+{
+  names_.push_back(name);
+  benchmarks_.push_back(benchmark);
+}
+
+std::vector<BenchmarkSuite::Result> BenchmarkSuite::run(const Options& options)
+{
+  std::vector<Result> results;
+  for (size_t i = 0; i < benchmarks_.size(); ++i)
+  {
+    if (names_[i].find(options.filter) == std::string::npos)
+    {
+      continue;
+    }
+    results.push_back(measure(names_[i], &benchmarks_[i], options));
+    printText(std::vector<Result>(1, results.back()), stdout);
+    fflush(stdout);
+  }
+  return results;
+}
+
+BenchmarkSuite::Result BenchmarkSuite::measure(const std::string& name,
+                                               Benchmark* benchmark,
+                                               const Options& options)
+{
+  benchmark->setUp();
+
+  // threads started by setUp() keep the affinity they were created with
+  cpu_set_t saved;
+  bool pinned = false;
+  if (options.cpu >= 0 && ::sched_getaffinity(0, sizeof saved, &saved) == 0)
+  {
+    cpu_set_t one;
+    CPU_ZERO(&one);
+    CPU_SET(options.cpu, &one);
+    pinned = ::sched_setaffinity(0, sizeof one, &one) == 0;
+  }
+
+  // grows until a run takes a tenth of a sample, then scales up to a sample
+  int64_t iterations = 1;
+  double seconds = timeRun(benchmark, iterations);
+  while (seconds < options.sampleSeconds / 10)
+  {
+    iterations *= 2;
+    seconds = timeRun(benchmark, iterations);
+  }
+  iterations = std::max<int64_t>(1, static_cast<int64_t>(
+      static_cast<double>(iterations) * options.sampleSeconds / seconds));
+
+  timeRun(benchmark, iterations);  // warm up
+  std::vector<double> samples;
+  for (int i = 0; i < options.repetitions; ++i)
+  {
+    samples.push_back(timeRun(benchmark, iterations) * 1e9 / static_cast<double>(iterations));
+  }
+
+  if (pinned)
+  {
+    ::sched_setaffinity(0, sizeof saved, &saved);
+  }
+  benchmark->tearDown();
+
+  Result result;
+  result.name = name;
+  result.iterations = iterations;
+  result.repetitions = options.repetitions;
+  result.median = median(samples);
+  std::vector<double> deviations;
+  double sum = 0;
+  for (size_t i = 0; i < samples.size(); ++i)
+  {
+    deviations.push_back(fabs(samples[i] - result.median));
+    sum += samples[i];
+  }
+  result.mad = median(deviations);
+  result.mean = sum / static_cast<double>(samples.size());
+  double squares = 0;
+  for (size_t i = 0; i < samples.size(); ++i)
+  {
+    squares += (samples[i] - result.mean) * (samples[i] - result.mean);
+  }
+  result.stddev = samples.size() > 1
+      ? sqrt(squares / static_cast<double>(samples.size() - 1)) : 0;
+  result.min = *std::min_element(samples.begin(), samples.end());
+  result.max = *std::max_element(samples.begin(), samples.end());
+  return result;
+}
+
+void BenchmarkSuite::printText(const std::vector<Result>& results, FILE* out)
+{
+  for (size_t i = 0; i < results.size(); ++i)
+  {
+    const Result& r = results[i];
+    fprintf(out, "%-36s %12.2f ns/op  +-%5.1f%%  min %10.2f  max %10.2f  (%lld x %d)\n",
+            r.name.c_str(), r.median, r.median > 0 ? r.mad / r.median * 100 : 0.0,
+            r.min, r.max, static_cast<long long>(r.iterations), r.repetitions);
+  }
+}
+
+void BenchmarkSuite::writeJson(const std::vector<Result>& results,
+                               const Options& options,
+                               FILE* out)
+{
+  char host[256] = "unknown";
+  ::gethostname(host, sizeof host);
+  host[sizeof host - 1] = '\0';
+#ifdef NDEBUG
+  const char* build = "release";
+#else
+  const char* build = "debug";
+#endif
+  fprintf(out, "{\n");
+  fprintf(out, "  \"context\": {\"date\": \"%s\", \"host\": \"%s\", \"cpus\": %ld, "
+               "\"build\": \"%s\", \"compiler\": \"%s\", \"repetitions\": %d, "
+               "\"sample_seconds\": %g, \"cpu\": %d},\n",
+          Timestamp::now().toFormattedString(false).c_str(), host,
+          ::sysconf(_SC_NPROCESSORS_ONLN), build, __VERSION__,
+          options.repetitions, options.sampleSeconds, options.cpu);
+  fprintf(out, "  \"benchmarks\": [\n");
+  for (size_t i = 0; i < results.size(); ++i)
+  {
+    const Result& r = results[i];
+    fprintf(out, "    {\"name\": \"%s\", \"unit\": \"ns/op\", \"median\": %.3f, "
+                 "\"mad\": %.3f, \"mean\": %.3f, \"stddev\": %.3f, \"min\": %.3f, "
+                 "\"max\": %.3f, \"iterations\": %lld, \"repetitions\": %d}%s\n",
+            r.name.c_str(), r.median, r.mad, r.mean, r.stddev, r.min, r.max,
+            static_cast<long long>(r.iterations), r.repetitions,
+            i + 1 < results.size() ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+}
+
+bool BenchmarkSuite::readJson(const char* path, std::vector<Result>* results)
+{
+  FILE* fp = ::fopen(path, "r");
+  if (fp == NULL)
+  {
+    return false;
+  }
+  char line[4096];
+  while (::fgets(line, sizeof line, fp))
+  {
+    char name[256];
+    Result r;
+    long long iterations;
+    if (sscanf(line, " {\"name\": \"%255[^\"]\", \"unit\": \"ns/op\", \"median\": %lf, "
+                     "\"mad\": %lf, \"mean\": %lf, \"stddev\": %lf, \"min\": %lf, "
+                     "\"max\": %lf, \"iterations\": %lld, \"repetitions\": %d",
+               name, &r.median, &r.mad, &r.mean, &r.stddev, &r.min, &r.max,
+               &iterations, &r.repetitions) == 9)
+    {
+      r.name = name;
+      r.iterations = iterations;
+      results->push_back(r);
+    }
+  }
+  ::fclose(fp);
+  return true;
+}
+
+void BenchmarkSuite::printComparison(const std::vector<Result>& before,
+                                     const std::vector<Result>& after,
+                                     FILE* out)
+{
+  fprintf(out, "%-36s %12s %12s %8s\n", "benchmark", "before", "after", "change");
+  for (size_t i = 0; i < after.size(); ++i)
+  {
+    const Result* old = NULL;
+    for (size_t j = 0; j < before.size(); ++j)
+    {
+      if (before[j].name == after[i].name)
+      {
+        old = &before[j];
+        break;
+      }
+    }
+    if (old == NULL)
+    {
+      fprintf(out, "%-36s %12s %12.2f\n", after[i].name.c_str(), "-", after[i].median);
+      continue;
+    }
+    double change = old->median > 0 ? (after[i].median / old->median - 1) * 100 : 0;
+    // within three deviations of either run it is noise
+    double noise = 3 * std::max(old->mad, after[i].mad);
+    bool significant = fabs(after[i].median - old->median) > noise;
+    fprintf(out, "%-36s %12.2f %12.2f %+7.1f%%%s\n", after[i].name.c_str(),
+            old->median, after[i].median, change, significant ? "" : " ~");
+  }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+///
+/// One microbenchmark. run() performs the measured operation iterations
+/// times; setUp() and tearDown() around all samples are not timed.
+///
+class Benchmark : boost::noncopyable
+{
+ public:
+  virtual ~Benchmark() { }
+  virtual void setUp() { }
+  virtual void run(int64_t iterations) = 0;
+  virtual void tearDown() { }
+};
+
+/// Keeps the compiler from dropping a computation whose result is unused.
+template<typename T>
+inline void doNotOptimize(const T& value)
+{
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+///
+/// Runs benchmarks as a number of equally sized samples, after calibrating
+/// the iterations per sample to a target duration and discarding one warm up
+/// sample, and reports nanoseconds per operation as the median over samples
+/// with its median absolute deviation, which one slow sample doesn't move.
+///
+class BenchmarkSuite : boost::noncopyable
+{
+ public:
+  struct Options
+  {
+    Options()
+      : repetitions(10),
+        sampleSeconds(0.02),
+        cpu(-1)
+    { }
+
+    std::string filter;    // runs the names containing it, all if empty
+    int repetitions;       // samples per benchmark
+    double sampleSeconds;  // target duration of a sample
+    int cpu;               // pins the calling thread while sampling, -1 doesn't
+  };
+
+  struct Result
+  {
+    std::string name;
+    int64_t iterations;  // per sample
+    int repetitions;
+    // nanoseconds per operation, over samples
+    double median;
+    double mad;
+    double mean;
+    double stddev;
+    double min;
+    double max;
+  };
+
+  /// Takes ownership of benchmark.
+  void add(const std::string& name, Benchmark* benchmark);
+
+  std::vector<Result> run(const Options& options);
+
+  static void printText(const std::vector<Result>& results, FILE* out);
+  /// One benchmark per line, for readJson() and line-based diffs.
+  static void writeJson(const std::vector<Result>& results, const Options& options, FILE* out);
+  /// Reads back what writeJson() wrote.
+  static bool readJson(const char* path, std::vector<Result>* results);
+  /// Median of each benchmark in after against before.
+  static void printComparison(const std::vector<Result>& before,
+                              const std::vector<Result>& after,
+                              FILE* out);
+
+ private:
+  Result measure(const std::string& name, Benchmark* benchmark, const Options& options);
+
+  std::vector<std::string> names_;
+  boost::ptr_vector<Benchmark> benchmarks_;
+};
@@ -0,0 +1,675 @@
+// HTTP/1.1 load generator on this project's TcpClient and EventLoopThreadPool.
+//
+// Drives N connections spread over M IO threads against an HTTP server,
+// with keep-alive (default) or a new connection per request, a pipelining
+// depth, and a weighted mix of request paths. Reports throughput and a
+// log-linear latency histogram (base/Histogram) as percentiles.
+//
+// Closed loop (default): each connection keeps `depth` requests in flight
+// and sends a new one as soon as a response arrives, latency is measured
+// from the actual send.
+// Open loop (-R rate): requests are scheduled at a fixed total rate,
+// evenly over the connections, whether or not earlier ones were answered.
+// Latency is measured from the scheduled time, so a stalled server shows
+// up in the percentiles instead of merely slowing down the generator
+// (coordinated omission). Requests that are due while `depth` are already
+// in flight wait in the connection's backlog, still on the clock.
+//
+// usage: HttpLoad [options] ip port
+//   -c connections   total connections (10)
+//   -t threads       IO threads (1)
+//   -d seconds       measured duration (10)
+//   -w seconds       warm up before measuring (1)
+//   -p depth         pipelined requests in flight per connection (1)
+//   -R rate          open loop at rate requests/s in total, 0 for closed loop (0)
+//   -m path[:weight] add a path to the request mix, may repeat ("/")
+//   -n               no keep-alive, "Connection: close" and reconnect per request
+//   -H               also print the histogram buckets
+
+#include "../base/CountDownLatch.h"
+#include "../base/Histogram.h"
+#include "../base/Logging.h"
+#include "../reactor/EventLoop.h"
+#include "../reactor/EventLoopThreadPool.h"
+#include "../reactor/InetAddress.h"
+#include "../reactor/TcpClient.h"
+
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/weak_ptr.hpp>
+
+#include <deque>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace
+{
+
+struct Options
+{
+  Options()
+    : connections(10),
+      threads(1),
+      duration(10),
+      warmup(1),
+      depth(1),
+      rate(0),
+      keepAlive(true),
+      printBuckets(false)
+  { }
+
+  std::string ip;
+  uint16_t port;
+  int connections;
+  int threads;
+  double duration;
+  double warmup;
+  int depth;
+  double rate;
+  bool keepAlive;
+  bool printBuckets;
+};
+
+Options g_options;
+std::vector<std::string> g_requests;  // one per path of the mix
+std::vector<int> g_schedule;          // request indexes, repeated by weight
+int64_t g_measureStartNs;
+int64_t g_measureEndNs;
+
+int64_t nowNs()
+{
+  struct timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+bool inWindow(int64_t startNs, int64_t endNs)
+{
+  return startNs >= g_measureStartNs && endNs <= g_measureEndNs;
+}
+
+// counted in the loop thread of its Worker, merged after stopping
+struct Stats
+{
+  Stats()
+    : responses(0),
+      bytesRead(0),
+      non2xx(0),
+      connects(0),
+      dropped(0),
+      unfinished(0)
+  { }
+
+  void merge(const Stats& rhs)
+  {
+    latency.merge(rhs.latency);
+    responses += rhs.responses;
+    bytesRead += rhs.bytesRead;
+    non2xx += rhs.non2xx;
+    connects += rhs.connects;
+    dropped += rhs.dropped;
+    unfinished += rhs.unfinished;
+  }
+
+  Histogram latency;  // nanoseconds, of the requests started in the window
+  int64_t responses;   // completed in the window
+  int64_t bytesRead;
+  int64_t non2xx;
+  int64_t connects;
+  int64_t dropped;     // in flight when the connection closed
+  int64_t unfinished;  // due in the window but not answered by its end
+};
+
+class Session;
+typedef boost::shared_ptr<Session> SessionPtr;
+typedef boost::weak_ptr<Session> SessionWeakPtr;
+
+// one connection, used only in the loop thread of its Worker
+class Session : boost::noncopyable
+{
+ public:
+  Session(EventLoop* loop, const InetAddress& serverAddr, Stats* stats, int id)
+    : client_(loop, serverAddr),
+      stats_(stats),
+      next_(id % g_schedule.size()),
+      intervalNs_(0),
+      nextDueNs_(0),
+      connectStartNs_(0),
+      sentOnConnection_(0),
+      closing_(false),
+      inBody_(false),
+      untilClose_(false),
+      bodyRemaining_(0),
+      status_(0),
+      stopped_(false)
+  {
+    if (g_options.rate > 0)
+    {
+      intervalNs_ = static_cast<int64_t>(1e9 * g_options.connections / g_options.rate);
+      // spread the connections' schedules over one interval
+      nextDueNs_ = g_measureStartNs - static_cast<int64_t>(g_options.warmup * 1e9)
+                   + intervalNs_ * id / g_options.connections;
+    }
+  }
+
+  // binds weak pointers, a connection may outlive its session at shutdown
+  void start(const SessionPtr& self)
+  {
+    SessionWeakPtr weak(self);
+    client_.setConnectionCallback(boost::bind(&Session::onConnectionWeak, weak, _1));
+    client_.setMessageCallback(boost::bind(&Session::onMessageWeak, weak, _1, _2, _3));
+    client_.enableRetry();
+    connectStartNs_ = nowNs();
+    client_.connect();
+  }
+
+  void stop()
+  {
+    stopped_ = true;
+    for (size_t i = 0; i < inflight_.size(); ++i)
+    {
+      if (inflight_[i] >= g_measureStartNs && inflight_[i] <= g_measureEndNs)
+      {
+        ++stats_->unfinished;
+      }
+    }
+    for (size_t i = 0; i < backlog_.size(); ++i)
+    {
+      if (backlog_[i] >= g_measureStartNs && backlog_[i] <= g_measureEndNs)
+      {
+        ++stats_->unfinished;
+      }
+    }
+    client_.disconnect();
+  }
+
+  // open loop: queues the requests that became due, then sends what fits
+  void tick(int64_t now)
+  {
+    while (nextDueNs_ <= now)
+    {
+      backlog_.push_back(nextDueNs_);
+      nextDueNs_ += intervalNs_;
+    }
+    sendRequests(now);
+  }
+
+ private:
+  static void onConnectionWeak(const SessionWeakPtr& weak, const TcpConnectionPtr& conn)
+  {
+    SessionPtr session(weak.lock());
+    if (session)
+    {
+      session->onConnection(conn);
+    }
+  }
+
+  static void onMessageWeak(const SessionWeakPtr& weak,
+                            const TcpConnectionPtr& conn,
+                            Buffer* buf,
+                            Timestamp)
+  {
+    SessionPtr session(weak.lock());
+    if (session)
+    {
+      session->onMessage(conn, buf);
+    }
+    else
+    {
+      buf->retrieveAll();
+    }
+  }
+
+  void onConnection(const TcpConnectionPtr& conn)
+  {
+    if (stopped_)
+    {
+      return;
+    }
+    if (conn->connected())
+    {
+      conn_ = conn;
+      conn_->setTcpNoDelay(true);
+      sentOnConnection_ = 0;
+      closing_ = false;
+      ++stats_->connects;
+      sendRequests(nowNs());
+    }
+    else
+    {
+      if (untilClose_ && !inflight_.empty())
+      {
+        finishResponse(nowNs());
+      }
+      stats_->dropped += inflight_.size();
+      inflight_.clear();
+      inBody_ = false;
+      conn_.reset();
+      // the client reconnects right away
+      connectStartNs_ = nowNs();
+    }
+  }
+
+  void onMessage(const TcpConnectionPtr&, Buffer* buf)
+  {
+    // stats_ is being read by the main thread once stopped
+    if (stopped_)
+    {
+      buf->retrieveAll();
+      return;
+    }
+    int64_t now = nowNs();
+    if (inWindow(now, now))
+    {
+      stats_->bytesRead += buf->readableBytes();
+    }
+    while (buf->readableBytes() > 0)
+    {
+      if (!inBody_)
+      {
+        const char* end = static_cast<const char*>(
+            memmem(buf->peek(), buf->readableBytes(), "\r\n\r\n", 4));
+        if (end == NULL)
+        {
+          break;
+        }
+        parseHeaders(buf->peek(), end);
+        buf->retrieveUntil(end + 4);
+        inBody_ = true;
+      }
+      if (untilClose_)
+      {
+        buf->retrieveAll();
+        break;
+      }
+      size_t n = std::min(bodyRemaining_, buf->readableBytes());
+      buf->retrieve(n);
+      bodyRemaining_ -= n;
+      if (bodyRemaining_ > 0)
+      {
+        break;
+      }
+      finishResponse(now);
+    }
+    sendRequests(now);
+  }
+
+  void parseHeaders(const char* begin, const char* end)
+  {
+    status_ = 0;
+    if (end - begin > 12 && memcmp(begin, "HTTP/1.", 7) == 0)
+    {
+      status_ = atoi(begin + 9);
+    }
+    bool hasLength = false;
+    bool close = false;
+    bodyRemaining_ = 0;
+    const char* line = static_cast<const char*>(memchr(begin, '\n', end - begin));
+    while (line != NULL && line < end)
+    {
+      ++line;
+      if (end - line > 15 && strncasecmp(line, "Content-Length:", 15) == 0)
+      {
+        bodyRemaining_ = strtoul(line + 15, NULL, 10);
+        hasLength = true;
+      }
+      else if (end - line > 11 && strncasecmp(line, "Connection:", 11) == 0)
+      {
+        const char* value = line + 11;
+        while (*value == ' ') ++value;
+        close = strncasecmp(value, "close", 5) == 0;
+      }
+      line = static_cast<const char*>(memchr(line, '\n', end - line));
+    }
+    // the server closes after this response, the ones pipelined behind it are lost
+    closing_ = closing_ || close;
+    bool noBody = (status_ >= 100 && status_ < 200) || status_ == 204 || status_ == 304;
+    untilClose_ = !hasLength && !noBody && close;
+  }
+
+  void finishResponse(int64_t now)
+  {
+    inBody_ = false;
+    untilClose_ = false;
+    int64_t start = inflight_.front();
+    inflight_.pop_front();
+    if (inWindow(now, now))
+    {
+      ++stats_->responses;
+      if (status_ < 200 || status_ >= 300)
+      {
+        ++stats_->non2xx;
+      }
+    }
+    if (inWindow(start, now))
+    {
+      stats_->latency.record(now - start);
+    }
+  }
+
+  void sendRequests(int64_t now)
+  {
+    if (!conn_ || stopped_ || closing_)
+    {
+      return;
+    }
+    size_t capacity = static_cast<size_t>(g_options.depth);
+    if (!g_options.keepAlive)
+    {
+      capacity = sentOnConnection_ == 0 ? 1 : 0;
+    }
+    std::string batch;
+    while (inflight_.size() < capacity)
+    {
+      int64_t start;
+      if (intervalNs_ > 0)
+      {
+        if (backlog_.empty())
+        {
+          break;
+        }
+        start = backlog_.front();
+        backlog_.pop_front();
+      }
+      else
+      {
+        // a new connection per request counts the connect time
+        start = g_options.keepAlive ? now : connectStartNs_;
+      }
+      inflight_.push_back(start);
+      batch += g_requests[g_schedule[next_]];
+      next_ = (next_ + 1) % g_schedule.size();
+      ++sentOnConnection_;
+    }
+    if (!batch.empty())
+    {
+      // one write per batch, so pipelined requests share segments
+      conn_->send(batch);
+    }
+  }
+
+  TcpClient client_;
+  TcpConnectionPtr conn_;
+  Stats* stats_;
+  size_t next_;                  // position in g_schedule
+  int64_t intervalNs_;           // between scheduled requests, 0 for closed loop
+  int64_t nextDueNs_;
+  int64_t connectStartNs_;
+  size_t sentOnConnection_;
+  bool closing_;                 // the server said "Connection: close"
+  std::deque<int64_t> backlog_;  // scheduled, not sent yet
+  std::deque<int64_t> inflight_; // start times of the requests on the wire
+  // response being parsed
+  bool inBody_;
+  bool untilClose_;
+  size_t bodyRemaining_;
+  int status_;
+  bool stopped_;
+};
+
+// the sessions of one IO thread
+class Worker : boost::noncopyable
+{
+ public:
+  explicit Worker(EventLoop* loop)
+    : loop_(loop)
+  { }
+
+  EventLoop* getLoop() const { return loop_; }
+  Stats* stats() { return &stats_; }
+
+  void addSession(const SessionPtr& session) { sessions_.push_back(session); }
+
+  void start()
+  {
+    for (size_t i = 0; i < sessions_.size(); ++i)
+    {
+      sessions_[i]->start(sessions_[i]);
+    }
+    if (g_options.rate > 0)
+    {
+      timer_ = loop_->runEvery(0.0005, boost::bind(&Worker::tick, this));
+    }
+  }
+
+  void stop(CountDownLatch* latch)
+  {
+    if (g_options.rate > 0)
+    {
+      loop_->cancel(timer_);
+    }
+    for (size_t i = 0; i < sessions_.size(); ++i)
+    {
+      sessions_[i]->stop();
+    }
+    latch->countDown();
+  }
+
+  void destroy(CountDownLatch* latch)
+  {
+    sessions_.clear();
+    latch->countDown();
+  }
+
+ private:
+  void tick()
+  {
+    int64_t now = nowNs();
+    for (size_t i = 0; i < sessions_.size(); ++i)
+    {
+      sessions_[i]->tick(now);
+    }
+  }
+
+  EventLoop* loop_;
+  std::vector<SessionPtr> sessions_;
+  Stats stats_;
+  TimerId timer_;
+};
+
+void usage(const char* name)
+{
+  fprintf(stderr,
+          "usage: %s [-c connections] [-t threads] [-d seconds] [-w seconds]\n"
+          "       [-p depth] [-R rate] [-m path[:weight]]... [-n] [-H] ip port\n",
+          name);
+  exit(1);
+}
+
+void buildRequests(const std::vector<std::string>& mix)
+{
+  char host[64];
+  snprintf(host, sizeof host, "%s:%u", g_options.ip.c_str(), g_options.port);
+  for (size_t i = 0; i < mix.size(); ++i)
+  {
+    std::string path = mix[i];
+    int weight = 1;
+    size_t colon = path.rfind(':');
+    if (colon != std::string::npos)
+    {
+      weight = atoi(path.c_str() + colon + 1);
+      path.erase(colon);
+    }
+    std::string request = "GET " + path + " HTTP/1.1\r\nHost: " + host + "\r\n";
+    if (!g_options.keepAlive)
+    {
+      request += "Connection: close\r\n";
+    }
+    request += "\r\n";
+    g_requests.push_back(request);
+    // interleaved, so each connection sees the mix, not runs of one path
+    for (int w = 0; w < weight; ++w)
+    {
+      g_schedule.push_back(static_cast<int>(i));
+    }
+  }
+  // spread each path's slots over the schedule
+  std::vector<int> spread;
+  std::vector<int> left(g_requests.size());
+  for (size_t i = 0; i < g_schedule.size(); ++i)
+  {
+    ++left[g_schedule[i]];
+  }
+  while (spread.size() < g_schedule.size())
+  {
+    for (size_t i = 0; i < left.size(); ++i)
+    {
+      if (left[i] > 0)
+      {
+        spread.push_back(static_cast<int>(i));
+        --left[i];
+      }
+    }
+  }
+  g_schedule.swap(spread);
+}
+
+void printReport(const Stats& stats)
+{
+  const Histogram& latency = stats.latency;
+  printf("%.0f requests/s, %.2f MB/s read, %lld responses in %.1fs\n",
+         static_cast<double>(stats.responses) / g_options.duration,
+         static_cast<double>(stats.bytesRead) / g_options.duration / (1024 * 1024),
+         static_cast<long long>(stats.responses), g_options.duration);
+  printf("connects %lld, non-2xx %lld, dropped %lld, unfinished %lld\n",
+         static_cast<long long>(stats.connects),
+         static_cast<long long>(stats.non2xx),
+         static_cast<long long>(stats.dropped),
+         static_cast<long long>(stats.unfinished));
+  printf("latency (us) of %llu requests  min %.1f  mean %.1f  stddev %.1f  max %.1f\n",
+         static_cast<unsigned long long>(latency.count()),
+         latency.min() / 1e3, latency.mean() / 1e3, latency.stddev() / 1e3,
+         latency.max() / 1e3);
+  const double kPercentiles[] = { 50, 75, 90, 99, 99.9, 99.99, 99.999, 100 };
+  for (size_t i = 0; i < sizeof kPercentiles / sizeof kPercentiles[0]; ++i)
+  {
+    printf("  %8.3f%%  %10.1f\n", kPercentiles[i], latency.percentile(kPercentiles[i]) / 1e3);
+  }
+  if (g_options.printBuckets)
+  {
+    // value, count, cumulative fraction, like HdrHistogram's percentile output
+    struct Printer
+    {
+      explicit Printer(uint64_t total) : total(total), seen(0) { }
+      void operator()(uint64_t upperBound, uint64_t count)
+      {
+        seen += count;
+        printf("%12.3f %10llu %10.6f\n", upperBound / 1e3,
+               static_cast<unsigned long long>(count),
+               static_cast<double>(seen) / static_cast<double>(total));
+      }
+      uint64_t total;
+      uint64_t seen;
+    };
+    printf("%12s %10s %10s\n", "value(us)", "count", "fraction");
+    latency.forEachBucket(Printer(latency.count()));
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  std::vector<std::string> mix;
+  int opt;
+  while ((opt = getopt(argc, argv, "c:t:d:w:p:R:m:nH")) != -1)
+  {
+    switch (opt)
+    {
+      case 'c': g_options.connections = atoi(optarg); break;
+      case 't': g_options.threads = atoi(optarg); break;
+      case 'd': g_options.duration = atof(optarg); break;
+      case 'w': g_options.warmup = atof(optarg); break;
+      case 'p': g_options.depth = atoi(optarg); break;
+      case 'R': g_options.rate = atof(optarg); break;
+      case 'm': mix.push_back(optarg); break;
+      case 'n': g_options.keepAlive = false; break;
+      case 'H': g_options.printBuckets = true; break;
+      default: usage(argv[0]);
+    }
+  }
+  if (argc - optind != 2 || g_options.connections < 1 || g_options.threads < 1
+      || g_options.depth < 1 || g_options.duration <= 0)
+  {
+    usage(argv[0]);
+  }
+  g_options.ip = argv[optind];
+  g_options.port = static_cast<uint16_t>(atoi(argv[optind + 1]));
+  if (mix.empty())
+  {
+    mix.push_back("/");
+  }
+  buildRequests(mix);
+
+  printf("%d connections, %d threads, %s, depth %d, ",
+         g_options.connections, g_options.threads,
+         g_options.keepAlive ? "keep-alive" : "connection per request",
+         g_options.keepAlive ? g_options.depth : 1);
+  if (g_options.rate > 0)
+  {
+    printf("open loop at %.0f requests/s\n", g_options.rate);
+  }
+  else
+  {
+    printf("closed loop\n");
+  }
+
+  EventLoop loop;
+  EventLoopThreadPool pool(&loop);
+  pool.setThreadNum(g_options.threads);
+  pool.start();
+  std::vector<EventLoop*> loops(pool.getAllLoops());
+
+  g_measureStartNs = nowNs() + static_cast<int64_t>(g_options.warmup * 1e9);
+  g_measureEndNs = g_measureStartNs + static_cast<int64_t>(g_options.duration * 1e9);
+
+  InetAddress serverAddr(g_options.ip, g_options.port);
+  boost::ptr_vector<Worker> workers;
+  for (size_t i = 0; i < loops.size(); ++i)
+  {
+    workers.push_back(new Worker(loops[i]));
+  }
+  for (int i = 0; i < g_options.connections; ++i)
+  {
+    Worker& worker = workers[i % workers.size()];
+    worker.addSession(boost::make_shared<Session>(
+        worker.getLoop(), serverAddr, worker.stats(), i));
+  }
+  for (size_t i = 0; i < workers.size(); ++i)
+  {
+    workers[i].getLoop()->runInLoop(boost::bind(&Worker::start, &workers[i]));
+  }
+
+  int64_t remaining;
+  while ((remaining = g_measureEndNs - nowNs()) > 0)
+  {
+    ::usleep(static_cast<useconds_t>(std::min<int64_t>(remaining / 1000, 100 * 1000)));
+  }
+
+  CountDownLatch stopped(static_cast<int>(workers.size()));
+  for (size_t i = 0; i < workers.size(); ++i)
+  {
+    workers[i].getLoop()->runInLoop(boost::bind(&Worker::stop, &workers[i], &stopped));
+  }
+  stopped.wait();
+
+  Stats total;
+  for (size_t i = 0; i < workers.size(); ++i)
+  {
+    total.merge(*workers[i].stats());
+  }
+  printReport(total);
+
+  CountDownLatch destroyed(static_cast<int>(workers.size()));
+  for (size_t i = 0; i < workers.size(); ++i)
+  {
+    workers[i].getLoop()->runInLoop(boost::bind(&Worker::destroy, &workers[i], &destroyed));
+  }
+  destroyed.wait();
+}
@@ -0,0 +1,437 @@
+// Microbenchmarks of reactor, http and base primitives, see Benchmark.h for
+// how samples are taken. Build with -O2 -DNDEBUG for numbers worth keeping;
+// the JSON records which build produced it.
+//
+// usage: Microbench [-f filter] [-r repetitions] [-s sampleSeconds] [-a cpu] [-j out.json]
+//        Microbench -c before.json after.json
+
+#include "Benchmark.h"
+
+#include "../base/AsyncLogging.h"
+#include "../base/CountDownLatch.h"
+#include "../base/LogStream.h"
+#include "../http/HttpContext.h"
+#include "../http/HttpResponse.h"
+#include "../reactor/Buffer.h"
+#include "../reactor/EventLoop.h"
+#include "../reactor/EventLoopThread.h"
+#include "../reactor/Trace.h"
+
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+
+// a browser-like request
+const char kRequest[] =
+  "GET /api/items/12345?fields=name,price HTTP/1.1\r\n"
+  "Host: localhost:8000\r\n"
+  "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:120.0) Gecko/20100101 Firefox/120.0\r\n"
+  "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+  "Accept-Language: en-US,en;q=0.5\r\n"
+  "Accept-Encoding: gzip, deflate\r\n"
+  "Connection: keep-alive\r\n"
+  "Cookie: session=0123456789abcdef0123456789abcdef\r\n"
+  "Cache-Control: max-age=0\r\n"
+  "\r\n";
+
+class BufferAppend : public Benchmark
+{
+ public:
+  explicit BufferAppend(size_t size) : data_(size, 'x') { }
+
+  void run(int64_t iterations)
+  {
+    for (int64_t i = 0; i < iterations; ++i)
+    {
+      buffer_.append(data_.data(), data_.size());
+      if (buffer_.readableBytes() >= 1024 * 1024)
+      {
+        buffer_.retrieveAll();
+      }
+    }
+  }
+
+ private:
+  std::string data_;
+  Buffer buffer_;
+};
+
+class BufferFindCRLF : public Benchmark
+{
+ public:
+  explicit BufferFindCRLF(size_t lineLength)
+  {
+    std::string line(lineLength - 2, 'x');
+    line += "\r\n";
+    buffer_.append(line.data(), line.size());
+  }
+
+  void run(int64_t iterations)
+  {
+    for (int64_t i = 0; i < iterations; ++i)
+    {
+      const char* crlf = buffer_.findCRLF();
+      doNotOptimize(crlf);
+    }
+  }
+
+ private:
+  Buffer buffer_;
+};
+
+// includes the write(2) that makes the data readable
+class BufferReadFd : public Benchmark
+{
+ public:
+  explicit BufferReadFd(size_t size) : data_(size, 'x') { fds_[0] = fds_[1] = -1; }
+
+  void setUp()
+  {
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds_) < 0)
+    {
+      perror("socketpair");
+      abort();
+    }
+  }
+
+  void run(int64_t iterations)
+  {
+    int savedErrno = 0;
+    for (int64_t i = 0; i < iterations; ++i)
+    {
+      ssize_t n = ::write(fds_[0], data_.data(), data_.size());
+      doNotOptimize(n);
+      buffer_.readFd(fds_[1], &savedErrno);
+      buffer_.retrieveAll();
+    }
+  }
+
+  void tearDown()
+  {
+    ::close(fds_[0]);
+    ::close(fds_[1]);
+  }
+
+ private:
+  std::string data_;
+  Buffer buffer_;
+  int fds_[2];
+};
+
+// includes appending the request to the input buffer
+class ParseRequest : public Benchmark
+{
+ public:
+  void run(int64_t iterations)
+  {
+    Timestamp now(Timestamp::now());
+    for (int64_t i = 0; i < iterations; ++i)
+    {
+      buffer_.append(kRequest, sizeof kRequest - 1);
+      if (!context_.parseRequest(&buffer_, now) || !context_.gotAll())
+      {
+        fprintf(stderr, "HttpContext::parseRequest failed\n");
+        abort();
+      }
+      context_.reset();
+    }
+  }
+
+ private:
+  Buffer buffer_;
+  HttpContext context_;
+};
+
+class AppendResponse : public Benchmark
+{
+ public:
+  AppendResponse()
+    : response_(false)
+  {
+    response_.setStatusCode(HttpResponse::k200Ok);
+    response_.setContentType("application/json; charset=utf-8");
+    response_.addHeader("Cache-Control", "private, max-age=60");
+    response_.addHeader("Server", "WebServer");
+    response_.setBody("{\"id\":12345,\"name\":\"widget\",\"price\":9.99}");
+  }
+
+  void run(int64_t iterations)
+  {
+    for (int64_t i = 0; i < iterations; ++i)
+    {
+      response_.appendToBuffer(&buffer_);
+      buffer_.retrieveAll();
+    }
+  }
+
+ private:
+  HttpResponse response_;
+  Buffer buffer_;
+};
+
+void noop()
+{
+}
+
+class TimerAddCancel : public Benchmark
+{
+ public:
+  void setUp() { loop_.reset(new EventLoop); }
+
+  void run(int64_t iterations)
+  {
+    for (int64_t i = 0; i < iterations; ++i)
+    {
+      TimerId id = loop_->runAfter(1000, noop);
+      loop_->cancel(id);
+    }
+  }
+
+  void tearDown() { loop_.reset(); }
+
+ private:
+  boost::scoped_ptr<EventLoop> loop_;
+};
+
+// adds due timers, then loops until they have all run
+class TimerExpire : public Benchmark
+{
+ public:
+  TimerExpire() : remaining_(0) { }
+
+  void setUp() { loop_.reset(new EventLoop); }
+
+  void run(int64_t iterations)
+  {
+    remaining_ = iterations;
+    for (int64_t i = 0; i < iterations; ++i)
+    {
+      loop_->runAfter(0, boost::bind(&TimerExpire::expired, this));
+    }
+    loop_->loop();
+  }
+
+  void tearDown() { loop_.reset(); }
+
+ private:
+  void expired()
+  {
+    if (--remaining_ == 0)
+    {
+      loop_->quit();
+    }
+  }
+
+  boost::scoped_ptr<EventLoop> loop_;
+  int64_t remaining_;
+};
+
+// from this thread into a loop running in another
+class QueueInLoop : public Benchmark
+{
+ public:
+  QueueInLoop() : loop_(NULL), count_(0) { }
+
+  void setUp()
+  {
+    thread_.reset(new EventLoopThread);
+    loop_ = thread_->startLoop();
+  }
+
+  void run(int64_t iterations)
+  {
+    CountDownLatch latch(1);
+    for (int64_t i = 0; i < iterations; ++i)
+    {
+      loop_->queueInLoop(boost::bind(&QueueInLoop::increment, this));
+    }
+    loop_->queueInLoop(boost::bind(&CountDownLatch::countDown, &latch));
+    latch.wait();
+  }
+
+  void tearDown() { thread_.reset(); }
+
+ private:
+  void increment() { ++count_; }
+
+  boost::scoped_ptr<EventLoopThread> thread_;
+  EventLoop* loop_;
+  int64_t count_;
+};
+
+class LogStreamFormat : public Benchmark
+{
+ public:
+  void run(int64_t iterations)
+  {
+    std::string peer("127.0.0.1:54321");
+    for (int64_t i = 0; i < iterations; ++i)
+    {
+      stream_ << "TcpConnection " << peer << " fd " << static_cast<int>(i & 1023)
+              << " read " << i << " bytes in " << 0.000123 << " s";
+      doNotOptimize(stream_.buffer().length());
+      stream_.resetBuffer();
+    }
+  }
+
+ private:
+  LogStream stream_;
+};
+
+// the front end only, the back end thread writes to /dev/null
+class AsyncLoggingAppend : public Benchmark
+{
+ public:
+  explicit AsyncLoggingAppend(size_t length)
+    : line_(length - 1, 'x')
+  {
+    line_ += '\n';
+  }
+
+  void setUp()
+  {
+    logging_.reset(new AsyncLogging("/dev/null"));
+    logging_->start();
+  }
+
+  void run(int64_t iterations)
+  {
+    for (int64_t i = 0; i < iterations; ++i)
+    {
+      logging_->append(line_.data(), static_cast<int>(line_.size()));
+    }
+  }
+
+  void tearDown() { logging_.reset(); }
+
+ private:
+  std::string line_;
+  boost::scoped_ptr<AsyncLogging> logging_;
+};
+
+// one event into this thread's ring, with tracing on
+// uncontended, as on most acquisitions of the locks in queueInLoop() and AsyncLogging::append()
+class MutexLockUnlock : public Benchmark
+{
+ public:
+  MutexLockUnlock() : count_(0) { }
+
+  void run(int64_t iterations)
+  {
+    for (int64_t i = 0; i < iterations; ++i)
+    {
+      MutexLockGuard lock(mutex_);
+      ++count_;
+    }
+  }
+
+ private:
+  MutexLock mutex_;
+  int64_t count_;
+};
+
+class TraceRecord : public Benchmark
+{
+ public:
+  void setUp() { trace::setEnabled(true); }
+
+  void run(int64_t iterations)
+  {
+    for (int64_t i = 0; i < iterations; ++i)
+    {
+      trace::record(trace::kSend, static_cast<uint32_t>(i));
+    }
+  }
+
+  void tearDown() { trace::setEnabled(false); }
+};
+
+void usage(const char* name)
+{
+  fprintf(stderr,
+          "usage: %s [-f filter] [-r repetitions] [-s sampleSeconds] [-a cpu] [-j out.json]\n"
+          "       %s -c before.json after.json\n",
+          name, name);
+  exit(1);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  BenchmarkSuite::Options options;
+  const char* jsonPath = NULL;
+  bool compare = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "f:r:s:a:j:c")) != -1)
+  {
+    switch (opt)
+    {
+      case 'f': options.filter = optarg; break;
+      case 'r': options.repetitions = atoi(optarg); break;
+      case 's': options.sampleSeconds = atof(optarg); break;
+      case 'a': options.cpu = atoi(optarg); break;
+      case 'j': jsonPath = optarg; break;
+      case 'c': compare = true; break;
+      default: usage(argv[0]);
+    }
+  }
+
+  if (compare)
+  {
+    std::vector<BenchmarkSuite::Result> before, after;
+    if (argc - optind != 2
+        || !BenchmarkSuite::readJson(argv[optind], &before)
+        || !BenchmarkSuite::readJson(argv[optind + 1], &after))
+    {
+      usage(argv[0]);
+    }
+    BenchmarkSuite::printComparison(before, after, stdout);
+    return 0;
+  }
+  if (options.repetitions < 1 || options.sampleSeconds <= 0)
+  {
+    usage(argv[0]);
+  }
+
+  BenchmarkSuite suite;
+  suite.add("Buffer.append/16", new BufferAppend(16));
+  suite.add("Buffer.append/256", new BufferAppend(256));
+  suite.add("Buffer.append/4096", new BufferAppend(4096));
+  suite.add("Buffer.findCRLF/512", new BufferFindCRLF(512));
+  suite.add("Buffer.readFd/4096", new BufferReadFd(4096));
+  suite.add("HttpContext.parseRequest", new ParseRequest);
+  suite.add("HttpResponse.appendToBuffer", new AppendResponse);
+  suite.add("TimerQueue.addCancel", new TimerAddCancel);
+  suite.add("TimerQueue.addExpire", new TimerExpire);
+  suite.add("EventLoop.queueInLoop", new QueueInLoop);
+  suite.add("LogStream.format", new LogStreamFormat);
+  suite.add("AsyncLogging.append/128", new AsyncLoggingAppend(128));
+  suite.add("MutexLock.lockUnlock", new MutexLockUnlock);
+  suite.add("Trace.record", new TraceRecord);
+
+  std::vector<BenchmarkSuite::Result> results(suite.run(options));
+
+  if (jsonPath)
+  {
+    FILE* out = strcmp(jsonPath, "-") == 0 ? stdout : ::fopen(jsonPath, "w");
+    if (out == NULL)
+    {
+      perror(jsonPath);
+      return 1;
+    }
+    BenchmarkSuite::writeJson(results, options, out);
+    if (out != stdout)
+    {
+      ::fclose(out);
+    }
+  }
+}
@@ -0,0 +1,137 @@
+// Converts a dump of reactor/Trace.h to Chrome trace event JSON, for
+// about:tracing or ui.perfetto.dev.
+//
+// usage: TraceToJson trace.bin > trace.json
+
+#include "../reactor/Trace.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+struct TypeInfo
+{
+  const char* name;
+  char phase;         // 'B'egin, 'E'nd or 'i'nstant
+  const char* argName;
+};
+
+const TypeInfo kTypes[trace::kNumTypes] = {
+  { "epoll_wait", 'B', "timeout_ms" },
+  { "epoll_wait", 'E', "ready" },
+  { "handleEvent", 'B', "fd" },
+  { "handleEvent", 'E', "fd" },
+  { "functor", 'B', "index" },
+  { "functor", 'E', "index" },
+  { "timer", 'B', "sequence" },
+  { "timer", 'E', "sequence" },
+  { "send", 'i', "bytes" },
+  { "flush", 'i', "bytes" },
+  { "connection open", 'i', "fd" },
+  { "connection close", 'i', "fd" },
+};
+
+// thread names are ours, but keep the JSON valid whatever they are
+std::string escape(const char* s)
+{
+  std::string result;
+  for (; *s; ++s)
+  {
+    if (*s == '"' || *s == '\\')
+    {
+      result += '\\';
+    }
+    if (static_cast<unsigned char>(*s) >= 0x20)
+    {
+      result += *s;
+    }
+  }
+  return result;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  if (argc != 2)
+  {
+    fprintf(stderr, "usage: %s trace.bin > trace.json\n", argv[0]);
+    return 1;
+  }
+  FILE* fp = ::fopen(argv[1], "rb");
+  if (fp == NULL)
+  {
+    perror(argv[1]);
+    return 1;
+  }
+  trace::FileHeader header;
+  if (::fread(&header, sizeof header, 1, fp) != 1
+      || memcmp(header.magic, trace::kMagic, sizeof header.magic) != 0
+      || header.ticksPerMicro <= 0)
+  {
+    fprintf(stderr, "%s: not a trace dump\n", argv[1]);
+    return 1;
+  }
+
+  printf("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+  const char* separator = "";
+  std::vector<trace::Event> events;
+  for (uint32_t t = 0; t < header.numThreads; ++t)
+  {
+    trace::ThreadHeader thread;
+    if (::fread(&thread, sizeof thread, 1, fp) != 1)
+    {
+      fprintf(stderr, "%s: truncated\n", argv[1]);
+      return 1;
+    }
+    events.resize(thread.numEvents);
+    if (thread.numEvents > 0
+        && ::fread(&events[0], sizeof events[0], events.size(), fp) != events.size())
+    {
+      fprintf(stderr, "%s: truncated\n", argv[1]);
+      return 1;
+    }
+    thread.threadName[sizeof thread.threadName - 1] = '\0';
+    printf("%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+           "\"args\":{\"name\":\"%s\"}}",
+           separator, thread.tid, escape(thread.threadName).c_str());
+    separator = ",\n";
+
+    // the ring may have dropped the beginnings of the oldest spans
+    int depth = 0;
+    for (size_t i = 0; i < events.size(); ++i)
+    {
+      const trace::Event& e = events[i];
+      if (e.type >= trace::kNumTypes)
+      {
+        continue;
+      }
+      const TypeInfo& info = kTypes[e.type];
+      if (info.phase == 'B')
+      {
+        ++depth;
+      }
+      else if (info.phase == 'E')
+      {
+        if (depth == 0)
+        {
+          continue;
+        }
+        --depth;
+      }
+      double ts = static_cast<double>(static_cast<int64_t>(e.tsc - header.baseTicks))
+                  / header.ticksPerMicro;
+      printf("%s{\"name\":\"%s\",\"ph\":\"%c\",%s\"ts\":%.3f,\"pid\":1,\"tid\":%d,"
+             "\"args\":{\"%s\":%u}}",
+             separator, info.name, info.phase, info.phase == 'i' ? "\"s\":\"t\"," : "",
+             ts, thread.tid, info.argName, e.arg);
+    }
+  }
+  printf("\n]}\n");
+  ::fclose(fp);
+  return 0;
+}
@@ -0,0 +1,186 @@
+#include "HttpCompression.h"
+
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+
+#include <zlib.h>
+
+namespace
+{
+
+StringPiece trim(StringPiece s)
+{
+  while (!s.empty() && isspace(s[0]))
+  {
+    s.remove_prefix(1);
+  }
+  while (!s.empty() && isspace(s[s.size()-1]))
+  {
+    s.remove_suffix(1);
+  }
+  return s;
+}
+
+bool equalsIgnoreCase(const StringPiece& s, const char* literal)
+{
+  return static_cast<size_t>(s.size()) == strlen(literal)
+      && strncasecmp(s.data(), literal, s.size()) == 0;
+}
+
+// q-value in thousandths, "q=0.5" -> 500, missing -> 1000
+int parseQuality(StringPiece params)
+{
+  int quality = 1000;
+  const char* q = static_cast<const char*>(memchr(params.data(), '=', params.size()));
+  if (q && q > params.data() && tolower(q[-1]) == 'q')
+  {
+    StringPiece value = trim(StringPiece(q + 1, static_cast<int>(params.end() - q - 1)));
+    quality = 0;
+    int scale = 1000;
+    bool fraction = false;
+    for (int i = 0; i < value.size(); ++i)
+    {
+      if (value[i] == '.')
+      {
+        fraction = true;
+      }
+      else if (isdigit(value[i]))
+      {
+        if (!fraction)
+        {
+          quality = (value[i] - '0') * 1000;
+        }
+        else if (scale > 1)
+        {
+          scale /= 10;
+          quality += (value[i] - '0') * scale;
+        }
+      }
+      else
+      {
+        break;
+      }
+    }
+  }
+  return quality;
+}
+
+}  // namespace
+
+compression::Encoding compression::negotiate(const StringPiece& acceptEncoding)
+{
+  int gzip = -1;
+  int deflate = -1;
+  int any = -1;
+  const char* p = acceptEncoding.begin();
+  const char* end = acceptEncoding.end();
+  while (p < end)
+  {
+    const char* comma = static_cast<const char*>(memchr(p, ',', end - p));
+    if (!comma)
+    {
+      comma = end;
+    }
+    StringPiece item(p, static_cast<int>(comma - p));
+    StringPiece coding = item;
+    StringPiece params;
+    const char* semicolon = static_cast<const char*>(memchr(item.data(), ';', item.size()));
+    if (semicolon)
+    {
+      coding.set(item.data(), static_cast<int>(semicolon - item.data()));
+      params.set(semicolon + 1, static_cast<int>(item.end() - semicolon - 1));
+    }
+    coding = trim(coding);
+    int quality = parseQuality(params);
+    if (equalsIgnoreCase(coding, "gzip") || equalsIgnoreCase(coding, "x-gzip"))
+    {
+      gzip = quality;
+    }
+    else if (equalsIgnoreCase(coding, "deflate"))
+    {
+      deflate = quality;
+    }
+    else if (equalsIgnoreCase(coding, "*"))
+    {
+      any = quality;
+    }
+    p = comma + 1;
+  }
+
+  if (gzip < 0)
+  {
+    gzip = any;
+  }
+  if (deflate < 0)
+  {
+    deflate = any;
+  }
+  if (gzip > 0 && gzip >= deflate)
+  {
+    return kGzip;
+  }
+  return deflate > 0 ? kDeflate : kIdentity;
+}
+
+const char* compression::name(Encoding encoding)
+{
+  switch (encoding)
+  {
+    case kGzip:
+      return "gzip";
+    case kDeflate:
+      return "deflate";
+    default:
+      return NULL;
+  }
+}
+
+bool compression::compressible(const StringPiece& contentType)
+{
+  const char* kTypes[] = { "json", "javascript", "xml", "svg" };
+  if (contentType.starts_with("text/"))
+  {
+    return true;
+  }
+  for (size_t i = 0; i < sizeof kTypes / sizeof kTypes[0]; ++i)
+  {
+    if (memmem(contentType.data(), contentType.size(), kTypes[i], strlen(kTypes[i])))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+*gzip和deflate都用zlib的deflate算法，区别只在于外层格式：
+*windowBits为15+16时输出gzip格式，为15时输出zlib格式(即HTTP的deflate编码)。
+*输出缓冲按deflateBound()预先分配，一次deflate(Z_FINISH)即可完成。
+*/
+bool compression::compress(Encoding encoding, const std::string& in, std::string* out)
+{
+  if (encoding == kIdentity)
+  {
+    return false;
+  }
+
+  z_stream zs;
+  memset(&zs, 0, sizeof zs);
+  int windowBits = encoding == kGzip ? 15 + 16 : 15;
+  if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                   windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+  {
+    return false;
+  }
+
+  out->resize(deflateBound(&zs, in.size()) + 32);
+  zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+  zs.avail_in = static_cast<uInt>(in.size());
+  zs.next_out = reinterpret_cast<Bytef*>(&(*out)[0]);
+  zs.avail_out = static_cast<uInt>(out->size());
+  int ret = deflate(&zs, Z_FINISH);
+  out->resize(zs.total_out);
+  deflateEnd(&zs);
+  return ret == Z_STREAM_END;
+}
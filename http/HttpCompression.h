@@ -0,0 +1,33 @@
+#pragma once
+
+#include "../base/StringPiece.h"
+
+#include <string>
+
+/// Content-Encoding support for HttpServer, backed by zlib.
+namespace compression
+{
+
+  enum Encoding
+  {
+    kIdentity, kGzip, kDeflate
+  };
+
+  ///
+  /// Picks the encoding from an Accept-Encoding header,
+  /// gzip is preferred over deflate, q=0 disables a coding.
+  Encoding negotiate(const StringPiece& acceptEncoding);
+
+  /// "gzip", "deflate" or NULL for kIdentity.
+  const char* name(Encoding encoding);
+
+  /// Whether compressing a body of this Content-Type is worth it,
+  /// true for text, JSON, JavaScript, XML and SVG.
+  bool compressible(const StringPiece& contentType);
+
+  ///
+  /// Compresses in into out with encoding.
+  /// @return false if zlib fails or encoding is kIdentity.
+  bool compress(Encoding encoding, const std::string& in, std::string* out);
+
+}
@@ -1,8 +1,12 @@
 #pragma once
 
 #include "../base/copyable.h"
+#include "../reactor/Arena.h"
 #include "HttpRequest.h"
 
+#include <stdint.h>
+#include <vector>
+
 class Buffer;
 
 class HttpContext : public copyable
@@ -16,12 +20,45 @@ class HttpContext : public copyable
     kGotAll,
   };
 
+  /// Timing of a response not yet written out, for HttpServer's
+  /// latency metrics, in metrics::monotonicNanos().
+  struct Timing
+  {
+    int route;      // -1 for the HttpCallback
+    int64_t parsed;
+    int64_t handled;
+  };
+
   HttpContext()
-    : state_(kExpectRequestLine)
+    : state_(kExpectRequestLine),
+      waiting_(false),
+      request_(&arena_)
   {
   }
 
-  // default copy-ctor, dtor and assignment are fine
+  // a copy gets its own arena
+  HttpContext(const HttpContext& rhs)
+    : state_(rhs.state_),
+      waiting_(rhs.waiting_),
+      request_(rhs.request_, &arena_),
+      unwritten_(rhs.unwritten_)
+  {
+  }
+
+  HttpContext& operator=(const HttpContext& rhs)
+  {
+    if (this != &rhs)
+    {
+      state_ = rhs.state_;
+      waiting_ = rhs.waiting_;
+      request_.reset();
+      arena_.reset();
+      HttpRequest copy(rhs.request_, &arena_);
+      request_.swap(copy);
+      unwritten_ = rhs.unwritten_;
+    }
+    return *this;
+  }
 
   // return false if any error
   bool parseRequest(Buffer* buf, Timestamp receiveTime);
@@ -29,23 +66,47 @@ class HttpContext : public copyable
   bool gotAll() const
   { return state_ == kGotAll; }
 
+  /// Starts over after a response, everything allocated from arena()
+  /// must be gone by then, unless the response is still waiting().
   void reset()
   {
     state_ = kExpectRequestLine;
-    HttpRequest dummy;
-    request_.swap(dummy);
+    request_.reset();
+    if (!waiting_)
+    {
+      arena_.reset();
+    }
   }
 
+  /// For the request and its response, recycled by reset().
+  Arena* arena()
+  { return &arena_; }
+
+  // true while a response is prepared off the IO thread,
+  // later pipelined requests stay in the input buffer meanwhile
+  bool waiting() const
+  { return waiting_; }
+
+  void setWaiting(bool on)
+  { waiting_ = on; }
+
   const HttpRequest& request() const
   { return request_; }
 
   HttpRequest& request()
   { return request_; }
 
+  /// Responses handed to the connection before its output was drained.
+  std::vector<Timing>* unwritten()
+  { return &unwritten_; }
+
  private:
   bool processRequestLine(const char* begin, const char* end);
 
   HttpRequestParseState state_;
+  bool waiting_;
+  Arena arena_;  // before request_, which allocates from it
   HttpRequest request_;
+  std::vector<Timing> unwritten_;
 };
 
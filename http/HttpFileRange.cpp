@@ -0,0 +1,333 @@
+#include "HttpFileRange.h"
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+#include "../base/FileUtil.h"
+#include "../base/Timestamp.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+namespace
+{
+
+StringPiece trim(StringPiece s)
+{
+  while (!s.empty() && isspace(s[0]))
+  {
+    s.remove_prefix(1);
+  }
+  while (!s.empty() && isspace(s[s.size()-1]))
+  {
+    s.remove_suffix(1);
+  }
+  return s;
+}
+
+// strict decimal, false on empty input, other characters or overflow
+bool parseOffset(const StringPiece& s, off_t* value)
+{
+  if (s.empty())
+  {
+    return false;
+  }
+  off_t v = 0;
+  for (int i = 0; i < s.size(); ++i)
+  {
+    if (!isdigit(s[i]) || v > (INT64_MAX - 9) / 10)
+    {
+      return false;
+    }
+    v = v * 10 + (s[i] - '0');
+  }
+  *value = v;
+  return true;
+}
+
+string formatHttpDate(time_t seconds)
+{
+  struct tm tm_time;
+  ::gmtime_r(&seconds, &tm_time);
+  char buf[64];
+  size_t n = ::strftime(buf, sizeof buf, "%a, %d %b %Y %H:%M:%S GMT", &tm_time);
+  return string(buf, n);
+}
+
+// only the IMF-fixdate form, the obsolete RFC 850 and asctime forms are ignored
+bool parseHttpDate(const StringPiece& date, time_t* seconds)
+{
+  char buf[64];
+  if (date.empty() || static_cast<size_t>(date.size()) >= sizeof buf)
+  {
+    return false;
+  }
+  memcpy(buf, date.data(), date.size());
+  buf[date.size()] = '\0';
+  struct tm tm_time;
+  memset(&tm_time, 0, sizeof tm_time);
+  const char* end = ::strptime(buf, "%a, %d %b %Y %H:%M:%S GMT", &tm_time);
+  if (end == NULL || *end != '\0')
+  {
+    return false;
+  }
+  *seconds = ::timegm(&tm_time);
+  return true;
+}
+
+string makeETag(const ReadOnlyFile& file)
+{
+  char buf[64];
+  snprintf(buf, sizeof buf, "\"%llx-%llx\"",
+           static_cast<unsigned long long>(file.size()),
+           static_cast<unsigned long long>(file.modifyTime()));
+  return buf;
+}
+
+// weak comparison of If-None-Match, "*" matches any current representation
+bool etagListMatches(const StringPiece& header, const string& etag)
+{
+  const char* p = header.data();
+  const char* end = p + header.size();
+  while (p < end)
+  {
+    const char* comma = static_cast<const char*>(memchr(p, ',', end - p));
+    if (!comma)
+    {
+      comma = end;
+    }
+    StringPiece tag = trim(StringPiece(p, static_cast<int>(comma - p)));
+    if (tag.starts_with("W/"))
+    {
+      tag.remove_prefix(2);
+    }
+    if (tag == "*" || tag == etag)
+    {
+      return true;
+    }
+    p = comma + 1;
+  }
+  return false;
+}
+
+bool notModified(const HttpRequest& req, const string& etag, time_t mtime)
+{
+  StringPiece ifNoneMatch = req.getHeader("If-None-Match");
+  if (!ifNoneMatch.empty())
+  {
+    // If-Modified-Since is ignored when If-None-Match is present
+    return etagListMatches(ifNoneMatch, etag);
+  }
+  time_t since = 0;
+  return parseHttpDate(req.getHeader("If-Modified-Since"), &since) && mtime <= since;
+}
+
+// If-Range needs a strong match, a weak ETag never matches
+bool ifRangeMatches(const HttpRequest& req, const string& etag, time_t mtime)
+{
+  StringPiece ifRange = req.getHeader("If-Range");
+  if (ifRange.empty())
+  {
+    return true;
+  }
+  if (ifRange[0] == '"' || ifRange.starts_with("W/"))
+  {
+    return ifRange == etag;
+  }
+  time_t date = 0;
+  return parseHttpDate(ifRange, &date) && date == mtime;
+}
+
+string contentRange(const filerange::ByteRange& range, off_t size)
+{
+  char buf[96];
+  snprintf(buf, sizeof buf, "bytes %lld-%lld/%lld",
+           static_cast<long long>(range.first),
+           static_cast<long long>(range.second),
+           static_cast<long long>(size));
+  return buf;
+}
+
+}  // namespace
+
+filerange::RangeResult filerange::parseRange(const StringPiece& header,
+                                             off_t size,
+                                             std::vector<ByteRange>* ranges)
+{
+  ranges->clear();
+  StringPiece spec = trim(header);
+  if (!spec.starts_with("bytes="))
+  {
+    return kNoRange;
+  }
+  spec.remove_prefix(6);
+
+  const char* p = spec.begin();
+  const char* end = spec.end();
+  bool sawRange = false;
+  while (p < end)
+  {
+    const char* comma = static_cast<const char*>(memchr(p, ',', end - p));
+    if (!comma)
+    {
+      comma = end;
+    }
+    StringPiece item = trim(StringPiece(p, static_cast<int>(comma - p)));
+    p = comma + 1;
+    if (item.empty())
+    {
+      continue;
+    }
+    const char* dash = static_cast<const char*>(memchr(item.data(), '-', item.size()));
+    if (!dash)
+    {
+      return kNoRange;
+    }
+    StringPiece firstPos(item.data(), static_cast<int>(dash - item.data()));
+    StringPiece lastPos(dash + 1, static_cast<int>(item.end() - dash - 1));
+    off_t first = 0;
+    off_t last = 0;
+    sawRange = true;
+    if (firstPos.empty())
+    {
+      // suffix range "-n": the last n bytes
+      if (!parseOffset(lastPos, &last))
+      {
+        return kNoRange;
+      }
+      if (last == 0 || size == 0)
+      {
+        continue;
+      }
+      first = last < size ? size - last : 0;
+      last = size - 1;
+    }
+    else
+    {
+      if (!parseOffset(firstPos, &first))
+      {
+        return kNoRange;
+      }
+      if (lastPos.empty())
+      {
+        last = size - 1;
+      }
+      else if (!parseOffset(lastPos, &last) || last < first)
+      {
+        return kNoRange;
+      }
+      if (first >= size)
+      {
+        continue;
+      }
+      if (last >= size)
+      {
+        last = size - 1;
+      }
+    }
+    ranges->push_back(ByteRange(first, last));
+    if (ranges->size() > static_cast<size_t>(kMaxRanges))
+    {
+      // too many ranges is more likely an attack than a client, send it all
+      ranges->clear();
+      return kNoRange;
+    }
+  }
+
+  if (!sawRange)
+  {
+    return kNoRange;
+  }
+  return ranges->empty() ? kUnsatisfiable : kSatisfiable;
+}
+
+/*
+*只处理由整个文件构成响应体的200响应，其他响应(包括压缩后的body)原样发送。
+*多个range按multipart/byteranges发送，每个part的头部作为文件片段的前缀，
+*由sendResponse()按顺序和sendfile(2)的数据交替发出，文件内容不经过用户态。
+*/
+void filerange::handle(const HttpRequest& req, HttpResponse* resp)
+{
+  FilePtr file = resp->bodyFile();
+  if (!file
+      || resp->statusCode() != HttpResponse::k200Ok
+      || resp->bodyFileRanges().size() != 1
+      || resp->bodyFileRanges()[0].offset != 0
+      || static_cast<off_t>(resp->bodyFileRanges()[0].length) != file->size())
+  {
+    return;
+  }
+  HttpRequest::Method method = req.method();
+  if (method != HttpRequest::kGet && method != HttpRequest::kHead)
+  {
+    return;
+  }
+
+  const off_t size = file->size();
+  const time_t mtime = file->modifyTime();
+  const string etag = makeETag(*file);
+  resp->addHeader("ETag", etag);
+  resp->addHeader("Last-Modified", formatHttpDate(mtime));
+  resp->addHeader("Accept-Ranges", "bytes");
+
+  if (notModified(req, etag, mtime))
+  {
+    resp->setStatusCode(HttpResponse::k304NotModified);
+    resp->clearBodyFile();
+    return;
+  }
+
+  StringPiece rangeHeader = req.getHeader("Range");
+  if (method != HttpRequest::kGet
+      || rangeHeader.empty()
+      || !ifRangeMatches(req, etag, mtime))
+  {
+    return;
+  }
+
+  std::vector<ByteRange> ranges;
+  RangeResult result = parseRange(rangeHeader, size, &ranges);
+  if (result == kNoRange)
+  {
+    return;
+  }
+  if (result == kUnsatisfiable)
+  {
+    char buf[64];
+    snprintf(buf, sizeof buf, "bytes */%lld", static_cast<long long>(size));
+    resp->setStatusCode(HttpResponse::k416RangeNotSatisfiable);
+    resp->addHeader("Content-Range", buf);
+    resp->clearBodyFile();
+    return;
+  }
+
+  resp->setStatusCode(HttpResponse::k206PartialContent);
+  if (ranges.size() == 1)
+  {
+    resp->addHeader("Content-Range", contentRange(ranges[0], size));
+    resp->setBodyFile(file, ranges[0].first, ranges[0].second - ranges[0].first + 1);
+    return;
+  }
+
+  char boundary[32];
+  snprintf(boundary, sizeof boundary, "%016llx",
+           static_cast<unsigned long long>(Timestamp::now().microSecondsSinceEpoch()) ^
+           static_cast<unsigned long long>(reinterpret_cast<uintptr_t>(resp)));
+  const string contentType = resp->header("Content-Type").as_string();
+
+  resp->setBodyFile(file);
+  for (size_t i = 0; i < ranges.size(); ++i)
+  {
+    string prefix(i == 0 ? "--" : "\r\n--");
+    prefix += boundary;
+    prefix += "\r\n";
+    if (!contentType.empty())
+    {
+      prefix += "Content-Type: " + contentType + "\r\n";
+    }
+    prefix += "Content-Range: " + contentRange(ranges[i], size) + "\r\n\r\n";
+    resp->addBodyFileRange(prefix, ranges[i].first, ranges[i].second - ranges[i].first + 1);
+  }
+  resp->setBodyFileTrailer(string("\r\n--") + boundary + "--\r\n");
+  resp->setContentType(string("multipart/byteranges; boundary=") + boundary);
+}
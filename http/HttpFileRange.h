@@ -0,0 +1,42 @@
+#pragma once
+
+#include "../base/StringPiece.h"
+
+#include <sys/types.h>
+#include <utility>
+#include <vector>
+
+class HttpRequest;
+class HttpResponse;
+
+/// Conditional GET and Range requests for file-backed responses.
+namespace filerange
+{
+
+  /// [first, last] byte positions, inclusive like Content-Range.
+  typedef std::pair<off_t, off_t> ByteRange;
+
+  enum RangeResult
+  {
+    kNoRange, kSatisfiable, kUnsatisfiable
+  };
+
+  const int kMaxRanges = 16;
+
+  ///
+  /// Parses a "bytes=..." Range header against a file of size bytes.
+  /// Malformed headers, other units and more than kMaxRanges ranges
+  /// are treated as if there was no Range header.
+  RangeResult parseRange(const StringPiece& header,
+                         off_t size,
+                         std::vector<ByteRange>* ranges);
+
+  ///
+  /// Adds ETag, Last-Modified and Accept-Ranges to a 200 response whose
+  /// body is a whole file, then answers If-None-Match / If-Modified-Since
+  /// with 304, and Range / If-Range with 206 (a single range or
+  /// multipart/byteranges) or 416. HEAD gets the headers of the 200 or
+  /// 304 response, Range is ignored, and HttpServer sends no body for it.
+  void handle(const HttpRequest& req, HttpResponse* resp);
+
+}
@@ -0,0 +1,202 @@
+#include "HttpMetrics.h"
+
+#include "../reactor/LoopMetrics.h"
+#include "HttpRouter.h"
+
+#include <stdio.h>
+
+namespace metrics
+{
+
+const char kContentType[] = "text/plain; version=0.0.4; charset=utf-8";
+
+namespace
+{
+
+struct SpanInfo
+{
+  const char* name;
+  const char* help;
+};
+
+const SpanInfo kSpans[RouteLatency::kNumSpans] = {
+  { "webserver_http_handler_seconds", "Request parsed to handler returned" },
+  { "webserver_http_write_seconds", "Handler returned to last byte of the response written" },
+};
+
+const double kQuantiles[] = { 0.5, 0.99, 0.999 };
+
+const char* methodName(HttpRequest::Method method)
+{
+  switch (method)
+  {
+    case HttpRequest::kGet: return "GET";
+    case HttpRequest::kPost: return "POST";
+    case HttpRequest::kHead: return "HEAD";
+    case HttpRequest::kPut: return "PUT";
+    case HttpRequest::kDelete: return "DELETE";
+    default: return "UNKNOWN";
+  }
+}
+
+// label values may hold anything a route pattern does
+void appendLabelValue(const std::string& value, std::string* out)
+{
+  for (size_t i = 0; i < value.size(); ++i)
+  {
+    switch (value[i])
+    {
+      case '\\': out->append("\\\\"); break;
+      case '"': out->append("\\\""); break;
+      case '\n': out->append("\\n"); break;
+      default: out->push_back(value[i]);
+    }
+  }
+}
+
+}  // namespace
+
+RouteLatency::RouteLatency(int numRoutes)
+  : histograms_((numRoutes + 1) * kNumSpans)
+{
+}
+
+void RouteLatency::record(int route, int64_t handleNanos, int64_t writeNanos)
+{
+  Histogram* h = &histograms_[route * kNumSpans];
+  MutexLockGuard lock(mutex_);
+  h[kHandle].record(handleNanos);
+  h[kWrite].record(writeNanos);
+}
+
+void RouteLatency::mergeInto(std::vector<Histogram>* histograms) const
+{
+  assert(histograms->size() == histograms_.size());
+  MutexLockGuard lock(mutex_);
+  for (size_t i = 0; i < histograms_.size(); ++i)
+  {
+    (*histograms)[i].merge(histograms_[i]);
+  }
+}
+
+void appendLoopMetrics(std::string* out)
+{
+  std::vector<LoopMetrics::Snapshot> loops;
+  LoopMetrics::collect(&loops);
+  char buf[256];
+  for (int m = 0; m < LoopMetrics::kNumMetrics; ++m)
+  {
+    const LoopMetrics::Info& info = LoopMetrics::info(static_cast<LoopMetrics::Metric>(m));
+    snprintf(buf, sizeof buf, "# HELP %s %s\n# TYPE %s %s\n",
+             info.name, info.help, info.name, info.type);
+    out->append(buf);
+    for (size_t i = 0; i < loops.size(); ++i)
+    {
+      int n = snprintf(buf, sizeof buf, "%s{loop=\"%d\",thread=\"%s\"} ",
+                       info.name, loops[i].tid, loops[i].threadName.c_str());
+      if (info.scale == 1)
+      {
+        n += snprintf(buf + n, sizeof buf - n, "%lld\n",
+                      static_cast<long long>(loops[i].values[m]));
+      }
+      else
+      {
+        n += snprintf(buf + n, sizeof buf - n, "%.6f\n",
+                      static_cast<double>(loops[i].values[m]) * info.scale);
+      }
+      out->append(buf);
+    }
+  }
+}
+
+void appendLockMetrics(std::string* out)
+{
+  std::vector<MutexLock::Stats> locks;
+  MutexLock::collect(&locks);
+  const char* const kNames[] = {
+    "webserver_lock_acquisitions_total",
+    "webserver_lock_contended_total",
+    "webserver_lock_wait_seconds_total",
+  };
+  const char* const kHelps[] = {
+    "MutexLock acquisitions",
+    "MutexLock acquisitions that found the lock held",
+    "Time spent acquiring contended MutexLocks",
+  };
+  char buf[256];
+  for (int m = 0; m < 3; ++m)
+  {
+    snprintf(buf, sizeof buf, "# HELP %s %s\n# TYPE %s counter\n",
+             kNames[m], kHelps[m], kNames[m]);
+    out->append(buf);
+    for (size_t i = 0; i < locks.size(); ++i)
+    {
+      if (m == 2)
+      {
+        snprintf(buf, sizeof buf, "%s{lock=\"%s\"} %.6f\n", kNames[m], locks[i].name,
+                 static_cast<double>(locks[i].waitNanos) * 1e-9);
+      }
+      else
+      {
+        snprintf(buf, sizeof buf, "%s{lock=\"%s\"} %lld\n", kNames[m], locks[i].name,
+                 static_cast<long long>(m == 0 ? locks[i].acquisitions : locks[i].contended));
+      }
+      out->append(buf);
+    }
+  }
+}
+
+void appendRouteLatency(const HttpRouter& router,
+                        const std::vector<Histogram>& histograms,
+                        std::string* out)
+{
+  const int numRoutes = static_cast<int>(router.numRoutes());
+  assert(histograms.size() == static_cast<size_t>((numRoutes + 1) * RouteLatency::kNumSpans));
+  char buf[256];
+  for (int span = 0; span < RouteLatency::kNumSpans; ++span)
+  {
+    const char* name = kSpans[span].name;
+    snprintf(buf, sizeof buf, "# HELP %s %s\n# TYPE %s summary\n",
+             name, kSpans[span].help, name);
+    out->append(buf);
+    // the last one counts requests that went to the HttpCallback
+    for (int route = 0; route <= numRoutes; ++route)
+    {
+      std::string labels("{method=\"");
+      if (route < numRoutes)
+      {
+        labels += methodName(router.method(route));
+        labels += "\",route=\"";
+        appendLabelValue(router.pattern(route), &labels);
+      }
+      else
+      {
+        labels += "*\",route=\"*";
+      }
+      labels += '"';
+
+      const Histogram& h = histograms[route * RouteLatency::kNumSpans + span];
+      for (size_t q = 0; q < sizeof kQuantiles / sizeof kQuantiles[0]; ++q)
+      {
+        if (h.count() > 0)
+        {
+          snprintf(buf, sizeof buf, "%s%s,quantile=\"%g\"} %.9f\n",
+                   name, labels.c_str(), kQuantiles[q],
+                   static_cast<double>(h.percentile(kQuantiles[q] * 100)) * 1e-9);
+        }
+        else
+        {
+          snprintf(buf, sizeof buf, "%s%s,quantile=\"%g\"} NaN\n",
+                   name, labels.c_str(), kQuantiles[q]);
+        }
+        out->append(buf);
+      }
+      snprintf(buf, sizeof buf, "%s_sum%s} %.9f\n%s_count%s} %llu\n",
+               name, labels.c_str(), h.mean() * static_cast<double>(h.count()) * 1e-9,
+               name, labels.c_str(), static_cast<unsigned long long>(h.count()));
+      out->append(buf);
+    }
+  }
+}
+
+}  // namespace metrics
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "../base/Histogram.h"
+#include "../base/MutexLock.h"
+
+#include <stdint.h>
+#include <string>
+#include <time.h>
+#include <vector>
+
+class HttpRouter;
+
+/// Prometheus text exposition (format 0.0.4) for HttpServer's metrics handler.
+namespace metrics
+{
+
+  /// Content-Type of a scrape response.
+  extern const char kContentType[];
+
+  inline int64_t monotonicNanos()
+  {
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+  }
+
+  ///
+  /// Latency histograms of every route, in nanoseconds, for one IO thread.
+  ///
+  /// Recorded by that thread, merged by a scrape in any thread. The mutex
+  /// is only ever contended by a scrape, a recording takes and releases it
+  /// without waiting.
+  ///
+  class RouteLatency : noncopyable
+  {
+   public:
+    enum Span
+    {
+      kHandle,  // request parsed to handler returned
+      kWrite,   // handler returned to last byte written
+      kNumSpans
+    };
+
+    /// Route numRoutes stands for requests that matched no route.
+    explicit RouteLatency(int numRoutes);
+
+    void record(int route, int64_t handleNanos, int64_t writeNanos);
+
+    /// Adds into histograms[route * kNumSpans + span], which must be
+    /// (numRoutes + 1) * kNumSpans long.
+    void mergeInto(std::vector<Histogram>* histograms) const;
+
+   private:
+    mutable MutexLock mutex_;
+    std::vector<Histogram> histograms_;
+  };
+
+  ///
+  /// Appends the LoopMetrics of every live EventLoop, one series per loop
+  /// labelled with its thread id and name. Thread safe.
+  void appendLoopMetrics(std::string* out);
+
+  ///
+  /// Appends the contention counters of every named MutexLock, summed over
+  /// the locks of the same name. Thread safe.
+  void appendLockMetrics(std::string* out);
+
+  ///
+  /// Appends a summary of each span with p50, p99 and p999 per route
+  /// of router, from histograms merged by RouteLatency::mergeInto().
+  void appendRouteLatency(const HttpRouter& router,
+                          const std::vector<Histogram>& histograms,
+                          std::string* out);
+
+}
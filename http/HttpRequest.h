@@ -1,15 +1,27 @@
 #pragma once
 
 #include "../base/copyable.h"
+#include "../base/StringPiece.h"
 #include "../base/Timestamp.h"
+#include "../reactor/Arena.h"
+
+#include <string>
+#include <utility>
+#include <vector>
 
-#include <map>
 #include <assert.h>
+#include <ctype.h>
 #include <stdio.h>
 
+/// The strings of a request parsed by HttpContext live in its arena,
+/// a copy refers to the same arena.
 class HttpRequest : public copyable
 {
  public:
+  typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char> > String;
+  typedef std::pair<String, String> Header;
+  typedef std::vector<Header, ArenaAllocator<Header> > HeaderList;
+
   enum Method
   {
     kInvalid, kGet, kPost, kHead, kPut, kDelete
@@ -19,12 +31,35 @@ class HttpRequest : public copyable
     kUnknown, kHttp10, kHttp11
   };
 
-  HttpRequest()
+  /// Allocates from arena, or from the heap if it is NULL.
+  explicit HttpRequest(Arena* arena = NULL)
     : method_(kInvalid),
-      version_(kUnknown)
+      version_(kUnknown),
+      path_(ArenaAllocator<char>(arena)),
+      query_(ArenaAllocator<char>(arena)),
+      headers_(ArenaAllocator<Header>(arena))
   {
   }
 
+  /// Copies rhs into arena.
+  HttpRequest(const HttpRequest& rhs, Arena* arena)
+    : method_(rhs.method_),
+      version_(rhs.version_),
+      path_(rhs.path_.data(), rhs.path_.size(), ArenaAllocator<char>(arena)),
+      query_(rhs.query_.data(), rhs.query_.size(), ArenaAllocator<char>(arena)),
+      receiveTime_(rhs.receiveTime_),
+      headers_(ArenaAllocator<Header>(arena))
+  {
+    headers_.reserve(rhs.headers_.size());
+    for (HeaderList::const_iterator it = rhs.headers_.begin(); it != rhs.headers_.end(); ++it)
+    {
+      addHeader(piece(it->first), piece(it->second));
+    }
+  }
+
+  HttpRequest(const HttpRequest&) = default;
+  HttpRequest& operator=(const HttpRequest&) = default;
+
   void setVersion(Version v)
   {
     version_ = v;
@@ -36,7 +71,7 @@ class HttpRequest : public copyable
   bool setMethod(const char* start, const char* end)
   {
     assert(method_ == kInvalid);
-    string m(start, end);
+    StringPiece m(start, static_cast<int>(end - start));
     if (m == "GET")
     {
       method_ = kGet;
@@ -98,16 +133,16 @@ class HttpRequest : public copyable
     path_.assign(start, end);
   }
 
-  const string& path() const
-  { return path_; }
+  StringPiece path() const
+  { return piece(path_); }
 
   void setQuery(const char* start, const char* end)
   {
     query_.assign(start, end);
   }
 
-  const string& query() const
-  { return query_; }
+  StringPiece query() const
+  { return piece(query_); }
 
   void setReceiveTime(Timestamp t)
   { receiveTime_ = t; }
@@ -117,36 +152,71 @@ class HttpRequest : public copyable
 
   void addHeader(const char* start, const char* colon, const char* end)
   {
-    string field(start, colon);
-    ++colon;
-    while (colon < end && isspace(*colon))
+    const char* value = colon + 1;
+    while (value < end && isspace(*value))
     {
-      ++colon;
+      ++value;
     }
-    string value(colon, end);
-    while (!value.empty() && isspace(value[value.size()-1]))
+    while (end > value && isspace(end[-1]))
     {
-      value.resize(value.size()-1);
+      --end;
     }
-    headers_[field] = value;
+    addHeader(StringPiece(start, static_cast<int>(colon - start)),
+              StringPiece(value, static_cast<int>(end - value)));
   }
 
-  string getHeader(const string& field) const
+  /// Replaces the value if field was added before.
+  void addHeader(const StringPiece& field, const StringPiece& value)
   {
-    string result;
-    std::map<string, string>::const_iterator it = headers_.find(field);
-    if (it != headers_.end())
+    for (HeaderList::iterator it = headers_.begin(); it != headers_.end(); ++it)
     {
-      result = it->second;
+      if (piece(it->first) == field)
+      {
+        it->second.assign(value.data(), value.size());
+        return;
+      }
     }
-    return result;
+    if (headers_.empty())
+    {
+      headers_.reserve(kInitialHeaders);
+    }
+    ArenaAllocator<char> alloc(headers_.get_allocator());
+    headers_.push_back(Header(String(field.data(), field.size(), alloc),
+                              String(value.data(), value.size(), alloc)));
   }
 
-  const std::map<string, string>& headers() const
+  /// Returns an empty piece if field is absent,
+  /// valid until the request is reset.
+  StringPiece getHeader(const StringPiece& field) const
+  {
+    for (HeaderList::const_iterator it = headers_.begin(); it != headers_.end(); ++it)
+    {
+      if (piece(it->first) == field)
+      {
+        return piece(it->second);
+      }
+    }
+    return StringPiece();
+  }
+
+  const HeaderList& headers() const
   { return headers_; }
 
+  /// Empties the request, keeping its arena. Call before resetting the arena.
+  void reset()
+  {
+    ArenaAllocator<char> alloc(path_.get_allocator());
+    method_ = kInvalid;
+    version_ = kUnknown;
+    String(alloc).swap(path_);
+    String(alloc).swap(query_);
+    receiveTime_ = Timestamp();
+    HeaderList(alloc).swap(headers_);
+  }
+
   void swap(HttpRequest& that)
   {
+    assert(path_.get_allocator() == that.path_.get_allocator());
     std::swap(method_, that.method_);
     std::swap(version_, that.version_);
     path_.swap(that.path_);
@@ -156,11 +226,16 @@ class HttpRequest : public copyable
   }
 
  private:
+  static const size_t kInitialHeaders = 16;
+
+  static StringPiece piece(const String& str)
+  { return StringPiece(str.data(), static_cast<int>(str.size())); }
+
   Method method_;
   Version version_;
-  string path_;
-  string query_;
+  String path_;
+  String query_;
   Timestamp receiveTime_;
-  std::map<string, string> headers_;
+  HeaderList headers_;  // in arrival order, a handful, so scanned linearly
 };
 
@@ -1,36 +1,240 @@
-
 #include "HttpResponse.h"
 #include "../reactor/Buffer.h"
 
-#include <stdio.h>
+#include <algorithm>
+
+#include <time.h>
+
+namespace
+{
+
+struct StatusLine
+{
+  int code;
+  const char* line;
+};
+
+const StatusLine kStatusLines[] = {
+  { 100, "HTTP/1.1 100 Continue\r\n" },
+  { 101, "HTTP/1.1 101 Switching Protocols\r\n" },
+  { 200, "HTTP/1.1 200 OK\r\n" },
+  { 201, "HTTP/1.1 201 Created\r\n" },
+  { 202, "HTTP/1.1 202 Accepted\r\n" },
+  { 203, "HTTP/1.1 203 Non-Authoritative Information\r\n" },
+  { 204, "HTTP/1.1 204 No Content\r\n" },
+  { 205, "HTTP/1.1 205 Reset Content\r\n" },
+  { 206, "HTTP/1.1 206 Partial Content\r\n" },
+  { 300, "HTTP/1.1 300 Multiple Choices\r\n" },
+  { 301, "HTTP/1.1 301 Moved Permanently\r\n" },
+  { 302, "HTTP/1.1 302 Found\r\n" },
+  { 303, "HTTP/1.1 303 See Other\r\n" },
+  { 304, "HTTP/1.1 304 Not Modified\r\n" },
+  { 305, "HTTP/1.1 305 Use Proxy\r\n" },
+  { 307, "HTTP/1.1 307 Temporary Redirect\r\n" },
+  { 308, "HTTP/1.1 308 Permanent Redirect\r\n" },
+  { 400, "HTTP/1.1 400 Bad Request\r\n" },
+  { 401, "HTTP/1.1 401 Unauthorized\r\n" },
+  { 402, "HTTP/1.1 402 Payment Required\r\n" },
+  { 403, "HTTP/1.1 403 Forbidden\r\n" },
+  { 404, "HTTP/1.1 404 Not Found\r\n" },
+  { 405, "HTTP/1.1 405 Method Not Allowed\r\n" },
+  { 406, "HTTP/1.1 406 Not Acceptable\r\n" },
+  { 407, "HTTP/1.1 407 Proxy Authentication Required\r\n" },
+  { 408, "HTTP/1.1 408 Request Timeout\r\n" },
+  { 409, "HTTP/1.1 409 Conflict\r\n" },
+  { 410, "HTTP/1.1 410 Gone\r\n" },
+  { 411, "HTTP/1.1 411 Length Required\r\n" },
+  { 412, "HTTP/1.1 412 Precondition Failed\r\n" },
+  { 413, "HTTP/1.1 413 Payload Too Large\r\n" },
+  { 414, "HTTP/1.1 414 URI Too Long\r\n" },
+  { 415, "HTTP/1.1 415 Unsupported Media Type\r\n" },
+  { 416, "HTTP/1.1 416 Range Not Satisfiable\r\n" },
+  { 417, "HTTP/1.1 417 Expectation Failed\r\n" },
+  { 421, "HTTP/1.1 421 Misdirected Request\r\n" },
+  { 422, "HTTP/1.1 422 Unprocessable Entity\r\n" },
+  { 426, "HTTP/1.1 426 Upgrade Required\r\n" },
+  { 428, "HTTP/1.1 428 Precondition Required\r\n" },
+  { 429, "HTTP/1.1 429 Too Many Requests\r\n" },
+  { 431, "HTTP/1.1 431 Request Header Fields Too Large\r\n" },
+  { 451, "HTTP/1.1 451 Unavailable For Legal Reasons\r\n" },
+  { 500, "HTTP/1.1 500 Internal Server Error\r\n" },
+  { 501, "HTTP/1.1 501 Not Implemented\r\n" },
+  { 502, "HTTP/1.1 502 Bad Gateway\r\n" },
+  { 503, "HTTP/1.1 503 Service Unavailable\r\n" },
+  { 504, "HTTP/1.1 504 Gateway Timeout\r\n" },
+  { 505, "HTTP/1.1 505 HTTP Version Not Supported\r\n" },
+  { 511, "HTTP/1.1 511 Network Authentication Required\r\n" },
+};
+
+// 以状态码为下标的状态行表，程序启动时由kStatusLines建立，之后只读
+class StatusLineTable
+{
+ public:
+  static const int kMaxCode = 600;
+
+  StatusLineTable()
+  {
+    for (size_t i = 0; i < sizeof kStatusLines / sizeof kStatusLines[0]; ++i)
+    {
+      lines_[kStatusLines[i].code] = StringPiece(kStatusLines[i].line);
+    }
+  }
+
+  StringPiece get(int code) const
+  {
+    return code > 0 && code < kMaxCode ? lines_[code] : StringPiece();
+  }
+
+ private:
+  StringPiece lines_[kMaxCode];
+};
+
+const StatusLineTable gStatusLines;
+
+// formats without snprintf(), returns the length, no trailing '\0'
+size_t formatUnsigned(char buf[], size_t value)
+{
+  char* p = buf;
+  do
+  {
+    *p++ = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+  std::reverse(buf, p);
+  return p - buf;
+}
+
+/*
+*每个IO线程缓存一份"Date: ...\r\n"，由HttpServer在每个loop里注册的1秒定时器刷新，
+*这样每个响应只需要一次memcpy，不必每次都调用gmtime_r()和strftime()。
+*没有定时器的线程(例如用户自己的线程)在每次序列化时按秒检查是否需要重新格式化。
+*/
+__thread char t_dateHeader[64];
+__thread int t_dateHeaderLength = 0;
+__thread time_t t_dateSeconds = 0;
+__thread bool t_dateRefreshedByTimer = false;
+
+void formatDate(Timestamp now)
+{
+  time_t seconds = now.secondsSinceEpoch();
+  if (seconds != t_dateSeconds)
+  {
+    struct tm tm_time;
+    ::gmtime_r(&seconds, &tm_time);
+    t_dateHeaderLength = static_cast<int>(
+        ::strftime(t_dateHeader, sizeof t_dateHeader,
+                   "Date: %a, %d %b %Y %H:%M:%S GMT\r\n", &tm_time));
+    t_dateSeconds = seconds;
+  }
+}
+
+}  // namespace
+
+void HttpResponse::updateDateCache(Timestamp now)
+{
+  t_dateRefreshedByTimer = true;
+  formatDate(now);
+}
+
+void HttpResponse::addHeader(const StringPiece& key, const StringPiece& value)
+{
+  for (HeaderList::iterator it = headers_.begin(); it != headers_.end(); ++it)
+  {
+    if (StringPiece(it->first.data(), static_cast<int>(it->first.size())) == key)
+    {
+      it->second.assign(value.data(), value.size());
+      return;
+    }
+  }
+  ArenaAllocator<char> alloc(arena_);
+  headers_.emplace_back(String(key.data(), key.size(), alloc),
+                        String(value.data(), value.size(), alloc));
+}
+
+StringPiece HttpResponse::header(const StringPiece& key) const
+{
+  for (HeaderList::const_iterator it = headers_.begin(); it != headers_.end(); ++it)
+  {
+    if (StringPiece(it->first.data(), static_cast<int>(it->first.size())) == key)
+    {
+      return StringPiece(it->second.data(), static_cast<int>(it->second.size()));
+    }
+  }
+  return StringPiece();
+}
 
-void HttpResponse::appendToBuffer(Buffer* output) const
+void HttpResponse::appendToBuffer(Buffer* output, bool withBody) const
 {
+  size_t headerBytes = 0;
+  for (const auto& header : headers_)
+  {
+    headerBytes += header.first.size() + header.second.size() + 4;
+  }
+  size_t contentLength = body_.size();
+  if (bodyFile_)
+  {
+    contentLength = fileTrailer_.size();
+    for (const auto& range : fileRanges_)
+    {
+      contentLength += range.prefix.size() + range.length;
+    }
+  }
+  // status line, Date, Content-Length and Connection fit in 128 bytes
+  output->ensureWritableBytes(128 + statusMessage_.size() + headerBytes + body_.size());
+
   char buf[32];
-  snprintf(buf, sizeof buf, "HTTP/1.1 %d ", statusCode_);
-  output->append(buf);
-  output->append(statusMessage_);
-  output->append("\r\n");
+  StringPiece statusLine;
+  if (statusMessage_.empty())
+  {
+    statusLine = gStatusLines.get(statusCode_);
+  }
+  if (!statusLine.empty())
+  {
+    output->append(statusLine);
+  }
+  else
+  {
+    output->append("HTTP/1.1 ");
+    output->append(buf, formatUnsigned(buf, statusCode_));
+    output->append(" ");
+    output->append(statusMessage_);
+    output->append("\r\n");
+  }
+
+  if (!t_dateRefreshedByTimer)
+  {
+    formatDate(Timestamp::now());
+  }
+  output->append(t_dateHeader, t_dateHeaderLength);
 
   if (closeConnection_)
   {
     output->append("Connection: close\r\n");
   }
-  else
+  else if (statusCode_ >= 200)
   {
-    snprintf(buf, sizeof buf, "Content-Length: %zd\r\n", body_.size());
-    output->append(buf);
+    // 204 and 304 responses never carry a body, 1xx responses have neither
+    // a body nor a persistent connection, 101 brings its own Connection header
+    if (statusCode_ != k204NoContent && statusCode_ != k304NotModified)
+    {
+      output->append("Content-Length: ");
+      output->append(buf, formatUnsigned(buf, contentLength));
+      output->append("\r\n");
+    }
     output->append("Connection: Keep-Alive\r\n");
   }
 
   for (const auto& header : headers_)
   {
-    output->append(header.first);
+    output->append(header.first.data(), header.first.size());
     output->append(": ");
-    output->append(header.second);
+    output->append(header.second.data(), header.second.size());
     output->append("\r\n");
   }
 
   output->append("\r\n");
-  output->append(body_);
+  if (withBody && !bodyFile_)
+  {
+    output->append(body_);
+  }
 }
@@ -1,9 +1,16 @@
 #pragma once
 
 #include "../base/copyable.h"
+#include "../base/StringPiece.h"
+#include "../base/Timestamp.h"
+#include "../reactor/Arena.h"
+#include "../reactor/Callbacks.h"
+
+#include <boost/container/small_vector.hpp>
 
-#include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
 using namespace std;
 
@@ -14,14 +21,69 @@ class HttpResponse : public copyable
   enum HttpStatusCode
   {
     kUnknown,
+    k100Continue = 100,
+    k101SwitchingProtocols = 101,
     k200Ok = 200,
+    k201Created = 201,
+    k202Accepted = 202,
+    k203NonAuthoritativeInformation = 203,
+    k204NoContent = 204,
+    k205ResetContent = 205,
+    k206PartialContent = 206,
+    k300MultipleChoices = 300,
     k301MovedPermanently = 301,
+    k302Found = 302,
+    k303SeeOther = 303,
+    k304NotModified = 304,
+    k305UseProxy = 305,
+    k307TemporaryRedirect = 307,
+    k308PermanentRedirect = 308,
     k400BadRequest = 400,
+    k401Unauthorized = 401,
+    k402PaymentRequired = 402,
+    k403Forbidden = 403,
     k404NotFound = 404,
+    k405MethodNotAllowed = 405,
+    k406NotAcceptable = 406,
+    k407ProxyAuthenticationRequired = 407,
+    k408RequestTimeout = 408,
+    k409Conflict = 409,
+    k410Gone = 410,
+    k411LengthRequired = 411,
+    k412PreconditionFailed = 412,
+    k413PayloadTooLarge = 413,
+    k414UriTooLong = 414,
+    k415UnsupportedMediaType = 415,
+    k416RangeNotSatisfiable = 416,
+    k417ExpectationFailed = 417,
+    k421MisdirectedRequest = 421,
+    k422UnprocessableEntity = 422,
+    k426UpgradeRequired = 426,
+    k428PreconditionRequired = 428,
+    k429TooManyRequests = 429,
+    k431RequestHeaderFieldsTooLarge = 431,
+    k451UnavailableForLegalReasons = 451,
+    k500InternalServerError = 500,
+    k501NotImplemented = 501,
+    k502BadGateway = 502,
+    k503ServiceUnavailable = 503,
+    k504GatewayTimeout = 504,
+    k505HttpVersionNotSupported = 505,
+    k511NetworkAuthenticationRequired = 511,
+  };
+
+  /// A slice of bodyFile(), sent after prefix.
+  struct FileRange
+  {
+    string prefix;
+    off_t offset;
+    size_t length;
   };
 
-  explicit HttpResponse(bool close)
-    : statusCode_(kUnknown),
+  /// Headers are allocated from arena if given, see HttpContext::arena().
+  explicit HttpResponse(bool close, Arena* arena = NULL)
+    : arena_(arena),
+      statusCode_(kUnknown),
       closeConnection_(close)
   {
   }
@@ -29,6 +91,11 @@ class HttpResponse : public copyable
   void setStatusCode(HttpStatusCode code)
   { statusCode_ = code; }
 
+  HttpStatusCode statusCode() const
+  { return statusCode_; }
+
+  /// Only needed for a non-standard reason phrase,
+  /// standard codes take theirs from a precomputed status line.
   void setStatusMessage(const string& message)
   { statusMessage_ = message; }
 
@@ -38,23 +105,89 @@ class HttpResponse : public copyable
   bool closeConnection() const
   { return closeConnection_; }
 
-  void setContentType(const string& contentType)
+  void setContentType(const StringPiece& contentType)
   { addHeader("Content-Type", contentType); }
 
-  // FIXME: replace string with StringPiece
-  void addHeader(const string& key, const string& value)
-  { headers_[key] = value; }
+  /// Replaces the value if key was added before.
+  void addHeader(const StringPiece& key, const StringPiece& value);
+
+  /// Returns an empty piece if key was not added.
+  StringPiece header(const StringPiece& key) const;
 
   void setBody(const string& body)
   { body_ = body; }
 
-  void appendToBuffer(Buffer* output) const;
+  void setBody(string&& body)
+  { body_.swap(body); }
+
+  const string& body() const
+  { return body_; }
+
+  /// Sends [offset, offset+length) of file as the body with sendfile(2)
+  /// instead of body().
+  void setBodyFile(const FilePtr& file, off_t offset, size_t length)
+  {
+    setBodyFile(file);
+    addBodyFileRange(StringPiece(), offset, length);
+  }
+
+  /// Sets the body file without any range, see addBodyFileRange().
+  void setBodyFile(const FilePtr& file)
+  {
+    bodyFile_ = file;
+    fileRanges_.clear();
+    fileTrailer_.clear();
+  }
+
+  /// Appends another slice of bodyFile(), preceded by prefix,
+  /// e.g. a part of multipart/byteranges.
+  void addBodyFileRange(const StringPiece& prefix, off_t offset, size_t length)
+  {
+    FileRange range = { prefix.as_string(), offset, length };
+    fileRanges_.push_back(range);
+  }
+
+  /// Sent after the last file range.
+  void setBodyFileTrailer(const StringPiece& trailer)
+  { fileTrailer_ = trailer.as_string(); }
+
+  void clearBodyFile()
+  {
+    bodyFile_.reset();
+    fileRanges_.clear();
+    fileTrailer_.clear();
+  }
+
+  const FilePtr& bodyFile() const
+  { return bodyFile_; }
+
+  const std::vector<FileRange>& bodyFileRanges() const
+  { return fileRanges_; }
+
+  const string& bodyFileTrailer() const
+  { return fileTrailer_; }
+
+  /// withBody is false for HEAD: the same headers, Content-Length
+  /// included, and no body.
+  void appendToBuffer(Buffer* output, bool withBody = true) const;
+
+  /// Refreshes the cached "Date:" header of the calling thread,
+  /// HttpServer runs it every second in each IO loop.
+  static void updateDateCache(Timestamp now);
 
  private:
-  std::map<string, string> headers_;
+  typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char> > String;
+  // most responses carry a handful of headers, keep them inline
+  typedef boost::container::small_vector<std::pair<String, String>, 8> HeaderList;
+
+  Arena* arena_;
+  HeaderList headers_;
   HttpStatusCode statusCode_;
   // FIXME: add http version
   string statusMessage_;
   bool closeConnection_;
   string body_;
+  FilePtr bodyFile_;
+  std::vector<FileRange> fileRanges_;
+  string fileTrailer_;
 };
@@ -0,0 +1,241 @@
+#include "HttpRouter.h"
+#include "../base/Logging.h"
+
+#include <algorithm>
+
+using namespace std;
+
+HttpRouter::HttpRouter()
+  : nodes_(1, Node(kStatic))
+{
+}
+
+/*
+*radix tree的插入：沿着静态边往下走，找到与text首字符相同的子节点，
+*求公共前缀，如果公共前缀比子节点的边短，就把这条边从公共前缀处劈开，
+*插入一个中间节点。返回text结束处的节点下标。
+*注意nodes_在push_back时可能重新分配内存，所以这里只保存下标，不保存引用。
+*/
+int HttpRouter::insertStatic(int node, StringPiece text)
+{
+  while (!text.empty())
+  {
+    size_t pos = nodes_[node].indices.find(text[0]);
+    if (pos == string::npos)
+    {
+      int child = static_cast<int>(nodes_.size());
+      nodes_.push_back(Node(kStatic));
+      nodes_[child].prefix = text.as_string();
+      nodes_[node].indices.push_back(text[0]);
+      nodes_[node].children.push_back(child);
+      return child;
+    }
+
+    int child = nodes_[node].children[pos];
+    const string& prefix = nodes_[child].prefix;
+    size_t common = 0;
+    size_t maxCommon = std::min(prefix.size(), static_cast<size_t>(text.size()));
+    while (common < maxCommon && prefix[common] == text[static_cast<int>(common)])
+    {
+      ++common;
+    }
+
+    if (common < prefix.size())
+    {
+      // split the edge: node -> mid -> child
+      int mid = static_cast<int>(nodes_.size());
+      nodes_.push_back(Node(kStatic));
+      nodes_[mid].prefix = nodes_[child].prefix.substr(0, common);
+      nodes_[child].prefix.erase(0, common);
+      nodes_[mid].indices.push_back(nodes_[child].prefix[0]);
+      nodes_[mid].children.push_back(child);
+      nodes_[node].children[pos] = mid;
+      child = mid;
+    }
+
+    text.remove_prefix(static_cast<int>(common));
+    node = child;
+  }
+  return node;
+}
+
+int HttpRouter::insertParam(int node, NodeKind kind, const StringPiece& name)
+{
+  int child = kind == kParam ? nodes_[node].paramChild : nodes_[node].wildcardChild;
+  if (child >= 0)
+  {
+    if (StringPiece(nodes_[child].prefix) != name)
+    {
+      return -1;
+    }
+    return child;
+  }
+
+  child = static_cast<int>(nodes_.size());
+  nodes_.push_back(Node(kind));
+  nodes_[child].prefix = name.as_string();
+  if (kind == kParam)
+  {
+    nodes_[node].paramChild = child;
+  }
+  else
+  {
+    nodes_[node].wildcardChild = child;
+  }
+  return child;
+}
+
+bool HttpRouter::addRoute(HttpRequest::Method method,
+                          const string& pattern,
+                          const RouteCallback& cb)
+{
+  if (method <= HttpRequest::kInvalid || method >= kNumMethods
+      || pattern.empty() || pattern[0] != '/')
+  {
+    LOG << "error: HttpRouter::addRoute invalid route " << pattern;
+    return false;
+  }
+
+  const char* p = pattern.data();
+  const char* end = p + pattern.size();
+  int node = 0;
+  int numParams = 0;
+  while (p < end && node >= 0)
+  {
+    const char* special = p;
+    while (special < end
+           && !((*special == ':' || *special == '*') && special[-1] == '/'))
+    {
+      ++special;
+    }
+    node = insertStatic(node, StringPiece(p, static_cast<int>(special - p)));
+    if (special == end)
+    {
+      break;
+    }
+
+    const char* slash = std::find(special, end, '/');
+    StringPiece name(special + 1, static_cast<int>(slash - special - 1));
+    bool wildcard = *special == '*';
+    if (name.empty() || (wildcard && slash != end) || ++numParams > kMaxParams)
+    {
+      node = -1;
+      break;
+    }
+    node = insertParam(node, wildcard ? kWildcard : kParam, name);
+    p = slash;
+  }
+
+  if (node < 0 || nodes_[node].callbacks[method] >= 0)
+  {
+    LOG << "error: HttpRouter::addRoute conflicting route " << pattern;
+    return false;
+  }
+  nodes_[node].callbacks[method] = static_cast<int>(callbacks_.size());
+  callbacks_.push_back(cb);
+  Route route = { method, pattern };
+  routes_.push_back(route);
+  return true;
+}
+
+/*
+*匹配时按 静态边 > 参数 > 通配符 的优先级深度优先搜索，失败时回溯，
+*并把params恢复到进入该节点之前的大小。整个过程不分配内存。
+*/
+int HttpRouter::matchNode(int node,
+                          const char* p,
+                          const char* end,
+                          HttpRequest::Method method,
+                          Params* params) const
+{
+  const Node& n = nodes_[node];
+  const int savedSize = params->size_;
+  if (n.kind == kStatic)
+  {
+    if (static_cast<size_t>(end - p) < n.prefix.size()
+        || memcmp(p, n.prefix.data(), n.prefix.size()) != 0)
+    {
+      return -1;
+    }
+    p += n.prefix.size();
+  }
+  else
+  {
+    const char* last = n.kind == kParam ? std::find(p, end, '/') : end;
+    if (n.kind == kParam && last == p)
+    {
+      return -1;
+    }
+    params->names_[savedSize] = &n.prefix;
+    params->values_[savedSize].set(p, static_cast<int>(last - p));
+    params->size_ = savedSize + 1;
+    p = last;
+  }
+
+  int result = -1;
+  if (p == end)
+  {
+    result = n.callbacks[method];
+    if (result < 0 && method == HttpRequest::kHead)
+    {
+      result = n.callbacks[HttpRequest::kGet];
+    }
+  }
+  else
+  {
+    size_t pos = n.indices.find(*p);
+    if (pos != string::npos)
+    {
+      result = matchNode(n.children[pos], p, end, method, params);
+    }
+    if (result < 0 && n.paramChild >= 0)
+    {
+      result = matchNode(n.paramChild, p, end, method, params);
+    }
+  }
+  if (result < 0 && n.wildcardChild >= 0)
+  {
+    result = matchNode(n.wildcardChild, p, end, method, params);
+  }
+
+  if (result < 0)
+  {
+    params->size_ = savedSize;
+  }
+  return result;
+}
+
+int HttpRouter::matchIndex(HttpRequest::Method method,
+                           const StringPiece& path,
+                           Params* params) const
+{
+  params->size_ = 0;
+  if (method <= HttpRequest::kInvalid || method >= kNumMethods)
+  {
+    return -1;
+  }
+  return matchNode(0, path.begin(), path.end(), method, params);
+}
+
+const HttpRouter::RouteCallback* HttpRouter::match(HttpRequest::Method method,
+                                                   const StringPiece& path,
+                                                   Params* params) const
+{
+  int index = matchIndex(method, path, params);
+  return index >= 0 ? &callbacks_[index] : NULL;
+}
+
+bool HttpRouter::dispatch(const HttpRequest& req, HttpResponse* resp, int* route) const
+{
+  Params params;
+  int index = matchIndex(req.method(), req.path(), &params);
+  if (route)
+  {
+    *route = index;
+  }
+  if (index >= 0)
+  {
+    callbacks_[index](req, params, resp);
+  }
+  return index >= 0;
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "../base/StringPiece.h"
+#include "HttpRequest.h"
+
+#include <boost/noncopyable.hpp>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+class HttpResponse;
+
+/// Method + path request router backed by a radix tree.
+///
+/// Patterns are made of static text, named parameters and a trailing
+/// prefix wildcard:
+/// @code
+///   /users/:id/posts      ":id" matches exactly one path segment
+///   /static/*filepath     "*filepath" matches the rest of the path
+/// @endcode
+/// Static edges win over parameters, parameters win over wildcards.
+///
+/// All nodes live in one vector and refer to each other by index, so the
+/// tree stays compact; matching only walks that vector and records the
+/// parameters as pointers into the request path, it never allocates.
+///
+/// Not thread safe for registration, routes must be added before the server
+/// starts. Matching is const and can be called from any IO thread.
+class HttpRouter : boost::noncopyable
+{
+ public:
+  static const int kMaxParams = 8;
+  static const int kNumMethods = HttpRequest::kDelete + 1;
+
+  /// Path parameters of a matched route, valid as long as the request is.
+  class Params
+  {
+   public:
+    Params()
+      : size_(0)
+    {
+    }
+
+    int size() const { return size_; }
+    const std::string& name(int i) const { return *names_[i]; }
+    StringPiece value(int i) const { return values_[i]; }
+
+    /// Returns an empty piece if there is no such parameter.
+    StringPiece get(const StringPiece& name) const
+    {
+      for (int i = 0; i < size_; ++i)
+      {
+        if (StringPiece(*names_[i]) == name)
+        {
+          return values_[i];
+        }
+      }
+      return StringPiece();
+    }
+
+   private:
+    friend class HttpRouter;
+
+    const std::string* names_[kMaxParams];
+    StringPiece values_[kMaxParams];
+    int size_;
+  };
+
+  typedef std::function<void (const HttpRequest&,
+                              const Params&,
+                              HttpResponse*)> RouteCallback;
+
+  HttpRouter();
+
+  /// Registers cb for method and pattern.
+  /// @return false if the pattern is malformed or conflicts with
+  /// an existing route.
+  bool addRoute(HttpRequest::Method method,
+                const std::string& pattern,
+                const RouteCallback& cb);
+
+  /// Finds the route for method and path, fills params.
+  /// HEAD falls back to GET routes.
+  /// @return NULL if no route matches.
+  const RouteCallback* match(HttpRequest::Method method,
+                             const StringPiece& path,
+                             Params* params) const;
+
+  /// Runs the matching route, stores its index in route if not NULL.
+  /// @return false if no route matches.
+  bool dispatch(const HttpRequest& req, HttpResponse* resp, int* route = NULL) const;
+
+  bool empty() const { return callbacks_.empty(); }
+  size_t numRoutes() const { return callbacks_.size(); }
+  size_t numNodes() const { return nodes_.size(); }
+
+  /// Routes are numbered from 0 in the order they were added.
+  HttpRequest::Method method(int route) const { return routes_[route].method; }
+  const std::string& pattern(int route) const { return routes_[route].pattern; }
+
+ private:
+  enum NodeKind { kStatic, kParam, kWildcard };
+
+  struct Node
+  {
+    explicit Node(NodeKind k)
+      : kind(k),
+        paramChild(-1),
+        wildcardChild(-1)
+    {
+      for (int i = 0; i < kNumMethods; ++i)
+      {
+        callbacks[i] = -1;
+      }
+    }
+
+    NodeKind kind;
+    std::string prefix;   // edge label for kStatic, parameter name otherwise
+    std::string indices;  // first char of each static child
+    std::vector<int> children;
+    int paramChild;
+    int wildcardChild;
+    int callbacks[kNumMethods];  // index into callbacks_, -1 if none
+  };
+
+  struct Route
+  {
+    HttpRequest::Method method;
+    std::string pattern;
+  };
+
+  int insertStatic(int node, StringPiece text);
+  int insertParam(int node, NodeKind kind, const StringPiece& name);
+  int matchIndex(HttpRequest::Method method,
+                 const StringPiece& path,
+                 Params* params) const;
+  int matchNode(int node,
+                const char* p,
+                const char* end,
+                HttpRequest::Method method,
+                Params* params) const;
+
+  std::vector<Node> nodes_;  // nodes_[0] is the root
+  std::vector<RouteCallback> callbacks_;
+  std::vector<Route> routes_;  // parallel to callbacks_
+};
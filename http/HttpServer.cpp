@@ -1,9 +1,15 @@
 #include "HttpServer.h"
 #include <boost/bind.hpp>
 #include "../base/Logging.h"
-#include "HttpContext.h"
+#include "../base/ThreadPool.h"
+#include "HttpFileRange.h"
+#include "HttpMetrics.h"
 #include "HttpRequest.h"
 #include "HttpResponse.h"
+#include "WebSocketCodec.h"
+#include "../reactor/EventLoop.h"
+
+#include <algorithm>
 
 using namespace std;
 
@@ -13,36 +19,195 @@ namespace detail
   void defaultHttpCallback(const HttpRequest&, HttpResponse* resp)
   {
     resp->setStatusCode(HttpResponse::k404NotFound);
-    resp->setStatusMessage("Not Found");
     resp->setCloseConnection(true);
   }
 
+  void updateDateCache()
+  {
+    HttpResponse::updateDateCache(Timestamp::now());
+  }
+
+  void compressBody(HttpResponse* resp, compression::Encoding encoding)
+  {
+    string compressed;
+    if (compression::compress(encoding, resp->body(), &compressed)
+        && compressed.size() < resp->body().size())
+    {
+      resp->setBody(std::move(compressed));
+      resp->addHeader("Content-Encoding", compression::name(encoding));
+    }
+  }
+
+  // a response to HEAD is sent without body, file ranges or trailer
+  void sendResponse(const TcpConnectionPtr& conn,
+                    const HttpResponse& response,
+                    HttpRequest::Method method)
+  {
+    const bool withBody = method != HttpRequest::kHead;
+    Buffer buf;
+    response.appendToBuffer(&buf, withBody);
+    conn->send(&buf);
+    if (withBody && response.bodyFile())
+    {
+      const std::vector<HttpResponse::FileRange>& ranges = response.bodyFileRanges();
+      for (size_t i = 0; i < ranges.size(); ++i)
+      {
+        if (!ranges[i].prefix.empty())
+        {
+          conn->send(ranges[i].prefix);
+        }
+        conn->sendFile(response.bodyFile(), ranges[i].offset, ranges[i].length);
+      }
+      if (!response.bodyFileTrailer().empty())
+      {
+        conn->send(response.bodyFileTrailer());
+      }
+    }
+    if (response.closeConnection())
+    {
+      conn->shutdown();
+    }
+  }
+
 }  // namespace detail
 
 
 HttpServer::HttpServer(EventLoop* loop,
                        const InetAddress& listenAddr)
   : server_(loop, listenAddr),
-    httpCallback_(detail::defaultHttpCallback)
+    httpCallback_(detail::defaultHttpCallback),
+    compressMinBytes_(1024),
+    compressOffloadBytes_(64 * 1024),
+    numCompressThreads_(0),
+    busyPollSeconds_(0),
+    busyPollSocketMicros_(0),
+    metricsEnabled_(false)
 {
   server_.setConnectionCallback(
       boost::bind(&HttpServer::onConnection, this, _1));
   server_.setMessageCallback(
       boost::bind(&HttpServer::onMessage, this, _1, _2, _3));
+  server_.setThreadInitCallback(
+      boost::bind(&HttpServer::onThreadInit, this, _1));
+}
+
+HttpServer::~HttpServer()
+{
 }
 
 void HttpServer::start()
 {
   LOG << "trace: HttpServer[" << server_.name()
     << "] starts listenning on ";
+  if (numCompressThreads_ > 0 && !compressPool_)
+  {
+    compressPool_.reset(new ThreadPool("HttpCompress"));
+    compressPool_->start(numCompressThreads_);
+  }
   server_.start();
 }
 
+void HttpServer::enableMetrics(const string& path)
+{
+  metricsEnabled_ = true;
+  route(HttpRequest::kGet, path,
+        boost::bind(&HttpServer::onMetrics, this, _1, _2, _3));
+  server_.setWriteCompleteCallback(
+      boost::bind(&HttpServer::onWriteComplete, this, _1));
+}
+
+void HttpServer::onMetrics(const HttpRequest&, const HttpRouter::Params&, HttpResponse* resp)
+{
+  string body;
+  metrics::appendLoopMetrics(&body);
+  metrics::appendLockMetrics(&body);
+  std::vector<Histogram> histograms(
+      (router_.numRoutes() + 1) * metrics::RouteLatency::kNumSpans);
+  for (size_t i = 0; i < latencies_.size(); ++i)
+  {
+    latencies_[i].mergeInto(&histograms);
+  }
+  metrics::appendRouteLatency(router_, histograms, &body);
+  resp->setStatusCode(HttpResponse::k200Ok);
+  resp->setContentType(metrics::kContentType);
+  resp->setBody(std::move(body));
+}
+
+// 在每个IO线程里注册刷新Date缓存的定时器
+void HttpServer::onThreadInit(EventLoop* loop)
+{
+  detail::updateDateCache();
+  loop->runEvery(1.0, detail::updateDateCache);
+  if (busyPollSeconds_ > 0)
+  {
+    loop->setBusyPoll(busyPollSeconds_);
+  }
+  if (metricsEnabled_)
+  {
+    // EventLoopThreadPool::start() runs this for one thread at a time
+    latencies_.push_back(new metrics::RouteLatency(static_cast<int>(router_.numRoutes())));
+    latencyLoops_.push_back(loop);
+  }
+}
+
+metrics::RouteLatency* HttpServer::latencyOf(EventLoop* loop)
+{
+  size_t i = std::find(latencyLoops_.begin(), latencyLoops_.end(), loop) - latencyLoops_.begin();
+  assert(i < latencies_.size());
+  return &latencies_[i];
+}
+
+/*
+*响应交给连接时如果已经全部写入socket就立即记录延迟，
+*否则记在context里，等WriteCompleteCallback报告输出缓冲写空时再记录。
+*/
+void HttpServer::onResponseSent(const TcpConnectionPtr& conn,
+                                HttpContext* context,
+                                const HttpContext::Timing& timing)
+{
+  if (conn->writing())
+  {
+    context->unwritten()->push_back(timing);
+    return;
+  }
+  int route = timing.route >= 0 ? timing.route : static_cast<int>(router_.numRoutes());
+  latencyOf(conn->getLoop())->record(route,
+                                     timing.handled - timing.parsed,
+                                     metrics::monotonicNanos() - timing.handled);
+}
+
+void HttpServer::onWriteComplete(const TcpConnectionPtr& conn)
+{
+  HttpContext* context = boost::any_cast<HttpContext>(conn->getMutableContext());
+  if (context == NULL || context->unwritten()->empty())
+  {
+    return;
+  }
+  // pipelined responses drained together all count as written now
+  int64_t now = metrics::monotonicNanos();
+  metrics::RouteLatency* latency = latencyOf(conn->getLoop());
+  const std::vector<HttpContext::Timing>& unwritten = *context->unwritten();
+  for (size_t i = 0; i < unwritten.size(); ++i)
+  {
+    int route = unwritten[i].route >= 0 ? unwritten[i].route : static_cast<int>(router_.numRoutes());
+    latency->record(route, unwritten[i].handled - unwritten[i].parsed, now - unwritten[i].handled);
+  }
+  context->unwritten()->clear();
+}
+
 void HttpServer::onConnection(const TcpConnectionPtr& conn)
 {
   if (conn->connected())
   {
     conn->setContext(HttpContext());
+    if (busyPollSocketMicros_ > 0)
+    {
+      conn->setBusyPoll(busyPollSocketMicros_);
+    }
+  }
+  else if (WebSocketContext* ws = boost::any_cast<WebSocketContext>(conn->getMutableContext()))
+  {
+    ws->codec->onClose(conn);
   }
 }
 
@@ -50,16 +215,38 @@ void HttpServer::onMessage(const TcpConnectionPtr& conn,
                            Buffer* buf,
                            Timestamp receiveTime)
 {
-  HttpContext* context = boost::any_cast<HttpContext>(conn->getMutableContext());
-
-  if (!context->parseRequest(buf, receiveTime))
+  if (WebSocketContext* ws = boost::any_cast<WebSocketContext>(conn->getMutableContext()))
   {
-    conn->send("HTTP/1.1 400 Bad Request\r\n\r\n");
-    conn->shutdown();
+    ws->codec->onMessage(conn, buf, receiveTime);
+    return;
   }
+  HttpContext* context = boost::any_cast<HttpContext>(conn->getMutableContext());
 
-  if (context->gotAll())
+  // handle every pipelined request in buf, unless a response is being
+  // compressed off the IO thread: its successors must not overtake it.
+  while (!context->waiting() && conn->connected())
   {
+    if (!context->parseRequest(buf, receiveTime))
+    {
+      conn->send("HTTP/1.1 400 Bad Request\r\n\r\n");
+      conn->shutdown();
+      break;
+    }
+
+    if (!context->gotAll())
+    {
+      break;
+    }
+    if (!webSockets_.empty() && WebSocketCodec::isUpgrade(context->request()))
+    {
+      std::map<string, WebSocketCodec*>::const_iterator it =
+        webSockets_.find(context->request().path().as_string());
+      if (it != webSockets_.end())
+      {
+        onUpgrade(conn, it->second, buf, receiveTime);  // replaces the context
+        break;
+      }
+    }
     onRequest(conn, context->request());
     context->reset();
   }
@@ -67,17 +254,115 @@ void HttpServer::onMessage(const TcpConnectionPtr& conn,
 
 void HttpServer::onRequest(const TcpConnectionPtr& conn, const HttpRequest& req)
 {
-  const string& connection = req.getHeader("Connection");
+  HttpContext::Timing timing = { -1, metricsEnabled_ ? metrics::monotonicNanos() : 0, 0 };
+  StringPiece connection = req.getHeader("Connection");
   bool close = connection == "close" ||
     (req.getVersion() == HttpRequest::kHttp10 && connection != "Keep-Alive");
-  HttpResponse response(close);
-  httpCallback_(req, &response);
-  Buffer buf;
-  response.appendToBuffer(&buf);
-  conn->send(&buf);
-  if (response.closeConnection())
+  HttpContext* context = boost::any_cast<HttpContext>(conn->getMutableContext());
+  HttpResponse response(close, context->arena());
+  if (!router_.dispatch(req, &response, &timing.route))
+  {
+    httpCallback_(req, &response);
+  }
+  if (response.bodyFile())
+  {
+    filerange::handle(req, &response);
+  }
+  if (metricsEnabled_)
+  {
+    timing.handled = metrics::monotonicNanos();
+  }
+
+  compression::Encoding encoding = compression::kIdentity;
+  if (compressMinBytes_ > 0
+      && !response.bodyFile()
+      && response.body().size() >= compressMinBytes_
+      && response.header("Content-Encoding").empty()
+      && compression::compressible(response.header("Content-Type")))
+  {
+    encoding = compression::negotiate(req.getHeader("Accept-Encoding"));
+    response.addHeader("Vary", "Accept-Encoding");
+  }
+
+  if (encoding != compression::kIdentity
+      && compressPool_
+      && response.body().size() >= compressOffloadBytes_)
+  {
+    context->setWaiting(true);
+    boost::shared_ptr<HttpResponse> pending(new HttpResponse(std::move(response)));
+    compressPool_->run(
+        boost::bind(&HttpServer::compressInPool, this, conn, pending, encoding, req.method(), timing));
+    return;
+  }
+
+  if (encoding != compression::kIdentity)
+  {
+    detail::compressBody(&response, encoding);
+  }
+  detail::sendResponse(conn, response, req.method());
+  if (metricsEnabled_)
   {
-    conn->shutdown();
+    onResponseSent(conn, context, timing);
   }
 }
 
+/*
+*握手成功后连接的context换成WebSocketContext，此后onMessage()把数据交给codec，
+*与握手请求一起到达的帧也立即交给codec处理。
+*/
+void HttpServer::onUpgrade(const TcpConnectionPtr& conn,
+                           WebSocketCodec* codec,
+                           Buffer* buf,
+                           Timestamp receiveTime)
+{
+  HttpContext* context = boost::any_cast<HttpContext>(conn->getMutableContext());
+  HttpResponse response(false);
+  bool upgraded = WebSocketCodec::handshake(context->request(), &response);
+  detail::sendResponse(conn, response, context->request().method());
+  if (!upgraded)
+  {
+    return;
+  }
+
+  conn->setContext(WebSocketContext(codec));
+  codec->onOpen(conn);
+  if (buf->readableBytes() > 0)
+  {
+    codec->onMessage(conn, buf, receiveTime);
+  }
+}
+
+/*
+*大的响应体在compressPool_中压缩，避免阻塞IO线程上的其他连接，
+*压缩完成后回到连接所属的IO线程发送，再继续解析在此期间积压在inputBuffer中的请求。
+*/
+void HttpServer::compressInPool(const TcpConnectionPtr& conn,
+                                const boost::shared_ptr<HttpResponse>& response,
+                                compression::Encoding encoding,
+                                HttpRequest::Method method,
+                                const HttpContext::Timing& timing)
+{
+  detail::compressBody(get_pointer(response), encoding);
+  conn->getLoop()->runInLoop(
+      boost::bind(&HttpServer::onCompressed, this, conn, response, method, timing));
+}
+
+void HttpServer::onCompressed(const TcpConnectionPtr& conn,
+                              const boost::shared_ptr<HttpResponse>& response,
+                              HttpRequest::Method method,
+                              const HttpContext::Timing& timing)
+{
+  conn->getLoop()->assertInLoopThread();
+  detail::sendResponse(conn, *response, method);
+
+  HttpContext* context = boost::any_cast<HttpContext>(conn->getMutableContext());
+  if (metricsEnabled_)
+  {
+    onResponseSent(conn, context, timing);
+  }
+  context->setWaiting(false);
+  if (conn->connected() && conn->inputBuffer()->readableBytes() > 0)
+  {
+    onMessage(conn, conn->inputBuffer(), Timestamp::now());
+  }
+}
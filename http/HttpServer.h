@@ -1,9 +1,24 @@
 #pragma once
 
 #include "../reactor/TcpServer.h"
+#include "HttpCompression.h"
+#include "HttpContext.h"
+#include "HttpRouter.h"
+
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include <map>
 
 class HttpRequest;
 class HttpResponse;
+class ThreadPool;
+class WebSocketCodec;
+
+namespace metrics
+{
+  class RouteLatency;
+}
 
 /// A simple embeddable HTTP server designed for report status of a program.
 /// It is not a fully HTTP 1.1 compliant server, but provides minimum features
@@ -17,6 +32,7 @@ class HttpServer : boost::noncopyable
 
   HttpServer(EventLoop* loop,
              const InetAddress& listenAddr);
+  ~HttpServer();  // force out-line dtor, for scoped_ptr members.
 
   EventLoop* getLoop() const { return server_.getLoop(); }
 
@@ -26,21 +42,101 @@ class HttpServer : boost::noncopyable
     httpCallback_ = cb;
   }
 
+  /// Registers a route, requests matching no route go to the HttpCallback.
+  /// Not thread safe, routes must be added before calling start().
+  /// @return false if the pattern is malformed or conflicts.
+  bool route(HttpRequest::Method method,
+             const string& pattern,
+             const HttpRouter::RouteCallback& cb)
+  {
+    return router_.addRoute(method, pattern, cb);
+  }
+
   void setThreadNum(int numThreads)
   {
     server_.setThreadNum(numThreads);
   }
 
+  /// Compresses text bodies of at least minBytes with gzip or deflate
+  /// if the client accepts it, 0 disables. Default is 1024.
+  void setCompressionThreshold(size_t minBytes)
+  {
+    compressMinBytes_ = minBytes;
+  }
+
+  /// Bodies of at least offloadBytes are compressed in a pool of numThreads
+  /// instead of the IO thread. Must be called before start().
+  void setCompressionThreads(int numThreads, size_t offloadBytes = 64 * 1024)
+  {
+    numCompressThreads_ = numThreads;
+    compressOffloadBytes_ = offloadBytes;
+  }
+
+  /// Lets each IO loop poll without blocking for spinSeconds after activity,
+  /// see EventLoop::setBusyPoll(), and sets SO_BUSY_POLL to socketMicros on
+  /// connections if positive. Must be called before start().
+  void setBusyPoll(double spinSeconds, int socketMicros = 0)
+  {
+    busyPollSeconds_ = spinSeconds;
+    busyPollSocketMicros_ = socketMicros;
+  }
+
+  /// Accepts "Upgrade: websocket" handshakes for path, frames on the
+  /// upgraded connections go to codec, which must outlive the server.
+  /// Not thread safe, must be called before start().
+  void setWebSocketCodec(const string& path, WebSocketCodec* codec)
+  {
+    webSockets_[path] = codec;
+  }
+
+  /// Serves the metrics of all EventLoops and the latency of each route
+  /// in the Prometheus text format on GET path.
+  /// Not thread safe, must be called before start().
+  void enableMetrics(const string& path = "/metrics");
+
   void start();
 
  private:
+  void onThreadInit(EventLoop* loop);
   void onConnection(const TcpConnectionPtr& conn);
   void onMessage(const TcpConnectionPtr& conn,
                  Buffer* buf,
                  Timestamp receiveTime);
   void onRequest(const TcpConnectionPtr&, const HttpRequest&);
+  void onMetrics(const HttpRequest&, const HttpRouter::Params&, HttpResponse* resp);
+  void onResponseSent(const TcpConnectionPtr& conn,
+                      HttpContext* context,
+                      const HttpContext::Timing& timing);
+  void onWriteComplete(const TcpConnectionPtr& conn);
+  metrics::RouteLatency* latencyOf(EventLoop* loop);
+  void onUpgrade(const TcpConnectionPtr& conn,
+                 WebSocketCodec* codec,
+                 Buffer* buf,
+                 Timestamp receiveTime);
+  void compressInPool(const TcpConnectionPtr& conn,
+                      const boost::shared_ptr<HttpResponse>& response,
+                      compression::Encoding encoding,
+                      HttpRequest::Method method,
+                      const HttpContext::Timing& timing);
+  void onCompressed(const TcpConnectionPtr& conn,
+                    const boost::shared_ptr<HttpResponse>& response,
+                    HttpRequest::Method method,
+                    const HttpContext::Timing& timing);
 
   TcpServer server_;
   HttpCallback httpCallback_;
+  HttpRouter router_;
+  size_t compressMinBytes_;
+  size_t compressOffloadBytes_;
+  int numCompressThreads_;
+  double busyPollSeconds_;
+  int busyPollSocketMicros_;
+  boost::scoped_ptr<ThreadPool> compressPool_;
+  std::map<string, WebSocketCodec*> webSockets_;
+  bool metricsEnabled_;
+  // one per IO thread, added by onThreadInit() before start() returns,
+  // read-only afterwards
+  boost::ptr_vector<metrics::RouteLatency> latencies_;
+  std::vector<EventLoop*> latencyLoops_;
 };
 
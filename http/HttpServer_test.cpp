@@ -1,18 +1,26 @@
 #include "HttpServer.h"
 #include "HttpRequest.h"
 #include "HttpResponse.h"
+#include "StaticFileHandler.h"
+#include "WebSocketCodec.h"
 #include "../reactor/EventLoop.h"
+#include "../reactor/LoopWatchdog.h"
+#include "../reactor/Trace.h"
 #include "../base/Logging.h"
+#include "../base/MutexLock.h"
+
+#include <boost/bind.hpp>
 
 #include <iostream>
 #include <map>
+#include <set>
 
 using namespace std;
 
 extern char favicon[555];
 bool benchmark = false;
 
-void onRequest(const HttpRequest& req, HttpResponse* resp)
+void onIndex(const HttpRequest& req, const HttpRouter::Params&, HttpResponse* resp)
 {
   /*std::cout << "Headers " << req.methodString() << " " << req.path() << std::endl;
   if (!benchmark)
@@ -24,40 +32,100 @@ void onRequest(const HttpRequest& req, HttpResponse* resp)
     }
   }*/
 
-  if (req.path() == "/")
-  {
-    resp->setStatusCode(HttpResponse::k200Ok);
-    resp->setStatusMessage("OK");
-    resp->setContentType("text/html");
-    resp->addHeader("Server", "Muduo");
-    string now = Timestamp::now().toFormattedString();
-    resp->setBody("<html><head><title>This is title</title></head>"
-        "<body><h1>Hello</h1>Now is " + now +
-        "</body></html>");
-  }
-  else if (req.path() == "/favicon.ico")
+  resp->setStatusCode(HttpResponse::k200Ok);
+  resp->setContentType("text/html");
+  resp->addHeader("Server", "Muduo");
+  string now = Timestamp::now().toFormattedString();
+  resp->setBody("<html><head><title>This is title</title></head>"
+      "<body><h1>Hello</h1>Now is " + now +
+      "</body></html>");
+}
+
+void onFavicon(const HttpRequest&, const HttpRouter::Params&, HttpResponse* resp)
+{
+  resp->setStatusCode(HttpResponse::k200Ok);
+  resp->setContentType("image/png");
+  resp->setBody(string(favicon, sizeof favicon));
+}
+
+void onHello(const HttpRequest&, const HttpRouter::Params& params, HttpResponse* resp)
+{
+  resp->setStatusCode(HttpResponse::k200Ok);
+  resp->setContentType("text/plain");
+  resp->addHeader("Server", "Muduo");
+  StringPiece name = params.get("name");
+  resp->setBody("hello, " + (name.empty() ? string("world") : name.as_string()) + "!\n");
+}
+
+// GET /trace/on, /trace/off, /trace/dump writes ./trace.bin for bench/TraceToJson
+void onTrace(const HttpRequest&, const HttpRouter::Params& params, HttpResponse* resp)
+{
+  StringPiece action = params.get("action");
+  bool ok = true;
+  if (action == "on" || action == "off")
   {
-    resp->setStatusCode(HttpResponse::k200Ok);
-    resp->setStatusMessage("OK");
-    resp->setContentType("image/png");
-    resp->setBody(string(favicon, sizeof favicon));
+    trace::setEnabled(action == "on");
   }
-  else if (req.path() == "/hello")
+  else if (action == "dump")
   {
-    resp->setStatusCode(HttpResponse::k200Ok);
-    resp->setStatusMessage("OK");
-    resp->setContentType("text/plain");
-    resp->addHeader("Server", "Muduo");
-    resp->setBody("hello, world!\n");
+    ok = trace::dump("trace.bin");
   }
   else
   {
     resp->setStatusCode(HttpResponse::k404NotFound);
-    resp->setStatusMessage("Not Found");
-    resp->setCloseConnection(true);
+    return;
   }
+  resp->setStatusCode(ok ? HttpResponse::k200Ok : HttpResponse::k500InternalServerError);
+  resp->setContentType("text/plain");
+  resp->setBody(ok ? "ok\n" : "failed\n");
 }
 
+// every message sent to /chat is broadcast to all connected WebSocket clients
+class ChatRoom : noncopyable
+{
+ public:
+  ChatRoom()
+    : codec_(boost::bind(&ChatRoom::onMessage, this, _1, _2, _3, _4))
+  {
+    codec_.setOpenCallback(boost::bind(&ChatRoom::onOpen, this, _1));
+    codec_.setCloseCallback(boost::bind(&ChatRoom::onClose, this, _1));
+  }
+
+  WebSocketCodec* codec() { return &codec_; }
+
+ private:
+  typedef std::set<TcpConnectionPtr> ConnectionList;
+
+  void onOpen(const TcpConnectionPtr& conn)
+  {
+    MutexLockGuard lock(mutex_);
+    connections_.insert(conn);
+  }
+
+  void onClose(const TcpConnectionPtr& conn)
+  {
+    MutexLockGuard lock(mutex_);
+    connections_.erase(conn);
+  }
+
+  void onMessage(const TcpConnectionPtr&,
+                 const StringPiece& message,
+                 WebSocketCodec::Opcode opcode,
+                 Timestamp)
+  {
+    ConnectionList connections;
+    {
+      MutexLockGuard lock(mutex_);
+      connections = connections_;
+    }
+    codec_.broadcast(connections.begin(), connections.end(), message, opcode);
+  }
+
+  WebSocketCodec codec_;
+  MutexLock mutex_;
+  ConnectionList connections_;
+};
+
 int main(int argc, char* argv[])
 {
   int numThreads = 0;
@@ -66,9 +134,28 @@ int main(int argc, char* argv[])
     benchmark = true;
     numThreads = atoi(argv[1]);
   }
+  // usage: HttpServer [numThreads] [document root] [busy poll microseconds]
+  StaticFileHandler files(argc > 2 ? argv[2] : ".");
+  ChatRoom chat;
+  EventLoop::setSlowCallbackThreshold(0.1);
+  LoopWatchdog watchdog(1.0);
+  watchdog.start();
   EventLoop loop;
   HttpServer server(&loop, InetAddress(8000));
-  server.setHttpCallback(onRequest);
+  server.route(HttpRequest::kGet, "/", onIndex);
+  server.route(HttpRequest::kGet, "/favicon.ico", onFavicon);
+  server.route(HttpRequest::kGet, "/hello", onHello);
+  server.route(HttpRequest::kGet, "/hello/:name", onHello);
+  server.route(HttpRequest::kGet, "/static/*filepath",
+               boost::bind(&StaticFileHandler::handle, &files, _1, _2, _3));
+  server.route(HttpRequest::kGet, "/trace/:action", onTrace);
+  server.setWebSocketCodec("/chat", chat.codec());
+  server.enableMetrics();
+  server.setCompressionThreads(2);
+  if (argc > 3)
+  {
+    server.setBusyPoll(atoi(argv[3]) / 1e6);
+  }
   server.setThreadNum(numThreads);
   server.start();
   loop.loop();
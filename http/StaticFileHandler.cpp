@@ -0,0 +1,136 @@
+#include "StaticFileHandler.h"
+#include "HttpCompression.h"
+#include "HttpResponse.h"
+#include "../base/FileUtil.h"
+
+#include <string.h>
+#include <strings.h>
+
+using namespace std;
+
+namespace
+{
+
+struct MimeType
+{
+  const char* extension;
+  const char* type;
+};
+
+const MimeType kMimeTypes[] = {
+  { ".html", "text/html" },
+  { ".htm", "text/html" },
+  { ".css", "text/css" },
+  { ".js", "application/javascript" },
+  { ".json", "application/json" },
+  { ".txt", "text/plain" },
+  { ".xml", "application/xml" },
+  { ".svg", "image/svg+xml" },
+  { ".png", "image/png" },
+  { ".jpg", "image/jpeg" },
+  { ".jpeg", "image/jpeg" },
+  { ".gif", "image/gif" },
+  { ".ico", "image/x-icon" },
+  { ".webp", "image/webp" },
+  { ".woff2", "font/woff2" },
+  { ".pdf", "application/pdf" },
+  { ".mp4", "video/mp4" },
+};
+
+// 拒绝包含".."路径段的请求，防止访问document root之外的文件
+bool safePath(const StringPiece& path)
+{
+  if (memchr(path.data(), '\0', path.size()))
+  {
+    return false;
+  }
+  const char* p = path.begin();
+  while (p < path.end())
+  {
+    const char* slash = static_cast<const char*>(memchr(p, '/', path.end() - p));
+    if (!slash)
+    {
+      slash = path.end();
+    }
+    if (slash - p == 2 && p[0] == '.' && p[1] == '.')
+    {
+      return false;
+    }
+    p = slash + 1;
+  }
+  return true;
+}
+
+}  // namespace
+
+StaticFileHandler::StaticFileHandler(const string& root)
+  : root_(root)
+{
+}
+
+const char* StaticFileHandler::mimeType(const StringPiece& path)
+{
+  for (size_t i = 0; i < sizeof kMimeTypes / sizeof kMimeTypes[0]; ++i)
+  {
+    int len = static_cast<int>(strlen(kMimeTypes[i].extension));
+    if (path.size() >= len
+        && strncasecmp(path.end() - len, kMimeTypes[i].extension, len) == 0)
+    {
+      return kMimeTypes[i].type;
+    }
+  }
+  return "application/octet-stream";
+}
+
+void StaticFileHandler::handle(const HttpRequest& req,
+                               const HttpRouter::Params& params,
+                               HttpResponse* resp) const
+{
+  StringPiece relative = params.size() > 0 ? params.value(params.size() - 1) : StringPiece();
+  if (!safePath(relative))
+  {
+    resp->setStatusCode(HttpResponse::k403Forbidden);
+    resp->setCloseConnection(true);
+    return;
+  }
+
+  string path(root_);
+  path += '/';
+  path.append(relative.data(), relative.size());
+  if (relative.empty() || relative[relative.size() - 1] == '/')
+  {
+    path += "index.html";
+  }
+
+  const char* type = mimeType(path);
+  bool compressible = compression::compressible(type);
+  FilePtr file;
+  if (compressible
+      && compression::negotiate(req.getHeader("Accept-Encoding")) == compression::kGzip)
+  {
+    file.reset(new ReadOnlyFile(path + ".gz"));
+    if (file->valid())
+    {
+      resp->addHeader("Content-Encoding", "gzip");
+    }
+  }
+  if (!file || !file->valid())
+  {
+    file.reset(new ReadOnlyFile(path));
+  }
+
+  if (!file->valid())
+  {
+    resp->setStatusCode(HttpResponse::k404NotFound);
+    resp->setCloseConnection(true);
+    return;
+  }
+
+  resp->setStatusCode(HttpResponse::k200Ok);
+  resp->setContentType(type);
+  if (compressible)
+  {
+    resp->addHeader("Vary", "Accept-Encoding");
+  }
+  resp->setBodyFile(file, 0, file->size());
+}
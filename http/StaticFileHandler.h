@@ -0,0 +1,32 @@
+#pragma once
+
+#include "HttpRouter.h"
+
+#include <boost/noncopyable.hpp>
+
+#include <string>
+
+/// Serves files under a document root, for a route ending with a wildcard:
+/// @code
+///   StaticFileHandler files("/var/www");
+///   server.route(HttpRequest::kGet, "/static/*filepath",
+///                boost::bind(&StaticFileHandler::handle, &files, _1, _2, _3));
+/// @endcode
+/// The body is sent with sendfile(2). If the client accepts gzip and a
+/// precompressed "name.gz" sibling exists, the sibling is sent instead.
+class StaticFileHandler : boost::noncopyable
+{
+ public:
+  explicit StaticFileHandler(const std::string& root);
+
+  /// Thread safe.
+  void handle(const HttpRequest& req,
+              const HttpRouter::Params& params,
+              HttpResponse* resp) const;
+
+  /// Content-Type by file extension, "application/octet-stream" if unknown.
+  static const char* mimeType(const StringPiece& path);
+
+ private:
+  const std::string root_;
+};
@@ -0,0 +1,462 @@
+#include "WebSocketCodec.h"
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+#include "../base/Logging.h"
+#include "../reactor/EventLoop.h"
+
+#include <boost/any.hpp>
+
+#include <algorithm>
+
+#include <assert.h>
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+
+const char kWebSocketGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+inline uint32_t rotl(uint32_t x, int n)
+{
+  return (x << n) | (x >> (32 - n));
+}
+
+// SHA-1 of a short message, only the handshake needs it
+void sha1(const std::string& message, unsigned char digest[20])
+{
+  uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+
+  std::string data(message);
+  uint64_t bitLength = static_cast<uint64_t>(message.size()) * 8;
+  data.push_back('\x80');
+  while (data.size() % 64 != 56)
+  {
+    data.push_back('\0');
+  }
+  for (int i = 7; i >= 0; --i)
+  {
+    data.push_back(static_cast<char>(bitLength >> (i * 8)));
+  }
+
+  for (size_t chunk = 0; chunk < data.size(); chunk += 64)
+  {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data.data() + chunk);
+    uint32_t w[80];
+    for (int i = 0; i < 16; ++i)
+    {
+      w[i] = (p[4*i] << 24) | (p[4*i+1] << 16) | (p[4*i+2] << 8) | p[4*i+3];
+    }
+    for (int i = 16; i < 80; ++i)
+    {
+      w[i] = rotl(w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16], 1);
+    }
+
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; ++i)
+    {
+      uint32_t f, k;
+      if (i < 20)
+      {
+        f = (b & c) | (~b & d);
+        k = 0x5A827999;
+      }
+      else if (i < 40)
+      {
+        f = b ^ c ^ d;
+        k = 0x6ED9EBA1;
+      }
+      else if (i < 60)
+      {
+        f = (b & c) | (b & d) | (c & d);
+        k = 0x8F1BBCDC;
+      }
+      else
+      {
+        f = b ^ c ^ d;
+        k = 0xCA62C1D6;
+      }
+      uint32_t temp = rotl(a, 5) + f + e + k + w[i];
+      e = d;
+      d = c;
+      c = rotl(b, 30);
+      b = a;
+      a = temp;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+  }
+
+  for (int i = 0; i < 5; ++i)
+  {
+    digest[4*i] = static_cast<unsigned char>(h[i] >> 24);
+    digest[4*i+1] = static_cast<unsigned char>(h[i] >> 16);
+    digest[4*i+2] = static_cast<unsigned char>(h[i] >> 8);
+    digest[4*i+3] = static_cast<unsigned char>(h[i]);
+  }
+}
+
+std::string base64Encode(const unsigned char* data, size_t len)
+{
+  static const char kTable[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string result;
+  result.reserve((len + 2) / 3 * 4);
+  for (size_t i = 0; i < len; i += 3)
+  {
+    uint32_t n = data[i] << 16;
+    if (i + 1 < len) n |= data[i+1] << 8;
+    if (i + 2 < len) n |= data[i+2];
+    result.push_back(kTable[(n >> 18) & 63]);
+    result.push_back(kTable[(n >> 12) & 63]);
+    result.push_back(i + 1 < len ? kTable[(n >> 6) & 63] : '=');
+    result.push_back(i + 2 < len ? kTable[n & 63] : '=');
+  }
+  return result;
+}
+
+// whether the comma separated header value lists token, case insensitively
+bool containsToken(const StringPiece& value, const char* token)
+{
+  size_t tokenLen = strlen(token);
+  const char* p = value.data();
+  const char* end = p + value.size();
+  while (p < end)
+  {
+    const char* comma = static_cast<const char*>(memchr(p, ',', end - p));
+    if (!comma)
+    {
+      comma = end;
+    }
+    const char* first = p;
+    const char* last = comma;
+    while (first < last && isspace(*first)) ++first;
+    while (last > first && isspace(last[-1])) --last;
+    if (static_cast<size_t>(last - first) == tokenLen
+        && strncasecmp(first, token, tokenLen) == 0)
+    {
+      return true;
+    }
+    p = comma + 1;
+  }
+  return false;
+}
+
+}  // namespace
+
+bool WebSocketCodec::isUpgrade(const HttpRequest& req)
+{
+  return containsToken(req.getHeader("Upgrade"), "websocket");
+}
+
+bool WebSocketCodec::handshake(const HttpRequest& req, HttpResponse* resp)
+{
+  StringPiece key = req.getHeader("Sec-WebSocket-Key");
+  if (req.method() != HttpRequest::kGet
+      || req.getVersion() != HttpRequest::kHttp11
+      || !isUpgrade(req)
+      || !containsToken(req.getHeader("Connection"), "upgrade")
+      || key.size() != 24)  // base64 of 16 random bytes
+  {
+    resp->setStatusCode(HttpResponse::k400BadRequest);
+    resp->setCloseConnection(true);
+    return false;
+  }
+  if (req.getHeader("Sec-WebSocket-Version") != "13")
+  {
+    resp->setStatusCode(HttpResponse::k426UpgradeRequired);
+    resp->addHeader("Sec-WebSocket-Version", "13");
+    resp->setCloseConnection(true);
+    return false;
+  }
+
+  unsigned char digest[20];
+  sha1(key.as_string() + kWebSocketGuid, digest);
+  resp->setStatusCode(HttpResponse::k101SwitchingProtocols);
+  resp->addHeader("Upgrade", "websocket");
+  resp->addHeader("Connection", "Upgrade");
+  resp->addHeader("Sec-WebSocket-Accept", base64Encode(digest, sizeof digest));
+  return true;
+}
+
+void WebSocketCodec::onOpen(const TcpConnectionPtr& conn)
+{
+  if (openCallback_)
+  {
+    openCallback_(conn);
+  }
+}
+
+void WebSocketCodec::onClose(const TcpConnectionPtr& conn)
+{
+  if (closeCallback_)
+  {
+    closeCallback_(conn);
+  }
+}
+
+/*
+*帧头最长14字节：2字节固定头，2或8字节的扩展长度，客户端帧还有4字节掩码。
+*整个帧到齐后直接在inputBuffer中原地去掩码，未分片的消息以指向buffer的StringPiece
+*交给回调，不做拷贝；分片的消息才需要在context中拼接。
+*/
+void WebSocketCodec::onMessage(const TcpConnectionPtr& conn,
+                               Buffer* buf,
+                               Timestamp receiveTime)
+{
+  WebSocketContext* context = boost::any_cast<WebSocketContext>(conn->getMutableContext());
+  assert(context != NULL);
+  while (buf->readableBytes() >= 2 && conn->connected())
+  {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(buf->peek());
+    const bool fin = (p[0] & 0x80) != 0;
+    const int rsv = p[0] & 0x70;
+    const int opcode = p[0] & 0x0F;
+    const bool masked = (p[1] & 0x80) != 0;
+    uint64_t payloadLen = p[1] & 0x7F;
+    size_t headerLen = 2;
+    if (payloadLen == 126)
+    {
+      headerLen = 4;
+      if (buf->readableBytes() < headerLen)
+      {
+        break;
+      }
+      payloadLen = (p[2] << 8) | p[3];
+    }
+    else if (payloadLen == 127)
+    {
+      headerLen = 10;
+      if (buf->readableBytes() < headerLen)
+      {
+        break;
+      }
+      payloadLen = 0;
+      for (int i = 2; i < 10; ++i)
+      {
+        payloadLen = (payloadLen << 8) | p[i];
+      }
+    }
+
+    const bool control = (opcode & 0x08) != 0;
+    if (rsv != 0 || !masked  // no extension negotiated, clients must mask
+        || (control && (!fin || payloadLen > 125 || opcode > kPong))
+        || (!control && opcode > kBinary))
+    {
+      LOG << "error: WebSocketCodec bad frame from " << conn->name();
+      failConnection(conn, context, kProtocolError);
+      break;
+    }
+    if (payloadLen > maxMessageBytes_)
+    {
+      failConnection(conn, context, kMessageTooBig);
+      break;
+    }
+
+    headerLen += 4;
+    if (buf->readableBytes() < headerLen + payloadLen)
+    {
+      break;
+    }
+    const size_t len = static_cast<size_t>(payloadLen);
+    char* payload = const_cast<char*>(buf->peek()) + headerLen;
+    applyMask(payload, len, payload - 4);
+    bool more = handleFrame(conn, context, opcode, fin,
+                            StringPiece(payload, static_cast<int>(len)), receiveTime);
+    buf->retrieve(headerLen + len);
+    if (!more)
+    {
+      break;
+    }
+  }
+}
+
+bool WebSocketCodec::handleFrame(const TcpConnectionPtr& conn,
+                                 WebSocketContext* context,
+                                 int opcode,
+                                 bool fin,
+                                 const StringPiece& payload,
+                                 Timestamp receiveTime)
+{
+  switch (opcode)
+  {
+    case kPing:
+      send(conn, payload, kPong);
+      return true;
+    case kPong:
+      return true;
+    case kClose:
+      if (payload.size() == 1)
+      {
+        failConnection(conn, context, kProtocolError);
+        return false;
+      }
+      if (!context->closeSent)
+      {
+        // echo the status code, then the server closes the TCP connection
+        send(conn, StringPiece(payload.data(), payload.size() >= 2 ? 2 : 0), kClose);
+        context->closeSent = true;
+      }
+      conn->shutdown();
+      return false;
+    case kContinuation:
+      if (context->messageOpcode == 0)
+      {
+        failConnection(conn, context, kProtocolError);
+        return false;
+      }
+      if (context->fragments.size() + payload.size() > maxMessageBytes_)
+      {
+        failConnection(conn, context, kMessageTooBig);
+        return false;
+      }
+      context->fragments.append(payload.data(), payload.size());
+      if (fin)
+      {
+        std::string message;
+        message.swap(context->fragments);
+        Opcode messageOpcode = static_cast<Opcode>(context->messageOpcode);
+        context->messageOpcode = 0;
+        messageCallback_(conn, message, messageOpcode, receiveTime);
+      }
+      return true;
+    default:  // kText or kBinary
+      if (context->messageOpcode != 0)
+      {
+        failConnection(conn, context, kProtocolError);
+        return false;
+      }
+      if (fin)
+      {
+        messageCallback_(conn, payload, static_cast<Opcode>(opcode), receiveTime);
+      }
+      else
+      {
+        context->messageOpcode = opcode;
+        context->fragments.assign(payload.data(), payload.size());
+      }
+      return true;
+  }
+}
+
+void WebSocketCodec::failConnection(const TcpConnectionPtr& conn,
+                                    WebSocketContext* context,
+                                    CloseCode code)
+{
+  if (!context->closeSent)
+  {
+    char payload[2] = { static_cast<char>(code >> 8), static_cast<char>(code) };
+    send(conn, StringPiece(payload, 2), kClose);
+    context->closeSent = true;
+  }
+  conn->shutdown();
+}
+
+void WebSocketCodec::send(const TcpConnectionPtr& conn,
+                          const StringPiece& message,
+                          Opcode opcode)
+{
+  char header[kMaxHeaderLen];
+  size_t headerLen = encodeHeader(header, opcode, true, message.size());
+  Buffer buf;
+  buf.ensureWritableBytes(headerLen + message.size());
+  buf.append(header, headerLen);
+  buf.append(message);
+  conn->send(&buf);
+}
+
+void WebSocketCodec::close(const TcpConnectionPtr& conn,
+                           CloseCode code,
+                           const StringPiece& reason)
+{
+  conn->getLoop()->assertInLoopThread();
+  WebSocketContext* context = boost::any_cast<WebSocketContext>(conn->getMutableContext());
+  if (context == NULL || context->closeSent)
+  {
+    return;
+  }
+  // control frame payloads are limited to 125 bytes
+  std::string payload;
+  payload.push_back(static_cast<char>(code >> 8));
+  payload.push_back(static_cast<char>(code));
+  payload.append(reason.data(), std::min(reason.size(), 123));
+  send(conn, payload, kClose);
+  context->closeSent = true;
+}
+
+WebSocketCodec::FramePtr WebSocketCodec::makeFrame(Opcode opcode, const StringPiece& payload)
+{
+  char header[kMaxHeaderLen];
+  size_t headerLen = encodeHeader(header, opcode, true, payload.size());
+  boost::shared_ptr<std::string> frame(new std::string);
+  frame->reserve(headerLen + payload.size());
+  frame->append(header, headerLen);
+  frame->append(payload.data(), payload.size());
+  return frame;
+}
+
+size_t WebSocketCodec::encodeHeader(char* buf, Opcode opcode, bool fin, uint64_t payloadLen)
+{
+  unsigned char* p = reinterpret_cast<unsigned char*>(buf);
+  p[0] = static_cast<unsigned char>((fin ? 0x80 : 0) | opcode);
+  if (payloadLen < 126)
+  {
+    p[1] = static_cast<unsigned char>(payloadLen);
+    return 2;
+  }
+  else if (payloadLen <= 0xFFFF)
+  {
+    p[1] = 126;
+    p[2] = static_cast<unsigned char>(payloadLen >> 8);
+    p[3] = static_cast<unsigned char>(payloadLen);
+    return 4;
+  }
+  else
+  {
+    p[1] = 127;
+    for (int i = 0; i < 8; ++i)
+    {
+      p[2+i] = static_cast<unsigned char>(payloadLen >> (56 - 8 * i));
+    }
+    return 10;
+  }
+}
+
+/*
+*掩码按4字节循环，把它复制成16字节(SSE2)和8字节的整数后即可整块异或，
+*每次处理的字节数都是4的倍数，所以剩余部分仍从key[0]开始对齐。
+*/
+void WebSocketCodec::applyMask(char* data, size_t len, const char key[4])
+{
+  uint32_t key32;
+  memcpy(&key32, key, sizeof key32);
+  size_t i = 0;
+#ifdef __SSE2__
+  const __m128i key128 = _mm_set1_epi32(static_cast<int>(key32));
+  for (; i + 16 <= len; i += 16)
+  {
+    __m128i* p = reinterpret_cast<__m128i*>(data + i);
+    _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), key128));
+  }
+#endif
+  const uint64_t key64 = (static_cast<uint64_t>(key32) << 32) | key32;
+  for (; i + 8 <= len; i += 8)
+  {
+    uint64_t v;
+    memcpy(&v, data + i, sizeof v);
+    v ^= key64;
+    memcpy(data + i, &v, sizeof v);
+  }
+  for (; i < len; ++i)
+  {
+    data[i] ^= key[i & 3];
+  }
+}
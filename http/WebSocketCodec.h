@@ -0,0 +1,165 @@
+#pragma once
+
+#include "../base/StringPiece.h"
+#include "../base/Timestamp.h"
+#include "../reactor/Buffer.h"
+#include "../reactor/Callbacks.h"
+#include "../reactor/TcpConnection.h"
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <stdint.h>
+#include <string>
+
+class HttpRequest;
+class HttpResponse;
+class WebSocketCodec;
+
+/// Per connection state of an upgraded connection, kept in its context.
+struct WebSocketContext
+{
+  explicit WebSocketContext(WebSocketCodec* c)
+    : codec(c),
+      messageOpcode(0),
+      closeSent(false)
+  {
+  }
+
+  WebSocketCodec* codec;
+  int messageOpcode;     // kText or kBinary while a fragmented message is pending
+  std::string fragments; // payload of the pending fragments
+  bool closeSent;
+};
+
+///
+/// RFC 6455 frame codec for connections upgraded by HttpServer.
+///
+/// Fragmented messages are reassembled, pings are answered and the
+/// closing handshake is completed here; complete messages go to the
+/// message callback.
+class WebSocketCodec : boost::noncopyable
+{
+ public:
+  enum Opcode
+  {
+    kContinuation = 0x0,
+    kText = 0x1,
+    kBinary = 0x2,
+    kClose = 0x8,
+    kPing = 0x9,
+    kPong = 0xA,
+  };
+
+  enum CloseCode
+  {
+    kNormalClosure = 1000,
+    kGoingAway = 1001,
+    kProtocolError = 1002,
+    kUnsupportedData = 1003,
+    kMessageTooBig = 1009,
+  };
+
+  /// message is only valid during the callback, it points into the
+  /// input buffer unless the message was fragmented.
+  typedef boost::function<void (const TcpConnectionPtr&,
+                                const StringPiece& message,
+                                Opcode opcode,
+                                Timestamp)> WebSocketMessageCallback;
+  typedef boost::function<void (const TcpConnectionPtr&)> WebSocketConnectionCallback;
+  typedef boost::shared_ptr<const std::string> FramePtr;
+
+  explicit WebSocketCodec(const WebSocketMessageCallback& cb,
+                          size_t maxMessageBytes = 16 * 1024 * 1024)
+    : messageCallback_(cb),
+      maxMessageBytes_(maxMessageBytes)
+  {
+  }
+
+  /// Called in the IO thread once the 101 response has been sent.
+  void setOpenCallback(const WebSocketConnectionCallback& cb)
+  { openCallback_ = cb; }
+
+  /// Called in the IO thread when an upgraded connection goes down.
+  void setCloseCallback(const WebSocketConnectionCallback& cb)
+  { closeCallback_ = cb; }
+
+  ///
+  /// Validates an upgrade request and fills in the 101 response,
+  /// or a 400/426 response if it is not a valid version 13 handshake.
+  /// @return true if the connection should be upgraded.
+  static bool handshake(const HttpRequest& req, HttpResponse* resp);
+
+  /// Whether req asks for "Upgrade: websocket".
+  static bool isUpgrade(const HttpRequest& req);
+
+  /// Used by HttpServer after the handshake.
+  void onOpen(const TcpConnectionPtr& conn);
+  void onClose(const TcpConnectionPtr& conn);
+
+  void onMessage(const TcpConnectionPtr& conn,
+                 Buffer* buf,
+                 Timestamp receiveTime);
+
+  // Thread safe.
+  void send(const TcpConnectionPtr& conn,
+            const StringPiece& message,
+            Opcode opcode = kText);
+
+  /// Sends a frame built by makeFrame(), without copying it
+  /// when called from another thread. Thread safe.
+  void send(const TcpConnectionPtr& conn, const FramePtr& frame)
+  { conn->send(frame); }
+
+  /// Starts the closing handshake, the TCP connection is shut down
+  /// when the peer's close frame arrives. Must be called in the IO thread.
+  void close(const TcpConnectionPtr& conn,
+             CloseCode code = kNormalClosure,
+             const StringPiece& reason = StringPiece());
+
+  ///
+  /// Serializes message into one frame and sends the same buffer to every
+  /// connection in [first, last), e.g. a std::set<TcpConnectionPtr>.
+  template <typename Iter>
+  void broadcast(Iter first, Iter last,
+                 const StringPiece& message,
+                 Opcode opcode = kText)
+  {
+    FramePtr frame = makeFrame(opcode, message);
+    for (; first != last; ++first)
+    {
+      send(*first, frame);
+    }
+  }
+
+  /// An unmasked (server to client) frame with FIN set.
+  static FramePtr makeFrame(Opcode opcode, const StringPiece& payload);
+
+  /// Writes the header of an unmasked frame into buf,
+  /// which must hold kMaxHeaderLen bytes, returns its length.
+  static size_t encodeHeader(char* buf, Opcode opcode, bool fin, uint64_t payloadLen);
+
+  ///
+  /// XORs data with the 4-byte masking key, 16 bytes at a time.
+  /// Masking and unmasking are the same operation.
+  static void applyMask(char* data, size_t len, const char key[4]);
+
+  static const size_t kMaxHeaderLen = 14;
+
+ private:
+  bool handleFrame(const TcpConnectionPtr& conn,
+                   WebSocketContext* context,
+                   int opcode,
+                   bool fin,
+                   const StringPiece& payload,
+                   Timestamp receiveTime);
+  void failConnection(const TcpConnectionPtr& conn,
+                      WebSocketContext* context,
+                      CloseCode code);
+
+  WebSocketMessageCallback messageCallback_;
+  WebSocketConnectionCallback openCallback_;
+  WebSocketConnectionCallback closeCallback_;
+  const size_t maxMessageBytes_;
+};
@@ -1,9 +1,9 @@
 #pragma once
 
-#include <boost/function.hpp>
 #include <boost/noncopyable.hpp>
 
 #include "Channel.h"
+#include "Function.h"
 #include "Socket.h"
 
 class EventLoop;
@@ -15,14 +15,14 @@ class InetAddress;
 class Acceptor : boost::noncopyable
 {
  public:
-  typedef boost::function<void (int sockfd,
-                                const InetAddress&)> NewConnectionCallback;
+  typedef Function<void (int sockfd,
+                         const InetAddress&)> NewConnectionCallback;
 
   Acceptor(EventLoop* loop, const InetAddress& listenAddr);
   ~Acceptor();
 
-  void setNewConnectionCallback(const NewConnectionCallback& cb)
-  { newConnectionCallback_ = cb; }
+  void setNewConnectionCallback(NewConnectionCallback cb)
+  { newConnectionCallback_ = std::move(cb); }
 
   bool listenning() const { return listenning_; }
   void listen();
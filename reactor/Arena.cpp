@@ -0,0 +1,38 @@
+#include "Arena.h"
+#include "BufferPool.h"
+
+#include <algorithm>
+
+const size_t Arena::kChunkSize;
+
+/*
+*chunk头部记录链表指针和容量，reset()时逐个还给BufferPool，
+*一个请求通常只用到一个4KB的chunk，所以reset()实际上是O(1)的，
+*空闲的keep-alive连接不持有任何arena内存。
+*/
+void* Arena::allocateSlow(size_t size, size_t align)
+{
+  size_t header = (sizeof(Chunk) + align - 1) & ~(align - 1);
+  size_t capacity = 0;
+  char* storage = BufferPool::allocate(std::max(kChunkSize, header + size), &capacity);
+  Chunk* chunk = reinterpret_cast<Chunk*>(storage);
+  chunk->capacity = capacity;
+  chunk->next = chunks_;
+  chunks_ = chunk;
+  char* p = alignUp(storage + sizeof(Chunk), align);
+  ptr_ = p + size;
+  end_ = storage + capacity;
+  return p;
+}
+
+void Arena::reset()
+{
+  while (chunks_)
+  {
+    Chunk* chunk = chunks_;
+    chunks_ = chunk->next;
+    BufferPool::deallocate(reinterpret_cast<char*>(chunk), chunk->capacity);
+  }
+  ptr_ = NULL;
+  end_ = NULL;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "../base/noncopyable.h"
+
+#include <new>
+
+#include <stddef.h>
+
+///
+/// A bump allocator over BufferPool chunks for objects that all die at once,
+/// e.g. the strings of one HTTP request.
+///
+/// allocate() only moves a pointer, deallocation is a no-op and reset()
+/// gives every chunk back to the pool of the calling thread. Not thread safe.
+class Arena : noncopyable
+{
+ public:
+  static const size_t kChunkSize = 4096;
+
+  Arena()
+    : chunks_(NULL),
+      ptr_(NULL),
+      end_(NULL)
+  {
+  }
+
+  ~Arena()
+  {
+    reset();
+  }
+
+  void* allocate(size_t size, size_t align)
+  {
+    char* p = alignUp(ptr_, align);
+    if (p + size > end_ || ptr_ == NULL)
+    {
+      return allocateSlow(size, align);
+    }
+    ptr_ = p + size;
+    return p;
+  }
+
+  /// Invalidates everything allocated so far.
+  void reset();
+
+  bool empty() const
+  { return chunks_ == NULL; }
+
+ private:
+  struct Chunk
+  {
+    Chunk* next;
+    size_t capacity;
+  };
+
+  static char* alignUp(char* p, size_t align)
+  {
+    return reinterpret_cast<char*>(
+        (reinterpret_cast<size_t>(p) + align - 1) & ~(align - 1));
+  }
+
+  void* allocateSlow(size_t size, size_t align);
+
+  Chunk* chunks_;  // newest first
+  char* ptr_;
+  char* end_;
+};
+
+///
+/// A C++11 allocator drawing from an Arena, or from operator new without one,
+/// for allocator-aware containers whose elements die with the arena.
+template <typename T>
+class ArenaAllocator
+{
+ public:
+  typedef T value_type;
+
+  ArenaAllocator()
+    : arena_(NULL)
+  {
+  }
+
+  explicit ArenaAllocator(Arena* arena)
+    : arena_(arena)
+  {
+  }
+
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& rhs)
+    : arena_(rhs.arena())
+  {
+  }
+
+  template <typename U>
+  struct rebind
+  {
+    typedef ArenaAllocator<U> other;
+  };
+
+  T* allocate(size_t n)
+  {
+    if (arena_)
+    {
+      return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+    }
+    return static_cast<T*>(::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(T* p, size_t)
+  {
+    if (!arena_)
+    {
+      ::operator delete(p);
+    }
+  }
+
+  Arena* arena() const
+  { return arena_; }
+
+ private:
+  Arena* arena_;
+};
+
+template <typename T, typename U>
+inline bool operator==(const ArenaAllocator<T>& lhs, const ArenaAllocator<U>& rhs)
+{ return lhs.arena() == rhs.arena(); }
+
+template <typename T, typename U>
+inline bool operator!=(const ArenaAllocator<T>& lhs, const ArenaAllocator<U>& rhs)
+{ return lhs.arena() != rhs.arena(); }
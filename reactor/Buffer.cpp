@@ -9,6 +9,9 @@
 using namespace std;
 
 const char Buffer::kCRLF[] = "\r\n";
+const size_t Buffer::kCheapPrepend;
+const size_t Buffer::kInitialSize;
+char Buffer::emptyStorage_[Buffer::kCheapPrepend];
 /*
 *在非阻塞网络编程中，如何设计并使用缓冲区？一方面我们希望减少系统调用，一次读的数据越多越划算，那么似乎应该准备一个大的缓冲区。
 *另一方面，我们系统减少内存占用。如果有 10k 个连接，每个连接一建立就分配 64k 的读缓冲的话，将占用 640M 内存，
@@ -19,23 +22,40 @@ const char Buffer::kCRLF[] = "\r\n";
 *结合栈上的空间，避免内存使用过大，提高内存使用率
 *
 *readv则将从fd读入的数据按同样的顺序散布到各缓冲区中，readv总是先填满一个缓冲区，然后再填下一个，避免了多次系统调用
+*
+*空闲的Buffer不持有chunk，读之前才从BufferPool取一个，什么也没读到就立即还回去。
+*TcpConnection不使用栈上的extrabuf，而是用所属EventLoop的64KB scratch，见TcpConnection::handleRead()。
 */
 ssize_t Buffer::readFd(int fd, int* savedErrno)
 {
   char extrabuf[65536];
+  return readFd(fd, extrabuf, sizeof extrabuf, savedErrno);
+}
+
+ssize_t Buffer::readFd(int fd, char* extrabuf, size_t extrabufLen, int* savedErrno)
+{
+  if (!hasStorage())
+  {
+    makeSpace(kInitialSize);
+  }
   struct iovec vec[2];
   const size_t writable = writableBytes();
   vec[0].iov_base = begin()+writerIndex_;// 第一块缓冲区
   vec[0].iov_len = writable;
   vec[1].iov_base = extrabuf;// 第二块缓冲区
-  vec[1].iov_len = sizeof extrabuf;
-  const ssize_t n = readv(fd, vec, 2);
-  if (n < 0) {
-    *savedErrno = errno;
+  vec[1].iov_len = extrabufLen;
+  const ssize_t n = readv(fd, vec, extrabuf ? 2 : 1);
+  if (n <= 0) {
+    if (n < 0) {
+      *savedErrno = errno;
+    }
+    if (readableBytes() == 0) {
+      release();
+    }
   } else if (static_cast<size_t>(n) <= writable) { //第一块缓冲区足够容纳
     writerIndex_ += n;
   } else {// 当前缓冲区，不够容纳，因而数据被接收到了第二块缓冲区extrabuf，将其append至buffer
-    writerIndex_ = buffer_.size();
+    writerIndex_ = capacity_;
     append(extrabuf, n - writable);
   }
   return n;
@@ -1,12 +1,17 @@
 #pragma once
 
 #include "../base/copyable.h"
+#include "../base/StringPiece.h"
+#include "BufferPool.h"
+#include "SocketsOps.h"
 
 #include <algorithm>
 #include <string>
 #include <vector>
 
 #include <assert.h>
+#include <stdint.h>
+#include <string.h>
 
 /// A buffer class modeled after org.jboss.netty.buffer.ChannelBuffer
 ///
@@ -18,36 +23,112 @@
 /// |                   |                  |                  |
 /// 0      <=      readerIndex   <=   writerIndex    <=     size
 /// @endcode
+///
+/// The storage is a chunk from BufferPool, acquired on the first write and
+/// given back whenever the buffer is drained, so an idle connection holds
+/// no buffer memory. It may also borrow() memory it does not own, such as
+/// the read scratch of an EventLoop.
 class Buffer : public copyable
 {
  public:
   static const size_t kCheapPrepend = 8;//初始化prepend为8个字节大小
-  static const size_t kInitialSize = 1024;//初始化Buffer大小为1024字节 默认
+  static const size_t kInitialSize = BufferPool::kMinChunk - kCheapPrepend;//第一次分配的可写空间
 
   Buffer()
-    : buffer_(kCheapPrepend + kInitialSize),
+    : buffer_(emptyStorage()),
+      capacity_(kCheapPrepend),
       readerIndex_(kCheapPrepend),
-      writerIndex_(kCheapPrepend)
+      writerIndex_(kCheapPrepend),
+      borrowed_(false)
   {
     assert(readableBytes() == 0);
-    assert(writableBytes() == kInitialSize);
+    assert(writableBytes() == 0);
     assert(prependableBytes() == kCheapPrepend);
   }
 
-  // default copy-ctor, dtor and assignment are fine
+  Buffer(const Buffer& rhs)
+    : buffer_(emptyStorage()),
+      capacity_(kCheapPrepend),
+      readerIndex_(kCheapPrepend),
+      writerIndex_(kCheapPrepend),
+      borrowed_(false)
+  {
+    append(rhs.peek(), rhs.readableBytes());
+  }
+
+  Buffer(Buffer&& rhs)
+    : buffer_(rhs.buffer_),
+      capacity_(rhs.capacity_),
+      readerIndex_(rhs.readerIndex_),
+      writerIndex_(rhs.writerIndex_),
+      borrowed_(rhs.borrowed_)
+  {
+    rhs.buffer_ = emptyStorage();
+    rhs.capacity_ = kCheapPrepend;
+    rhs.readerIndex_ = kCheapPrepend;
+    rhs.writerIndex_ = kCheapPrepend;
+    rhs.borrowed_ = false;
+  }
+
+  Buffer& operator=(Buffer rhs)
+  {
+    swap(rhs);
+    return *this;
+  }
+
+  ~Buffer()
+  {
+    release();
+  }
 
   void swap(Buffer& rhs)
   {
-    buffer_.swap(rhs.buffer_);
+    std::swap(buffer_, rhs.buffer_);
+    std::swap(capacity_, rhs.capacity_);
     std::swap(readerIndex_, rhs.readerIndex_);
     std::swap(writerIndex_, rhs.writerIndex_);
+    std::swap(borrowed_, rhs.borrowed_);
   }
 
   size_t readableBytes() const//计算可读
   { return writerIndex_ - readerIndex_; }
 
   size_t writableBytes() const//计算可写
-  { return buffer_.size() - writerIndex_; }
+  { return capacity_ - writerIndex_; }
+
+  /// Bytes of pooled storage held, 0 when drained.
+  size_t internalCapacity() const
+  { return hasStorage() && !borrowed_ ? capacity_ : 0; }
+
+  /// Uses data[0, len) as storage without owning it, the buffer must be
+  /// empty. Call ownStorage() before data goes away.
+  void borrow(char* data, size_t len)
+  {
+    assert(readableBytes() == 0);
+    assert(len > kCheapPrepend);
+    release();
+    buffer_ = data;
+    capacity_ = len;
+    readerIndex_ = kCheapPrepend;
+    writerIndex_ = kCheapPrepend;
+    borrowed_ = true;
+  }
+
+  /// Copies the readable bytes out of borrowed storage into a pooled chunk.
+  void ownStorage()
+  {
+    if (borrowed_)
+    {
+      if (readableBytes() > 0)
+      {
+        reallocate(0);
+      }
+      else
+      {
+        retrieveAll();
+      }
+    }
+  }
 
   size_t prependableBytes() const
   { return readerIndex_; }
@@ -68,7 +149,14 @@ class Buffer : public copyable
   void retrieve(size_t len)//该函数用来回收Buffer空间，在读取Buffer的内容后,调用此函数来挪动索引
   {
     assert(len <= readableBytes());
-    readerIndex_ += len;
+    if (len < readableBytes())
+    {
+      readerIndex_ += len;
+    }
+    else
+    {
+      retrieveAll();
+    }
   }
 
   void retrieveUntil(const char* end)
@@ -78,12 +166,25 @@ class Buffer : public copyable
     retrieve(end - peek());
   }
 
-  void retrieveAll()//回收所有Buffer，将两个索引回归到初始位置
+  void retrieveAll()//回收所有Buffer，将两个索引回归到初始位置，并把存储还给BufferPool
   {
     readerIndex_ = kCheapPrepend;
     writerIndex_ = kCheapPrepend;
+    release();
   }
   
+  void retrieveInt64()
+  { retrieve(sizeof(int64_t)); }
+
+  void retrieveInt32()
+  { retrieve(sizeof(int32_t)); }
+
+  void retrieveInt16()
+  { retrieve(sizeof(int16_t)); }
+
+  void retrieveInt8()
+  { retrieve(sizeof(int8_t)); }
+
   std::string retrieveAllAsString()//读取buffer所有的内容
   {
     std::string str(peek(), readableBytes());
@@ -91,15 +192,15 @@ class Buffer : public copyable
     return str;
   }
 
-  void append(const std::string& str)
+  void append(const StringPiece& str)
   {
-    append(str.data(), str.length());
+    append(str.data(), str.size());
   }
 
   void append(const char* /*restrict*/ data, size_t len)//写入数据
   {
     ensureWritableBytes(len);//保证Buffer有足够空间可写
-    std::copy(data, data+len, beginWrite());
+    memcpy(beginWrite(), data, len);
     hasWritten(len);
   }
 
@@ -117,6 +218,139 @@ class Buffer : public copyable
     assert(writableBytes() >= len);
   }
 
+  ///
+  /// Append int64_t using network endian
+  ///
+  void appendInt64(int64_t x)
+  {
+    int64_t be64 = sockets::hostToNetwork64(x);
+    append(&be64, sizeof be64);
+  }
+
+  ///
+  /// Append int32_t using network endian
+  ///
+  void appendInt32(int32_t x)
+  {
+    int32_t be32 = sockets::hostToNetwork32(x);
+    append(&be32, sizeof be32);
+  }
+
+  void appendInt16(int16_t x)
+  {
+    int16_t be16 = sockets::hostToNetwork16(x);
+    append(&be16, sizeof be16);
+  }
+
+  void appendInt8(int8_t x)
+  {
+    append(&x, sizeof x);
+  }
+
+  ///
+  /// Read int64_t from network endian
+  ///
+  /// Require: buf->readableBytes() >= sizeof(int64_t)
+  int64_t readInt64()
+  {
+    int64_t result = peekInt64();
+    retrieveInt64();
+    return result;
+  }
+
+  ///
+  /// Read int32_t from network endian
+  ///
+  /// Require: buf->readableBytes() >= sizeof(int32_t)
+  int32_t readInt32()
+  {
+    int32_t result = peekInt32();
+    retrieveInt32();
+    return result;
+  }
+
+  int16_t readInt16()
+  {
+    int16_t result = peekInt16();
+    retrieveInt16();
+    return result;
+  }
+
+  int8_t readInt8()
+  {
+    int8_t result = peekInt8();
+    retrieveInt8();
+    return result;
+  }
+
+  ///
+  /// Peek int64_t from network endian, the data may be unaligned
+  ///
+  /// Require: buf->readableBytes() >= sizeof(int64_t)
+  int64_t peekInt64() const
+  {
+    assert(readableBytes() >= sizeof(int64_t));
+    int64_t be64 = 0;
+    ::memcpy(&be64, peek(), sizeof be64);
+    return sockets::networkToHost64(be64);
+  }
+
+  ///
+  /// Peek int32_t from network endian, the data may be unaligned
+  ///
+  /// Require: buf->readableBytes() >= sizeof(int32_t)
+  int32_t peekInt32() const
+  {
+    assert(readableBytes() >= sizeof(int32_t));
+    int32_t be32 = 0;
+    ::memcpy(&be32, peek(), sizeof be32);
+    return sockets::networkToHost32(be32);
+  }
+
+  int16_t peekInt16() const
+  {
+    assert(readableBytes() >= sizeof(int16_t));
+    int16_t be16 = 0;
+    ::memcpy(&be16, peek(), sizeof be16);
+    return sockets::networkToHost16(be16);
+  }
+
+  int8_t peekInt8() const
+  {
+    assert(readableBytes() >= sizeof(int8_t));
+    int8_t x = *peek();
+    return x;
+  }
+
+  ///
+  /// Prepend int64_t using network endian
+  ///
+  void prependInt64(int64_t x)
+  {
+    int64_t be64 = sockets::hostToNetwork64(x);
+    prepend(&be64, sizeof be64);
+  }
+
+  ///
+  /// Prepend int32_t using network endian
+  ///
+  void prependInt32(int32_t x)
+  {
+    int32_t be32 = sockets::hostToNetwork32(x);
+    prepend(&be32, sizeof be32);
+  }
+
+  void prependInt16(int16_t x)
+  {
+    int16_t be16 = sockets::hostToNetwork16(x);
+    prepend(&be16, sizeof be16);
+  }
+
+  void prependInt8(int8_t x)
+  {
+    prepend(&x, sizeof x);
+  }
+
   char* beginWrite()
   { return begin() + writerIndex_; }
 
@@ -129,6 +363,10 @@ class Buffer : public copyable
   void prepend(const void* /*restrict*/ data, size_t len)
   {
     assert(len <= prependableBytes());
+    if (!hasStorage())
+    {
+      makeSpace(kInitialSize);
+    }
     readerIndex_ -= len;
     const char* d = static_cast<const char*>(data);
     std::copy(d, d+len, begin()+readerIndex_);
@@ -136,9 +374,14 @@ class Buffer : public copyable
 
   void shrink(size_t reserve)
   {
-   std::vector<char> buf(kCheapPrepend+readableBytes()+reserve);
-   std::copy(peek(), peek()+readableBytes(), buf.begin()+kCheapPrepend);
-   buf.swap(buffer_);
+    if (readableBytes() + reserve == 0)
+    {
+      release();
+    }
+    else
+    {
+      reallocate(reserve);
+    }
   }
 
   /// Read data directly into buffer.
@@ -147,28 +390,71 @@ class Buffer : public copyable
   /// @return result of read(2), @c errno is saved
   ssize_t readFd(int fd, int* savedErrno);
 
+  /// Same as above, but what does not fit goes to extrabuf[0, extrabufLen)
+  /// and is appended from there, NULL reads no more than writableBytes().
+  ssize_t readFd(int fd, char* extrabuf, size_t extrabufLen, int* savedErrno);
+
  private:
 
   char* begin()
-  { return &*buffer_.begin(); }
+  { return buffer_; }
 
   const char* begin() const
-  { return &*buffer_.begin(); }
+  { return buffer_; }
+
+  // an empty Buffer points here instead of owning a chunk
+  static char* emptyStorage()
+  { return emptyStorage_; }
+
+  bool hasStorage() const
+  { return buffer_ != emptyStorage_; }
+
+  void release()
+  {
+    if (hasStorage())
+    {
+      if (!borrowed_)
+      {
+        BufferPool::deallocate(buffer_, capacity_);
+      }
+      buffer_ = emptyStorage();
+      capacity_ = kCheapPrepend;
+      borrowed_ = false;
+    }
+  }
+
+  // moves the readable bytes into a chunk with room for len more
+  void reallocate(size_t len)
+  {
+    size_t readable = readableBytes();
+    size_t capacity = 0;
+    char* chunk = BufferPool::allocate(kCheapPrepend + readable + len, &capacity);
+    memcpy(chunk + kCheapPrepend, peek(), readable);
+    if (hasStorage() && !borrowed_)
+    {
+      BufferPool::deallocate(buffer_, capacity_);
+    }
+    borrowed_ = false;
+    buffer_ = chunk;
+    capacity_ = capacity;
+    readerIndex_ = kCheapPrepend;
+    writerIndex_ = readerIndex_ + readable;
+  }
 
   void makeSpace(size_t len)//进行内部腾挪
   {
-    if (writableBytes() + prependableBytes() < len + kCheapPrepend)
+    if (!hasStorage() || writableBytes() + prependableBytes() < len + kCheapPrepend)
     {
-      buffer_.resize(writerIndex_+len);//resize，这个时候内存不够了
+      reallocate(std::max(len, kInitialSize));//这个时候内存不够了，换一个更大的chunk，不需要清零
     }
     else
     {
       // move readable data to the front, make space inside buffer
       assert(kCheapPrepend < readerIndex_);
       size_t readable = readableBytes();
-      std::copy(begin()+readerIndex_,
-                begin()+writerIndex_,
-                begin()+kCheapPrepend);
+      memmove(begin()+kCheapPrepend,
+              begin()+readerIndex_,
+              readable);
       readerIndex_ = kCheapPrepend;
       writerIndex_ = readerIndex_ + readable;
       assert(readable == readableBytes());
@@ -176,9 +462,12 @@ class Buffer : public copyable
   }
 
  private:
-  std::vector<char> buffer_;//底层存储
+  char* buffer_;//底层存储，来自BufferPool的chunk
+  size_t capacity_;
   size_t readerIndex_;//读写索引
   size_t writerIndex_;
+  bool borrowed_;
   static const char kCRLF[];
+  static char emptyStorage_[kCheapPrepend];
 };
 
@@ -0,0 +1,124 @@
+#include "BufferPool.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+namespace
+{
+
+const int kNumClasses = 7;  // 1KB, 2KB, ... 64KB
+
+struct FreeChunk
+{
+  FreeChunk* next;
+};
+
+/*
+*每个线程(即每个EventLoop)各有一组空闲链表，分配和归还都不需要加锁。
+*__thread变量不能有析构函数，所以在线程第一次缓存chunk时注册pthread key，
+*线程退出时由freeCache()把缓存的chunk还给malloc。
+*/
+__thread FreeChunk* t_freeLists[kNumClasses];
+__thread int t_freeCounts[kNumClasses];
+__thread bool t_cacheRegistered = false;
+
+pthread_key_t g_cacheKey;
+pthread_once_t g_cacheKeyOnce = PTHREAD_ONCE_INIT;
+
+void freeCache(void*)
+{
+  for (int i = 0; i < kNumClasses; ++i)
+  {
+    while (t_freeLists[i])
+    {
+      FreeChunk* chunk = t_freeLists[i];
+      t_freeLists[i] = chunk->next;
+      ::free(chunk);
+    }
+    t_freeCounts[i] = 0;
+  }
+}
+
+void createCacheKey()
+{
+  pthread_key_create(&g_cacheKey, freeCache);
+}
+
+void registerCache()
+{
+  pthread_once(&g_cacheKeyOnce, createCacheKey);
+  // any non-NULL value, so that freeCache() runs at thread exit
+  pthread_setspecific(g_cacheKey, &t_cacheRegistered);
+  t_cacheRegistered = true;
+}
+
+size_t roundUp(size_t size)
+{
+  size_t capacity = BufferPool::kMinChunk;
+  while (capacity < size)
+  {
+    capacity *= 2;
+  }
+  return capacity;
+}
+
+// index of the size class, or -1 if chunks of capacity are not cached
+int sizeClass(size_t capacity)
+{
+  if (capacity > BufferPool::kMaxCachedChunk)
+  {
+    return -1;
+  }
+  int index = 0;
+  for (size_t c = BufferPool::kMinChunk; c < capacity; c *= 2)
+  {
+    ++index;
+  }
+  return index;
+}
+
+}  // namespace
+
+size_t BufferPool::chunkSize(size_t size)
+{
+  return roundUp(size);
+}
+
+char* BufferPool::allocate(size_t size, size_t* capacity)
+{
+  *capacity = roundUp(size);
+  int index = sizeClass(*capacity);
+  if (index >= 0 && t_freeLists[index])
+  {
+    FreeChunk* chunk = t_freeLists[index];
+    t_freeLists[index] = chunk->next;
+    --t_freeCounts[index];
+    return reinterpret_cast<char*>(chunk);
+  }
+  char* chunk = static_cast<char*>(::malloc(*capacity));
+  if (chunk == NULL)
+  {
+    abort();
+  }
+  return chunk;
+}
+
+void BufferPool::deallocate(char* chunk, size_t capacity)
+{
+  assert(chunk != NULL);
+  int index = sizeClass(capacity);
+  if (index >= 0 && static_cast<size_t>(t_freeCounts[index] + 1) * capacity <= kMaxCachedBytes)
+  {
+    if (!t_cacheRegistered)
+    {
+      registerCache();
+    }
+    FreeChunk* free = reinterpret_cast<FreeChunk*>(chunk);
+    free->next = t_freeLists[index];
+    t_freeLists[index] = free;
+    ++t_freeCounts[index];
+    return;
+  }
+  ::free(chunk);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "../base/noncopyable.h"
+
+#include <stddef.h>
+
+///
+/// Storage for Buffer in power-of-two chunks.
+///
+/// Released chunks of up to kMaxCachedChunk bytes are kept on free lists
+/// of the releasing thread, i.e. of its EventLoop, so acquiring one is a
+/// pointer pop without locking. Each size class caches at most
+/// kMaxCachedBytes, the rest goes back to malloc.
+class BufferPool : noncopyable
+{
+ public:
+  static const size_t kMinChunk = 1024;
+  static const size_t kMaxCachedChunk = 64 * 1024;
+  static const size_t kMaxCachedBytes = 256 * 1024;
+
+  /// Returns a chunk of at least size bytes, its real size in *capacity.
+  static char* allocate(size_t size, size_t* capacity);
+
+  /// The capacity allocate(size, &capacity) returns.
+  static size_t chunkSize(size_t size);
+
+  /// capacity must be the one allocate() returned, may be another thread.
+  static void deallocate(char* chunk, size_t capacity);
+};
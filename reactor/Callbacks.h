@@ -1,9 +1,9 @@
 #pragma once
 
-#include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
 
 #include "../base/Timestamp.h"
+#include "Function.h"
 
 // All client visible callbacks go here.
 
@@ -20,15 +20,18 @@ inline T* get_pointer(const std::unique_ptr<T>& ptr)
 }
 
 class Buffer;
+class ReadOnlyFile;
 class TcpConnection;
 typedef boost::shared_ptr<TcpConnection> TcpConnectionPtr;
-
-typedef boost::function<void()> TimerCallback;
-typedef boost::function<void (const TcpConnectionPtr&)> ConnectionCallback;
-typedef boost::function<void (const TcpConnectionPtr&,
-                              Buffer* buf,
-                              Timestamp)> MessageCallback;
-typedef boost::function<void (const TcpConnectionPtr&)> WriteCompleteCallback;
-typedef boost::function<void (const TcpConnectionPtr&)> CloseCallback;
+typedef boost::shared_ptr<ReadOnlyFile> FilePtr;
+
+// move-only, set them with a temporary such as boost::bind(...)
+typedef Function<void()> TimerCallback;
+typedef Function<void (const TcpConnectionPtr&)> ConnectionCallback;
+typedef Function<void (const TcpConnectionPtr&,
+                       Buffer* buf,
+                       Timestamp)> MessageCallback;
+typedef Function<void (const TcpConnectionPtr&)> WriteCompleteCallback;
+typedef Function<void (const TcpConnectionPtr&)> CloseCallback;
 
 
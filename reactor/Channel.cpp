@@ -2,6 +2,7 @@
 #include <sstream>
 #include <poll.h>
 #include "EventLoop.h"
+#include "Trace.h"
 
 using namespace std;
 
@@ -34,6 +35,7 @@ void Channel::update()
 //channel核心，它由EventLoop::loop()调用，它的功能是根据revents_的值分别调用不同的用户回调
 void Channel::handleEvent(Timestamp receiveTime)
 {
+  trace::record(trace::kEventBegin, fd_);
   eventHandling_ = true;
   if (revents_ & POLLNVAL) {
     LOG << "Warning: Channel::handle_event() POLLNVAL";
@@ -53,4 +55,5 @@ void Channel::handleEvent(Timestamp receiveTime)
     if (writeCallback_) writeCallback_();
   }
   eventHandling_ = false;
+  trace::record(trace::kEventEnd, fd_);
 }
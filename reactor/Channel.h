@@ -1,9 +1,9 @@
 #pragma once
 
-#include <boost/function.hpp>
 #include <boost/noncopyable.hpp>
 
 #include "../base/Timestamp.h"
+#include "Function.h"
 
 class EventLoop;
 
@@ -15,24 +15,25 @@ class EventLoop;
 class Channel : boost::noncopyable
 {
  public:
-  typedef boost::function<void()> EventCallback;//回调函数类型
-  typedef boost::function<void(Timestamp)> ReadEventCallback;
+  typedef Function<void()> EventCallback;//回调函数类型
+  typedef Function<void(Timestamp)> ReadEventCallback;
 
   Channel(EventLoop* loop, int fd);
   ~Channel();
 
   void handleEvent(Timestamp receiveTime);
-  void setReadCallback(const ReadEventCallback& cb)//设置读写错误回调函数
-  { readCallback_ = cb; }
-  void setWriteCallback(const EventCallback& cb)
-  { writeCallback_ = cb; }
-  void setErrorCallback(const EventCallback& cb)
-  { errorCallback_ = cb; }
-  void setCloseCallback(const EventCallback& cb)
-  { closeCallback_ = cb; }
+  void setReadCallback(ReadEventCallback cb)//设置读写错误回调函数
+  { readCallback_ = std::move(cb); }
+  void setWriteCallback(EventCallback cb)
+  { writeCallback_ = std::move(cb); }
+  void setErrorCallback(EventCallback cb)
+  { errorCallback_ = std::move(cb); }
+  void setCloseCallback(EventCallback cb)
+  { closeCallback_ = std::move(cb); }
 
   int fd() const { return fd_; }
   int events() const { return events_; }
+  int revents() const { return revents_; }
   void set_revents(int revt) { revents_ = revt; }
   bool isNoneEvent() const { return events_ == kNoneEvent; }
 
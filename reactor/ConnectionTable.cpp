@@ -0,0 +1,58 @@
+#include "ConnectionTable.h"
+#include "EventLoop.h"
+
+#include <algorithm>
+
+#include <assert.h>
+
+ConnectionTable::ConnectionTable(EventLoop* loop, int index)
+  : loop_(loop),
+    index_(index),
+    size_(0)
+{
+  assert(0 <= index && index < kMaxLoops);
+}
+
+ConnectionTable::~ConnectionTable()
+{
+}
+
+uint64_t ConnectionTable::add(int fd, const TcpConnectionPtr& conn)
+{
+  loop_->assertInLoopThread();
+  assert(0 <= fd && fd < kMaxFd);
+  if (static_cast<size_t>(fd) >= slots_.size())
+  {
+    slots_.resize(std::max(static_cast<size_t>(fd) + 1, slots_.size() * 2));
+  }
+  Slot& slot = slots_[fd];
+  assert(!slot.conn);
+  slot.conn = conn;
+  ++size_;
+  return (static_cast<uint64_t>(slot.generation) << 32)
+      | (static_cast<uint64_t>(index_) << 24)
+      | static_cast<uint64_t>(fd);
+}
+
+void ConnectionTable::remove(uint64_t id)
+{
+  loop_->assertInLoopThread();
+  assert(loopIndexOf(id) == index_);
+  Slot& slot = slots_[fdOf(id)];
+  assert(slot.conn && slot.generation == generationOf(id));
+  slot.conn.reset();
+  ++slot.generation;
+  --size_;
+}
+
+TcpConnectionPtr ConnectionTable::get(uint64_t id) const
+{
+  loop_->assertInLoopThread();
+  size_t fd = fdOf(id);
+  if (loopIndexOf(id) == index_ && fd < slots_.size()
+      && slots_[fd].generation == generationOf(id))
+  {
+    return slots_[fd].conn;
+  }
+  return TcpConnectionPtr();
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "../base/noncopyable.h"
+#include "Callbacks.h"
+
+#include <vector>
+
+#include <stdint.h>
+
+class EventLoop;
+
+///
+/// The connections a TcpServer runs in one EventLoop, indexed by fd.
+///
+/// Only touched in that loop's thread, so adding and removing is O(1)
+/// without locking. Each slot counts its generation, bumped on remove:
+/// an id is (generation, loop index, fd), and an id kept after the
+/// connection closed never finds the one that reuses the fd.
+class ConnectionTable : noncopyable
+{
+ public:
+  static const int kMaxLoops = 256;
+  static const int kMaxFd = 1 << 24;
+
+  ConnectionTable(EventLoop* loop, int index);
+  ~ConnectionTable();
+
+  EventLoop* getLoop() const { return loop_; }
+  int index() const { return index_; }
+  size_t size() const { return size_; }
+
+  /// @return the id of conn, whose socket is fd
+  uint64_t add(int fd, const TcpConnectionPtr& conn);
+  void remove(uint64_t id);
+  /// @return the connection, or an empty pointer if id is stale
+  TcpConnectionPtr get(uint64_t id) const;
+
+  static int loopIndexOf(uint64_t id)
+  { return static_cast<int>((id >> 24) & 0xff); }
+
+  static int fdOf(uint64_t id)
+  { return static_cast<int>(id & 0xffffff); }
+
+  static uint32_t generationOf(uint64_t id)
+  { return static_cast<uint32_t>(id >> 32); }
+
+ private:
+  struct Slot
+  {
+    Slot() : generation(0) {}
+
+    TcpConnectionPtr conn;
+    uint32_t generation;
+  };
+
+  EventLoop* loop_;
+  const int index_;
+  size_t size_;
+  std::vector<Slot> slots_;
+};
@@ -1,10 +1,10 @@
 #pragma once
 
+#include "Function.h"
 #include "InetAddress.h"
 #include "TimerId.h"
 
 #include <boost/enable_shared_from_this.hpp>
-#include <boost/function.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/scoped_ptr.hpp>
 
@@ -14,13 +14,13 @@ class EventLoop;
 class Connector : boost::noncopyable
 {
  public:
-  typedef boost::function<void (int sockfd)> NewConnectionCallback;
+  typedef Function<void (int sockfd)> NewConnectionCallback;
 
   Connector(EventLoop* loop, const InetAddress& serverAddr);
   ~Connector();
 
-  void setNewConnectionCallback(const NewConnectionCallback& cb)
-  { newConnectionCallback_ = cb; }
+  void setNewConnectionCallback(NewConnectionCallback cb)
+  { newConnectionCallback_ = std::move(cb); }
 
   void start();  // can be called in any thread
   void restart();  // must be called in loop thread
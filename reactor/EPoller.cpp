@@ -2,6 +2,8 @@
 #include "../base/Logging.h"
 #include <boost/static_assert.hpp>
 
+#include <algorithm>
+
 #include <assert.h>
 #include <errno.h>
 #include <poll.h>
@@ -25,6 +27,9 @@ const int kAdded = 1;
 const int kDeleted = 2;
 }
 
+const int EPoller::kInitEventListSize;
+const int EPoller::kMaxEventListSize;
+
 EPoller::EPoller(EventLoop* loop)
   : ownerLoop_(loop),
     epollfd_(::epoll_create1(EPOLL_CLOEXEC)),
@@ -52,21 +57,23 @@ Timestamp EPoller::poll(int timeoutMs, ChannelList* activeChannels)
                                &*events_.begin(),
                                static_cast<int>(events_.size()),
                                timeoutMs);
+  int savedErrno = errno;
   Timestamp now(Timestamp::now());
   if (numEvents > 0)
   {
     LOG << numEvents << "trace: events happended";
     fillActiveChannels(numEvents, activeChannels);
-    if (static_cast<size_t>(numEvents) == events_.size())
+    if (static_cast<size_t>(numEvents) == events_.size()
+        && events_.size() < static_cast<size_t>(kMaxEventListSize))
     {
-      events_.resize(events_.size()*2);
+      events_.resize(std::min(events_.size()*2, static_cast<size_t>(kMaxEventListSize)));
     }
   }
   else if (numEvents == 0)
   {
     LOG << "trace: nothing happended";
   }
-  else
+  else if (savedErrno != EINTR)  // e.g. LoopWatchdog's signal
   {
     LOG << "syserror: EPoller::poll()";
   }
@@ -80,12 +87,11 @@ void EPoller::fillActiveChannels(int numEvents,
   for (int i = 0; i < numEvents; ++i)
   {
     Channel* channel = static_cast<Channel*>(events_[i].data.ptr);
-
+#ifndef NDEBUG
     int fd = channel->fd();
-    ChannelMap::const_iterator it = channels_.find(fd);
-    assert(it != channels_.end());
-    assert(it->second == channel);
-
+    assert(static_cast<size_t>(fd) < channels_.size());
+    assert(channels_[fd] == channel);
+#endif
     channel->set_revents(events_[i].events);
     activeChannels->push_back(channel);
   }
@@ -102,12 +108,16 @@ void EPoller::updateChannel(Channel* channel)
     int fd = channel->fd();
     if (index == kNew)
     {
-      assert(channels_.find(fd) == channels_.end());
+      if (static_cast<size_t>(fd) >= channels_.size())
+      {
+        channels_.resize(std::max(static_cast<size_t>(fd) + 1, channels_.size() * 2));
+      }
+      assert(channels_[fd] == NULL);
       channels_[fd] = channel;
     }
     else // index == kDeleted
     {
-      assert(channels_.find(fd) != channels_.end());
+      assert(static_cast<size_t>(fd) < channels_.size());
       assert(channels_[fd] == channel);
     }
     channel->set_index(kAdded);
@@ -116,10 +126,8 @@ void EPoller::updateChannel(Channel* channel)
   else
   {
     // update existing one with EPOLL_CTL_MOD/DEL
-    int fd = channel->fd();
-    (void)fd;
-    assert(channels_.find(fd) != channels_.end());
-    assert(channels_[fd] == channel);
+    assert(static_cast<size_t>(channel->fd()) < channels_.size());
+    assert(channels_[channel->fd()] == channel);
     assert(index == kAdded);
     if (channel->isNoneEvent())
     {
@@ -138,14 +146,12 @@ void EPoller::removeChannel(Channel* channel)
   assertInLoopThread();
   int fd = channel->fd();
   LOG << "trace: fd = " << fd;
-  assert(channels_.find(fd) != channels_.end());
+  assert(static_cast<size_t>(fd) < channels_.size());
   assert(channels_[fd] == channel);
   assert(channel->isNoneEvent());
   int index = channel->index();
   assert(index == kAdded || index == kDeleted);
-  size_t n = channels_.erase(fd);
-  (void)n;
-  assert(n == 1);
+  channels_[fd] = NULL;
 
   if (index == kAdded)
   {
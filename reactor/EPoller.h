@@ -1,6 +1,5 @@
 #pragma once
 
-#include <map>
 #include <vector>
 
 #include "../base/Timestamp.h"
@@ -37,13 +36,17 @@ class EPoller : boost::noncopyable
 
  private:
   static const int kInitEventListSize = 16;
+  // epoll_wait() hands back at most this many events per call, the rest
+  // stay ready for the next one
+  static const int kMaxEventListSize = 4096;
 
   void fillActiveChannels(int numEvents,
                           ChannelList* activeChannels) const;
   void update(int operation, Channel* channel);
 
   typedef std::vector<struct epoll_event> EventList;
-  typedef std::map<int, Channel*> ChannelMap;
+  // indexed by fd, only checked by assertions
+  typedef std::vector<Channel*> ChannelMap;
 
   EventLoop* ownerLoop_;
   int epollfd_;
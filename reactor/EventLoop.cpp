@@ -1,10 +1,14 @@
+#include <algorithm>
 #include <assert.h>
 
 #include "../base/Logging.h"
 #include "EventLoop.h"
+#include "Trace.h"
 #include <sys/eventfd.h>
 #include <boost/bind.hpp>
+#include <cxxabi.h>
 #include <signal.h>
+#include <stdlib.h>
 
 using namespace std;
 
@@ -12,6 +16,8 @@ __thread EventLoop* t_loopInThisThread = 0;
 //one loop per thread, 每个线程只能有一个EventLoop对象，t_loopInThisThread值是唯一的
 const int kPollTimeMs = 10000;
 
+int64_t g_slowCallbackMicros = 0;  // atomic
+
 /*
 *由于IO线程平时阻塞在事件循环loop()的poll调用中，为了让IO线程能够立刻执行用户回调，
 *我们需要设法唤醒它。传统方法是用pipe，IO线程始终监视此管道的readable事件，
@@ -45,10 +51,12 @@ EventLoop::EventLoop()
     quit_(false),
     callingPendingFunctors_(false),
     threadId_(CurrentThread::tid()),
+    busyPollMicros_(0),
     poller_(new EPoller(this)),
     timerQueue_(new TimerQueue(this)),
     wakeupFd_(createEventfd()),
-    wakeupChannel_(new Channel(this, wakeupFd_))
+    wakeupChannel_(new Channel(this, wakeupFd_)),
+    mutex_("EventLoop")
 {
   LOG << "trace: EventLoop created in thread" << threadId_;
   if (t_loopInThisThread)
@@ -73,21 +81,21 @@ EventLoop::~EventLoop()
   t_loopInThisThread = NULL;
 }
 
-TimerId EventLoop::runAt(const Timestamp& time, const TimerCallback& cb)
+TimerId EventLoop::runAt(const Timestamp& time, TimerCallback cb)
 {
-  return timerQueue_->addTimer(cb, time, 0.0);
+  return timerQueue_->addTimer(std::move(cb), time, 0.0);
 }
 
-TimerId EventLoop::runAfter(double delay, const TimerCallback& cb)
+TimerId EventLoop::runAfter(double delay, TimerCallback cb)
 {
   Timestamp time(addTime(Timestamp::now(), delay));
-  return runAt(time, cb);
+  return runAt(time, std::move(cb));
 }
 
-TimerId EventLoop::runEvery(double interval, const TimerCallback& cb)
+TimerId EventLoop::runEvery(double interval, TimerCallback cb)
 {
   Timestamp time(addTime(Timestamp::now(), interval));
-  return timerQueue_->addTimer(cb, time, interval);
+  return timerQueue_->addTimer(std::move(cb), time, interval);
 }
 
 void EventLoop::cancel(TimerId timerId)
@@ -95,6 +103,33 @@ void EventLoop::cancel(TimerId timerId)
   return timerQueue_->cancel(timerId);
 }
 
+void EventLoop::setBusyPoll(double spinSeconds)
+{
+  assertInLoopThread();
+  busyPollMicros_ = static_cast<int64_t>(spinSeconds * Timestamp::kMicroSecondsPerSecond);
+}
+
+void EventLoop::setSlowCallbackThreshold(double seconds)
+{
+  __atomic_store_n(&g_slowCallbackMicros,
+                   static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond),
+                   __ATOMIC_RELAXED);
+}
+
+int64_t EventLoop::slowCallbackMicros()
+{
+  return __atomic_load_n(&g_slowCallbackMicros, __ATOMIC_RELAXED);
+}
+
+string EventLoop::callbackName(const std::type_info& type)
+{
+  int status = 0;
+  char* demangled = abi::__cxa_demangle(type.name(), NULL, NULL, &status);
+  string name(status == 0 ? demangled : type.name());
+  free(demangled);
+  return name;
+}
+
 //调用IO复用poll()获取当前活动事件的channel列表，然后依次调用每个channel的handleEvent()函数
 void EventLoop::loop()
 {
@@ -103,22 +138,87 @@ void EventLoop::loop()
   looping_ = true;
   quit_ = false;
 
+  Timestamp busySince;
+  Timestamp lastReady;  // for busy polling
+  bool spun = false;    // the last poll spun and found nothing
   while (!quit_)
   {
     activeChannels_.clear();
-    pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
-    for (ChannelList::iterator it = activeChannels_.begin();
-        it != activeChannels_.end(); ++it)
+    // one more clock read per iteration, the poller reads the other
+    Timestamp pollStart(Timestamp::now());
+    if (busySince.valid())
+    {
+      metrics_.add(spun ? LoopMetrics::kSpinMicros : LoopMetrics::kBusyMicros, std::max<int64_t>(0,
+          pollStart.microSecondsSinceEpoch() - busySince.microSecondsSinceEpoch()));
+    }
+    const bool spin = busyPollMicros_ > 0 && lastReady.valid()
+        && pollStart.microSecondsSinceEpoch() - lastReady.microSecondsSinceEpoch() < busyPollMicros_;
+    const int timeoutMs = spin ? 0 : kPollTimeMs;
+    metrics_.setBusySince(0);
+    trace::record(trace::kPollBegin, timeoutMs);
+    pollReturnTime_ = poller_->poll(timeoutMs, &activeChannels_);
+    trace::record(trace::kPollEnd, static_cast<uint32_t>(activeChannels_.size()));
+    busySince = pollReturnTime_;
+    metrics_.setBusySince(busySince.microSecondsSinceEpoch());
+    metrics_.add(spin ? LoopMetrics::kSpinMicros : LoopMetrics::kPollWaitMicros, std::max<int64_t>(0,
+        pollReturnTime_.microSecondsSinceEpoch() - pollStart.microSecondsSinceEpoch()));
+    metrics_.add(LoopMetrics::kPolls, 1);
+    metrics_.add(LoopMetrics::kEvents, static_cast<int64_t>(activeChannels_.size()));
+    spun = spin && activeChannels_.empty();
+    if (spun)
     {
-      (*it)->handleEvent(pollReturnTime_);
+      metrics_.add(LoopMetrics::kEmptySpins, 1);
+    }
+    else if (!activeChannels_.empty())
+    {
+      lastReady = pollReturnTime_;
+    }
+    const int64_t slowMicros = slowCallbackMicros();
+    if (slowMicros > 0)
+    {
+      handleEventsTimed(slowMicros);
+    }
+    else
+    {
+      for (ChannelList::iterator it = activeChannels_.begin();
+          it != activeChannels_.end(); ++it)
+      {
+        (*it)->handleEvent(pollReturnTime_);
+      }
     }
     doPendingFunctors();
   }
+  metrics_.setBusySince(0);
 
   LOG << "trace: EventLoop stop looping";
   looping_ = false;
 }
 
+/*
+*每个回调结束时读一次时钟，前一个回调的结束时刻就是下一个的开始时刻，
+*超过阈值的回调连同它的fd和就绪事件一起记入日志。
+*/
+void EventLoop::handleEventsTimed(int64_t slowMicros)
+{
+  Timestamp last(pollReturnTime_);
+  for (ChannelList::iterator it = activeChannels_.begin();
+      it != activeChannels_.end(); ++it)
+  {
+    // read before the handler, which may close the connection
+    int fd = (*it)->fd();
+    int revents = (*it)->revents();
+    (*it)->handleEvent(pollReturnTime_);
+    Timestamp now(Timestamp::now());
+    int64_t elapsed = now.microSecondsSinceEpoch() - last.microSecondsSinceEpoch();
+    if (elapsed > slowMicros)
+    {
+      LOG << "warn: EventLoop::loop() slow event on fd " << fd
+          << " revents " << revents << " took " << elapsed << " us";
+    }
+    last = now;
+  }
+}
+
 //quit必要时唤醒IO线程，让它终止循环
 void EventLoop::quit()
 {
@@ -134,7 +234,7 @@ void EventLoop::quit()
 *如果用户在其他吸纳从调用runInLoop(), cb会被加入队列，
 *IO线程会被唤醒来调用这个Functor
 */
-void EventLoop::runInLoop(const Functor& cb)
+void EventLoop::runInLoop(Functor cb)
 {
   if (isInLoopThread())
   {
@@ -142,7 +242,7 @@ void EventLoop::runInLoop(const Functor& cb)
   }
   else
   {
-    queueInLoop(cb);
+    queueInLoop(std::move(cb));
   }
 }
 
@@ -153,11 +253,11 @@ void EventLoop::runInLoop(const Functor& cb)
 *如果在IO线程调用queueInLoop(),而此时正在调用pending functor, 也必须唤醒。
 *只有在IO线程的回调事件回调中调用queueInLoop()才无需wakeup().
 */
-void EventLoop::queueInLoop(const Functor& cb)
+void EventLoop::queueInLoop(Functor cb)
 {
   {
     MutexLockGuard lock(mutex_);
-    pendingFunctors_.push_back(cb);
+    pendingFunctors_.push_back(std::move(cb));
   }
 
   if (!isInLoopThread() || callingPendingFunctors_)
@@ -211,20 +311,40 @@ void EventLoop::handleRead()
 /*
 *doPendingFunctors()把回调列表swap()到局部变量functors中，这样一方面减小了临界区长度
 *(不会阻塞其他线程调用queueInLoop()),另一方面也避免了死锁(因为Functor可能会再调用queueInLoop())
+*functors是成员callingFunctors_，执行完只clear()不释放，两个vector轮流交换，容量得以保留，
+*稳定运行后queueInLoop()的push_back()不再分配内存。
 */
 void EventLoop::doPendingFunctors()
 {
-  std::vector<Functor> functors;
+  std::vector<Functor>& functors = callingFunctors_;
   callingPendingFunctors_ = true;
 
   {
     MutexLockGuard lock(mutex_);
     functors.swap(pendingFunctors_);
   }
+  metrics_.set(LoopMetrics::kPendingFunctors, static_cast<int64_t>(functors.size()));
+  metrics_.add(LoopMetrics::kFunctors, static_cast<int64_t>(functors.size()));
 
+  const int64_t slowMicros = slowCallbackMicros();
+  Timestamp last(slowMicros > 0 ? Timestamp::now() : Timestamp());
   for (size_t i = 0; i < functors.size(); ++i)
   {
+    trace::record(trace::kFunctorBegin, static_cast<uint32_t>(i));
     functors[i]();
+    trace::record(trace::kFunctorEnd, static_cast<uint32_t>(i));
+    if (slowMicros > 0)
+    {
+      Timestamp now(Timestamp::now());
+      int64_t elapsed = now.microSecondsSinceEpoch() - last.microSecondsSinceEpoch();
+      if (elapsed > slowMicros)
+      {
+        LOG << "warn: EventLoop::doPendingFunctors() slow functor "
+            << callbackName(functors[i].target_type()) << " took " << elapsed << " us";
+      }
+      last = now;
+    }
   }
+  functors.clear();
   callingPendingFunctors_ = false;
 }
@@ -1,10 +1,14 @@
 #pragma once
 
 #include "../base/Thread.h"
+#include <boost/scoped_array.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <string>
+#include <typeinfo>
 #include <vector>
 #include "Channel.h"
 #include "EPoller.h"
+#include "LoopMetrics.h"
 #include "Poller.h"
 #include "Callbacks.h"
 #include "TimerId.h"
@@ -14,7 +18,7 @@
 class EventLoop : boost::noncopyable
 {
  public:
-  typedef boost::function<void()> Functor;
+  typedef Function<void()> Functor;
   EventLoop();
 
   ~EventLoop();
@@ -32,23 +36,34 @@ class EventLoop : boost::noncopyable
    * Runs callback immediately in the loop thread.It wakes up the loop, and run the cb.
    * If in the same loop thread, cb is run within the function. Safe to call from other threads.
    */
-  void runInLoop(const Functor& cb);
+  void runInLoop(Functor cb);
   /*
   * Queues callback in the loop thread. Runs after finish pooling.
   * Safe to call from other threads.
   */
-  void queueInLoop(const Functor& cb);
+  void queueInLoop(Functor cb);
 
   /// Runs callback at 'time'.
-  TimerId runAt(const Timestamp& time, const TimerCallback& cb);
+  TimerId runAt(const Timestamp& time, TimerCallback cb);
   /// Runs callback after delay seconds.
-  TimerId runAfter(double delay, const TimerCallback& cb);
+  TimerId runAfter(double delay, TimerCallback cb);
   /// Runs callback every interval seconds.
-  TimerId runEvery(double interval, const TimerCallback& cb);
+  TimerId runEvery(double interval, TimerCallback cb);
 
   void cancel(TimerId timerId);
 
+  /// Polls without blocking for spinSeconds after the last ready event
+  /// before blocking in epoll_wait() again, trading a busy core for the
+  /// wakeup latency, 0 disables, the default. Call in the loop thread.
+  void setBusyPoll(double spinSeconds);
+
+  /// Logs every channel event, functor and timer callback of any EventLoop
+  /// that runs longer than seconds, 0 disables, the default. Thread safe.
+  static void setSlowCallbackThreshold(double seconds);
+
   // internal use only
+  static int64_t slowCallbackMicros();
+  static std::string callbackName(const std::type_info& type);
   void wakeup();
   void updateChannel(Channel* channel);
   void removeChannel(Channel* channel);
@@ -63,10 +78,27 @@ class EventLoop : boost::noncopyable
 
   bool isInLoopThread() const { return threadId_ == CurrentThread::tid(); }
 
+  static const size_t kReadScratchSize = 64 * 1024;
+
+  /// kReadScratchSize bytes shared by all connections of this loop for
+  /// reading sockets, only valid in the loop thread until the next read.
+  char* readScratch()
+  {
+    if (!readScratch_)
+    {
+      readScratch_.reset(new char[kReadScratchSize]);
+    }
+    return readScratch_.get();
+  }
+
+  /// Written only in the loop thread, see LoopMetrics.
+  LoopMetrics* metrics() { return &metrics_; }
+
  private:
 
   void abortNotInLoopThread();
   void handleRead();  // waked up
+  void handleEventsTimed(int64_t slowMicros);
   void doPendingFunctors();
 
   typedef std::vector<Channel*> ChannelList;
@@ -75,7 +107,9 @@ class EventLoop : boost::noncopyable
   bool quit_; /* atomic */
   bool callingPendingFunctors_; /* atomic */
   const pid_t threadId_;
+  int64_t busyPollMicros_;
   Timestamp pollReturnTime_;
+  LoopMetrics metrics_;  // before timerQueue_, which updates it
   boost::scoped_ptr<EPoller> poller_;//通过scoped_ptr来间接持有poller
   boost::scoped_ptr<TimerQueue> timerQueue_;
   int wakeupFd_;
@@ -85,4 +119,6 @@ class EventLoop : boost::noncopyable
   ChannelList activeChannels_;
   MutexLock mutex_;
   std::vector<Functor> pendingFunctors_; //pendingFunctors_保存回调函数，暴露给了其他线程，因此用mutex保护
+  std::vector<Functor> callingFunctors_;  // only in loop thread, swapped with pendingFunctors_
+  boost::scoped_array<char> readScratch_;
 };
@@ -6,12 +6,13 @@
 
 using namespace std;
 
-EventLoopThread::EventLoopThread()
+EventLoopThread::EventLoopThread(const ThreadInitCallback& cb)
   : loop_(NULL),
     exiting_(false),
     thread_(boost::bind(&EventLoopThread::threadFunc, this)),
     mutex_(),
-    cond_(mutex_)
+    cond_(mutex_),
+    callback_(cb)
 {
 }
 
@@ -42,13 +43,18 @@ EventLoop* EventLoopThread::startLoop()
 }
 
 /*
-*线程主函数在stack上定义EventLoop对象，然后将其地址赋给loop_成员变量，
+*线程主函数在stack上定义EventLoop对象，先调用ThreadInitCallback做per-loop的初始化，然后将其地址赋给loop_成员变量，
 *最后调用条件变量的notify，唤醒startLoop()，成功创建EventLoop对象，并调用loop()
 */
 void EventLoopThread::threadFunc()
 {
   EventLoop loop;
 
+  if (callback_)
+  {
+    callback_(&loop);
+  }
+
   {
     MutexLockGuard lock(mutex_);
     loop_ = &loop;
@@ -4,6 +4,7 @@
 #include "../base/MutexLock.h"
 #include "../base/Thread.h"
 
+#include <boost/function.hpp>
 #include <boost/noncopyable.hpp>
 
 class EventLoop;
@@ -16,7 +17,9 @@ class EventLoop;
 class EventLoopThread : boost::noncopyable
 {
  public:
-  EventLoopThread();
+  typedef boost::function<void(EventLoop*)> ThreadInitCallback;
+
+  explicit EventLoopThread(const ThreadInitCallback& cb = ThreadInitCallback());
   ~EventLoopThread();
   EventLoop* startLoop();
 
@@ -28,5 +31,6 @@ class EventLoopThread : boost::noncopyable
   Thread thread_;
   MutexLock mutex_;
   Condition cond_;
+  ThreadInitCallback callback_;
 };
 
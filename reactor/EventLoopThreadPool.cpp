@@ -20,7 +20,7 @@ EventLoopThreadPool::~EventLoopThreadPool()
   // Don't delete loop, it's stack variable
 }
 
-void EventLoopThreadPool::start()
+void EventLoopThreadPool::start(const EventLoopThread::ThreadInitCallback& cb)
 {
   assert(!started_);
   baseLoop_->assertInLoopThread();
@@ -29,10 +29,14 @@ void EventLoopThreadPool::start()
 
   for (int i = 0; i < numThreads_; ++i)
   {
-    EventLoopThread* t = new EventLoopThread;
+    EventLoopThread* t = new EventLoopThread(cb);
     threads_.push_back(t);
     loops_.push_back(t->startLoop());
   }
+  if (numThreads_ == 0 && cb)
+  {
+    cb(baseLoop_);
+  }
 }
 
 EventLoop* EventLoopThreadPool::getNextLoop()
@@ -53,3 +57,14 @@ EventLoop* EventLoopThreadPool::getNextLoop()
   return loop;
 }
 
+
+std::vector<EventLoop*> EventLoopThreadPool::getAllLoops()
+{
+  baseLoop_->assertInLoopThread();
+  assert(started_);
+  if (loops_.empty())
+  {
+    return std::vector<EventLoop*>(1, baseLoop_);
+  }
+  return loops_;
+}
@@ -9,8 +9,9 @@
 #include <boost/noncopyable.hpp>
 #include <boost/ptr_container/ptr_vector.hpp>
 
+#include "EventLoopThread.h"
+
 class EventLoop;
-class EventLoopThread;
 
 class EventLoopThreadPool : boost::noncopyable
 {
@@ -18,8 +19,13 @@ class EventLoopThreadPool : boost::noncopyable
   EventLoopThreadPool(EventLoop* baseLoop);
   ~EventLoopThreadPool();
   void setThreadNum(int numThreads) { numThreads_ = numThreads; }
-  void start();
+  /// Runs cb in every IO thread before its loop starts,
+  /// or in the base loop if there is no IO thread.
+  void start(const EventLoopThread::ThreadInitCallback& cb
+                 = EventLoopThread::ThreadInitCallback());
   EventLoop* getNextLoop();
+  /// The IO loops, or the base loop if there is no IO thread.
+  std::vector<EventLoop*> getAllLoops();
 
  private:
   EventLoop* baseLoop_;
@@ -0,0 +1,289 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+
+///
+/// Move-only callable wrapper, like boost::function without copying.
+///
+/// Targets up to kInlineSize bytes, e.g. boost::bind of a member function
+/// with a shared_ptr and two more arguments, are stored inside the object,
+/// so constructing, moving and calling one never allocates.
+/// Larger targets, or ones whose move may throw, are stored on the heap.
+/// sizeof(Function) is one cache line.
+///
+template<typename Signature>
+class Function;
+
+template<typename R, typename... Args>
+class Function<R(Args...)>
+{
+ public:
+  static const size_t kInlineSize = 6 * sizeof(void*);
+
+  Function() noexcept
+    : invoke_(NULL),
+      ops_(NULL)
+  { }
+
+  Function(std::nullptr_t) noexcept
+    : invoke_(NULL),
+      ops_(NULL)
+  { }
+
+  /// An empty boost::function, std::function or Function, or a NULL
+  /// pointer to function or member function, makes an empty Function.
+  template<typename F,
+           typename = typename std::enable_if<
+               !std::is_same<typename std::decay<F>::type, Function>::value
+               && !std::is_member_pointer<typename std::decay<F>::type>::value>::type>
+  Function(F&& f)
+    : invoke_(NULL),
+      ops_(NULL)
+  {
+    if (!isNull(f, Rank3()))
+    {
+      init(std::forward<F>(f));
+    }
+  }
+
+  /// Calls (obj.*pm)(args...) or ((*obj).*pm)(args...) for the first
+  /// argument obj, like boost::function.
+  template<typename M, typename C>
+  Function(M C::* pm)
+    : invoke_(NULL),
+      ops_(NULL)
+  {
+    if (pm != NULL)
+    {
+      init(std::mem_fn(pm));
+    }
+  }
+
+  Function(Function&& rhs) noexcept
+    : invoke_(rhs.invoke_),
+      ops_(rhs.ops_)
+  {
+    if (ops_)
+    {
+      ops_->relocate(storage_, rhs.storage_);
+      rhs.invoke_ = NULL;
+      rhs.ops_ = NULL;
+    }
+  }
+
+  Function& operator=(Function&& rhs) noexcept
+  {
+    if (this != &rhs)
+    {
+      clear();
+      if (rhs.ops_)
+      {
+        rhs.ops_->relocate(storage_, rhs.storage_);
+        invoke_ = rhs.invoke_;
+        ops_ = rhs.ops_;
+        rhs.invoke_ = NULL;
+        rhs.ops_ = NULL;
+      }
+    }
+    return *this;
+  }
+
+  Function& operator=(std::nullptr_t) noexcept
+  {
+    clear();
+    return *this;
+  }
+
+  template<typename F,
+           typename = typename std::enable_if<
+               !std::is_same<typename std::decay<F>::type, Function>::value>::type>
+  Function& operator=(F&& f)
+  {
+    return *this = Function(std::forward<F>(f));
+  }
+
+  Function(const Function&) = delete;
+  Function& operator=(const Function&) = delete;
+
+  ~Function()
+  {
+    clear();
+  }
+
+  /// Throws std::bad_function_call if empty, as boost::function did.
+  R operator()(Args... args) const
+  {
+    if (__builtin_expect(invoke_ == NULL, 0))
+    {
+      throw std::bad_function_call();
+    }
+    return invoke_(storage_, std::forward<Args>(args)...);
+  }
+
+  explicit operator bool() const noexcept { return invoke_ != NULL; }
+
+  /// typeid of the target, or of void if empty, as std::function's.
+  const std::type_info& target_type() const noexcept
+  {
+    return ops_ ? *ops_->type : typeid(void);
+  }
+
+  void swap(Function& rhs) noexcept
+  {
+    Function tmp(std::move(rhs));
+    rhs = std::move(*this);
+    *this = std::move(tmp);
+  }
+
+ private:
+  union Storage
+  {
+    void* heap;
+    typename std::aligned_storage<kInlineSize, alignof(std::max_align_t)>::type buf;
+  };
+
+  // arguments are passed on as declared, so a Timestamp stays in a register
+  typedef R (*Invoker)(Storage& storage, Args... args);
+
+  // one static table per target type, instead of a virtual base class,
+  // the invoker is kept in the object itself to save a load on every call
+  struct Ops
+  {
+    void (*relocate)(Storage& to, Storage& from);  // moves, then destroys from
+    void (*destroy)(Storage& storage);
+    const std::type_info* type;  // for diagnostics
+  };
+
+  template<typename T>
+  struct fitsInline
+    : std::integral_constant<bool,
+          sizeof(T) <= sizeof(Storage)
+          && alignof(Storage) % alignof(T) == 0
+          && std::is_nothrow_move_constructible<T>::value>
+  { };
+
+  template<typename T, bool Inline>
+  struct Manager;
+
+  template<typename T>
+  struct Manager<T, true>
+  {
+    template<typename F>
+    static void create(Storage& storage, F&& f)
+    {
+      ::new (static_cast<void*>(&storage.buf)) T(std::forward<F>(f));
+    }
+    static T* get(Storage& storage)
+    {
+      return static_cast<T*>(static_cast<void*>(&storage.buf));
+    }
+    static R invoke(Storage& storage, Args... args)
+    {
+      return (*get(storage))(std::forward<Args>(args)...);
+    }
+    static void relocate(Storage& to, Storage& from)
+    {
+      ::new (static_cast<void*>(&to.buf)) T(std::move(*get(from)));
+      get(from)->~T();
+    }
+    static void destroy(Storage& storage)
+    {
+      get(storage)->~T();
+    }
+    static const Ops kOps;
+  };
+
+  template<typename T>
+  struct Manager<T, false>
+  {
+    template<typename F>
+    static void create(Storage& storage, F&& f)
+    {
+      storage.heap = new T(std::forward<F>(f));
+    }
+    static R invoke(Storage& storage, Args... args)
+    {
+      return (*static_cast<T*>(storage.heap))(std::forward<Args>(args)...);
+    }
+    static void relocate(Storage& to, Storage& from)
+    {
+      to.heap = from.heap;
+    }
+    static void destroy(Storage& storage)
+    {
+      delete static_cast<T*>(storage.heap);
+    }
+    static const Ops kOps;
+  };
+
+  template<typename F>
+  void init(F&& f)
+  {
+    typedef Manager<typename std::decay<F>::type,
+                    fitsInline<typename std::decay<F>::type>::value> TargetManager;
+    TargetManager::create(storage_, std::forward<F>(f));
+    invoke_ = &TargetManager::invoke;
+    ops_ = &TargetManager::kOps;
+  }
+
+  // overloads ranked by the tag, the highest one that compiles is taken:
+  // pointers, then empty() as boost::function's, then a conversion to
+  // bool as std::function's, otherwise never empty
+  struct Rank0 { };
+  struct Rank1 : Rank0 { };
+  struct Rank2 : Rank1 { };
+  struct Rank3 : Rank2 { };
+
+  template<typename T>
+  static bool isNull(T* const& p, Rank3) { return p == NULL; }
+
+  template<typename T>
+  static auto isNull(const T& f, Rank2) -> decltype(static_cast<bool>(f.empty()))
+  { return f.empty(); }
+
+  template<typename T>
+  static auto isNull(const T& f, Rank1)
+    -> typename std::enable_if<!std::is_function<T>::value
+                               && std::is_constructible<bool, const T&>::value, bool>::type
+  { return !static_cast<bool>(f); }
+
+  template<typename T>
+  static bool isNull(const T&, Rank0) { return false; }
+
+  void clear() noexcept
+  {
+    if (ops_)
+    {
+      ops_->destroy(storage_);
+      invoke_ = NULL;
+      ops_ = NULL;
+    }
+  }
+
+  Invoker invoke_;
+  const Ops* ops_;
+  mutable Storage storage_;
+};
+
+template<typename R, typename... Args>
+template<typename T>
+const typename Function<R(Args...)>::Ops
+Function<R(Args...)>::Manager<T, true>::kOps = {
+  &Manager<T, true>::relocate,
+  &Manager<T, true>::destroy,
+  &typeid(T),
+};
+
+template<typename R, typename... Args>
+template<typename T>
+const typename Function<R(Args...)>::Ops
+Function<R(Args...)>::Manager<T, false>::kOps = {
+  &Manager<T, false>::relocate,
+  &Manager<T, false>::destroy,
+  &typeid(T),
+};
@@ -0,0 +1,126 @@
+#include "LengthFieldCodec.h"
+#include "TcpConnection.h"
+#include "../base/Logging.h"
+
+#include <algorithm>
+#include <limits.h>
+#include <stdlib.h>
+
+namespace
+{
+  const size_t kDefaultMaxFrameLength = 64 * 1024 * 1024;
+
+  // the longest frame a field of that many bytes can describe,
+  // and a StringPiece can hold
+  size_t fieldLimit(int lengthFieldBytes)
+  {
+    if (lengthFieldBytes >= 4)
+    {
+      return INT_MAX;
+    }
+    return (static_cast<size_t>(1) << (8 * lengthFieldBytes)) - 1;
+  }
+}
+
+LengthFieldCodec::LengthFieldCodec(FrameCallback cb,
+                                   int lengthFieldBytes,
+                                   size_t maxFrameLength)
+  : frameCallback_(std::move(cb)),
+    lengthFieldBytes_(lengthFieldBytes),
+    maxFrameLength_(maxFrameLength > 0
+                    ? maxFrameLength
+                    : std::min(kDefaultMaxFrameLength, fieldLimit(lengthFieldBytes)))
+{
+  assert(lengthFieldBytes == 1 || lengthFieldBytes == 2
+         || lengthFieldBytes == 4 || lengthFieldBytes == 8);
+  if (maxFrameLength_ > fieldLimit(lengthFieldBytes))
+  {
+    LOG << "fatal error: LengthFieldCodec maxFrameLength " << maxFrameLength_
+        << " does not fit in " << lengthFieldBytes << " bytes";
+    abort();
+  }
+}
+
+uint64_t LengthFieldCodec::peekLength(const Buffer& buf) const
+{
+  switch (lengthFieldBytes_)
+  {
+    case 1:
+      return static_cast<uint8_t>(buf.peekInt8());
+    case 2:
+      return static_cast<uint16_t>(buf.peekInt16());
+    case 4:
+      return static_cast<uint32_t>(buf.peekInt32());
+    default:
+      return static_cast<uint64_t>(buf.peekInt64());
+  }
+}
+
+void LengthFieldCodec::onMessage(const TcpConnectionPtr& conn,
+                                 Buffer* buf,
+                                 Timestamp receiveTime)
+{
+  const size_t headerLen = lengthFieldBytes_;
+  while (buf->readableBytes() >= headerLen)
+  {
+    const uint64_t len = peekLength(*buf);
+    if (len > maxFrameLength_)
+    {
+      LOG << "error: LengthFieldCodec invalid length " << static_cast<int64_t>(len)
+          << " from " << conn->name();
+      buf->retrieveAll();
+      conn->shutdown();
+      break;
+    }
+    if (buf->readableBytes() < headerLen + len)
+    {
+      break;
+    }
+    StringPiece frame(buf->peek() + headerLen, static_cast<int>(len));
+    frameCallback_(conn, frame, receiveTime);
+    buf->retrieve(headerLen + len);
+  }
+}
+
+/*
+*超过maxFrameLength_的消息不编码：长度字段装不下时截断的长度会让对端错位，
+*之后的每一帧都无法解析；装得下的也会被对端的onMessage()当作非法长度断开连接。
+*/
+bool LengthFieldCodec::encode(const StringPiece& message, Buffer* output) const
+{
+  if (static_cast<size_t>(message.size()) > maxFrameLength_)
+  {
+    LOG << "error: LengthFieldCodec::encode message of " << message.size()
+        << " bytes exceeds maxFrameLength " << maxFrameLength_;
+    return false;
+  }
+  output->ensureWritableBytes(lengthFieldBytes_ + message.size());
+  switch (lengthFieldBytes_)
+  {
+    case 1:
+      output->appendInt8(static_cast<int8_t>(message.size()));
+      break;
+    case 2:
+      output->appendInt16(static_cast<int16_t>(message.size()));
+      break;
+    case 4:
+      output->appendInt32(static_cast<int32_t>(message.size()));
+      break;
+    default:
+      output->appendInt64(static_cast<int64_t>(message.size()));
+      break;
+  }
+  output->append(message);
+  return true;
+}
+
+bool LengthFieldCodec::send(TcpConnection* conn, const StringPiece& message) const
+{
+  Buffer buf;
+  if (!encode(message, &buf))
+  {
+    return false;
+  }
+  conn->send(&buf);
+  return true;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "../base/noncopyable.h"
+#include "../base/StringPiece.h"
+#include "../base/Timestamp.h"
+#include "Buffer.h"
+#include "Callbacks.h"
+
+#include <stdint.h>
+
+class TcpConnection;
+
+///
+/// Frames messages with a big-endian length field of 1, 2, 4 or 8 bytes,
+/// not counting the field itself.
+///
+/// Frames are parsed in place: the callback gets a StringPiece pointing
+/// into the input Buffer, valid only during the callback.
+class LengthFieldCodec : noncopyable
+{
+ public:
+  // move-only like the callbacks in Callbacks.h, set it with a temporary
+  typedef Function<void (const TcpConnectionPtr&,
+                         const StringPiece& frame,
+                         Timestamp)> FrameCallback;
+
+  /// maxFrameLength must fit in the length field, 0 for as much as the
+  /// field holds but no more than 64MB. Longer frames are refused both ways.
+  explicit LengthFieldCodec(FrameCallback cb,
+                            int lengthFieldBytes = 4,
+                            size_t maxFrameLength = 0);
+
+  /// Use as the MessageCallback of the connection.
+  void onMessage(const TcpConnectionPtr& conn,
+                 Buffer* buf,
+                 Timestamp receiveTime);
+
+  /// Appends the length field and message to output.
+  /// @return false, appending nothing, if message is longer than maxFrameLength().
+  bool encode(const StringPiece& message, Buffer* output) const;
+
+  // Thread safe. @return false if message is too long, nothing is sent then.
+  bool send(TcpConnection* conn, const StringPiece& message) const;
+
+  int lengthFieldBytes() const
+  { return lengthFieldBytes_; }
+
+  size_t maxFrameLength() const
+  { return maxFrameLength_; }
+
+ private:
+  uint64_t peekLength(const Buffer& buf) const;
+
+  FrameCallback frameCallback_;
+  const int lengthFieldBytes_;
+  const size_t maxFrameLength_;
+};
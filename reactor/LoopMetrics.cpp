@@ -0,0 +1,96 @@
+#include "LoopMetrics.h"
+
+#include "../base/CurrentThread.h"
+#include "../base/MutexLock.h"
+
+#include <algorithm>
+#include <set>
+
+#include <string.h>
+
+namespace
+{
+
+const LoopMetrics::Info kInfos[LoopMetrics::kNumMetrics] = {
+  { "webserver_loop_polls_total", "counter", "epoll_wait() calls that returned", 1 },
+  { "webserver_loop_events_total", "counter", "Ready channels handled", 1 },
+  { "webserver_loop_functors_total", "counter", "Functors run by doPendingFunctors()", 1 },
+  { "webserver_loop_pending_functors", "gauge", "Functors taken by the last doPendingFunctors()", 1 },
+  { "webserver_loop_timers", "gauge", "Timers scheduled", 1 },
+  { "webserver_loop_timers_fired_total", "counter", "Timer callbacks run", 1 },
+  { "webserver_loop_connections", "gauge", "TCP connections established", 1 },
+  { "webserver_loop_connections_total", "counter", "TCP connections ever established", 1 },
+  { "webserver_loop_read_bytes_total", "counter", "Bytes read from sockets", 1 },
+  { "webserver_loop_written_bytes_total", "counter", "Bytes written to sockets, files included", 1 },
+  { "webserver_loop_poll_wait_seconds_total", "counter", "Time blocked in epoll_wait()", 1e-6 },
+  { "webserver_loop_busy_seconds_total", "counter", "Time spent handling events, functors and timers", 1e-6 },
+  { "webserver_loop_spin_seconds_total", "counter", "Time busy polling with nothing ready", 1e-6 },
+  { "webserver_loop_empty_spins_total", "counter", "Zero-timeout epoll_wait() calls that found nothing ready", 1 },
+};
+
+// loops come and go with their threads, a scrape is rare: a plain mutex
+struct Registry
+{
+  MutexLock mutex;
+  std::set<const LoopMetrics*> loops;
+};
+
+Registry& registry()
+{
+  // never destroyed, a loop may outlive static destruction
+  static Registry* registry = new Registry;
+  return *registry;
+}
+
+bool byTid(const LoopMetrics::Snapshot& lhs, const LoopMetrics::Snapshot& rhs)
+{
+  return lhs.tid < rhs.tid;
+}
+
+}  // namespace
+
+LoopMetrics::LoopMetrics()
+  : busySince_(0),
+    tid_(CurrentThread::tid()),
+    threadName_(CurrentThread::name() ? CurrentThread::name() : "")
+{
+  memset(values_, 0, sizeof values_);
+  Registry& r = registry();
+  MutexLockGuard lock(r.mutex);
+  r.loops.insert(this);
+}
+
+LoopMetrics::~LoopMetrics()
+{
+  Registry& r = registry();
+  MutexLockGuard lock(r.mutex);
+  r.loops.erase(this);
+}
+
+const LoopMetrics::Info& LoopMetrics::info(Metric metric)
+{
+  return kInfos[metric];
+}
+
+void LoopMetrics::collect(std::vector<Snapshot>* snapshots)
+{
+  size_t first = snapshots->size();
+  {
+    Registry& r = registry();
+    MutexLockGuard lock(r.mutex);
+    for (std::set<const LoopMetrics*>::const_iterator it = r.loops.begin();
+         it != r.loops.end(); ++it)
+    {
+      Snapshot snapshot;
+      snapshot.tid = (*it)->tid_;
+      snapshot.threadName = (*it)->threadName_;
+      for (int i = 0; i < kNumMetrics; ++i)
+      {
+        snapshot.values[i] = (*it)->get(static_cast<Metric>(i));
+      }
+      snapshot.busySince = __atomic_load_n(&(*it)->busySince_, __ATOMIC_RELAXED);
+      snapshots->push_back(snapshot);
+    }
+  }
+  std::sort(snapshots->begin() + first, snapshots->end(), byTid);
+}
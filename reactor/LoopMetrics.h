@@ -0,0 +1,92 @@
+#pragma once
+
+#include <boost/noncopyable.hpp>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+///
+/// Counters and gauges of one EventLoop, always on.
+///
+/// Only the loop's own thread writes them, with a relaxed load and store
+/// instead of a locked read-modify-write, so add() costs what incrementing a
+/// plain member does. Any thread may read them: collect() takes a snapshot
+/// of every live loop, for a /metrics scrape.
+///
+class LoopMetrics : boost::noncopyable
+{
+ public:
+  enum Metric
+  {
+    kPolls,             // epoll_wait() returns
+    kEvents,            // ready channels handled
+    kFunctors,          // pending functors run
+    kPendingFunctors,   // gauge, functors taken by the last doPendingFunctors()
+    kTimers,            // gauge, timers scheduled
+    kTimersFired,
+    kConnections,       // gauge, TcpConnections established in this loop
+    kConnectionsTotal,
+    kBytesRead,
+    kBytesWritten,
+    kPollWaitMicros,    // blocked in epoll_wait()
+    kBusyMicros,        // between epoll_wait() returning and the next call
+    kSpinMicros,        // busy polling with nothing ready, see EventLoop::setBusyPoll()
+    kEmptySpins,        // zero-timeout polls that found nothing ready
+    kNumMetrics
+  };
+
+  struct Info
+  {
+    const char* name;   // Prometheus metric name
+    const char* type;   // "counter" or "gauge"
+    const char* help;
+    double scale;       // to the unit of name
+  };
+
+  struct Snapshot
+  {
+    int tid;
+    std::string threadName;
+    int64_t values[kNumMetrics];
+    int64_t busySince;
+  };
+
+  /// Registers for collect(), in the loop's thread.
+  LoopMetrics();
+  ~LoopMetrics();
+
+  void add(Metric metric, int64_t n)
+  {
+    int64_t* p = &values_[metric];
+    __atomic_store_n(p, __atomic_load_n(p, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+  }
+
+  void set(Metric metric, int64_t value)
+  {
+    __atomic_store_n(&values_[metric], value, __ATOMIC_RELAXED);
+  }
+
+  int64_t get(Metric metric) const
+  {
+    return __atomic_load_n(&values_[metric], __ATOMIC_RELAXED);
+  }
+
+  /// When the loop last returned from epoll_wait(), in microseconds since
+  /// the epoch, 0 while it waits. Not exported, for LoopWatchdog.
+  void setBusySince(int64_t micros)
+  {
+    __atomic_store_n(&busySince_, micros, __ATOMIC_RELAXED);
+  }
+
+  static const Info& info(Metric metric);
+
+  /// Appends a snapshot of every live loop, by thread id. Thread safe.
+  static void collect(std::vector<Snapshot>* snapshots);
+
+ private:
+  int64_t values_[kNumMetrics];
+  int64_t busySince_;
+  const int tid_;
+  const std::string threadName_;
+};
@@ -0,0 +1,173 @@
+#include "LoopWatchdog.h"
+
+#include "../base/Logging.h"
+#include "../base/Timestamp.h"
+#include "LoopMetrics.h"
+
+#include <boost/bind.hpp>
+
+#include <cxxabi.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+
+const int kMaxFrames = 64;
+const int kStackSignal = SIGUSR2;
+
+// one dump at a time in the process, written by the signal handler
+MutexLock g_dumpMutex;
+void* g_frames[kMaxFrames];
+int g_numFrames;  // atomic, -1 until the handler is done
+
+void takeStack(int)
+{
+  int n = ::backtrace(g_frames, kMaxFrames);
+  __atomic_store_n(&g_numFrames, n, __ATOMIC_RELEASE);
+}
+
+// "binary(mangled+0x1d) [0x55d1]" with the function name demangled
+std::string demangleFrame(const char* symbol)
+{
+  std::string frame(symbol);
+  size_t begin = frame.find('(');
+  size_t end = frame.find('+', begin);
+  if (begin == std::string::npos || end == std::string::npos || end == begin + 1)
+  {
+    return frame;
+  }
+  std::string mangled(frame, begin + 1, end - begin - 1);
+  int status = 0;
+  char* demangled = abi::__cxa_demangle(mangled.c_str(), NULL, NULL, &status);
+  if (status == 0)
+  {
+    frame.replace(begin + 1, end - begin - 1, demangled);
+  }
+  free(demangled);
+  return frame;
+}
+
+}  // namespace
+
+LoopWatchdog::LoopWatchdog(double stallSeconds)
+  : stallMicros_(static_cast<int64_t>(stallSeconds * Timestamp::kMicroSecondsPerSecond)),
+    running_(false),
+    cond_(mutex_),
+    thread_(boost::bind(&LoopWatchdog::threadFunc, this), "LoopWatchdog")
+{
+}
+
+LoopWatchdog::~LoopWatchdog()
+{
+  stop();
+}
+
+void LoopWatchdog::start()
+{
+  assert(!thread_.started());
+  // backtrace() loads libgcc on its first call, which must not happen
+  // in a signal handler
+  void* frame;
+  ::backtrace(&frame, 1);
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof sa);
+  sa.sa_handler = takeStack;
+  sa.sa_flags = SA_RESTART;
+  ::sigemptyset(&sa.sa_mask);
+  ::sigaction(kStackSignal, &sa, NULL);
+
+  running_ = true;
+  thread_.start();
+}
+
+void LoopWatchdog::stop()
+{
+  {
+    MutexLockGuard lock(mutex_);
+    if (!running_)
+    {
+      return;
+    }
+    running_ = false;
+    cond_.notify();
+  }
+  thread_.join();
+}
+
+// 每隔四分之一个阈值检查一次，停顿的检出延迟不超过阈值的1.25倍
+void LoopWatchdog::threadFunc()
+{
+  const double interval = static_cast<double>(stallMicros_) / Timestamp::kMicroSecondsPerSecond / 4;
+  MutexLockGuard lock(mutex_);
+  while (running_)
+  {
+    cond_.waitForSeconds(interval);
+    if (running_)
+    {
+      check();
+    }
+  }
+}
+
+void LoopWatchdog::check()
+{
+  std::vector<LoopMetrics::Snapshot> loops;
+  LoopMetrics::collect(&loops);
+  int64_t now = Timestamp::now().microSecondsSinceEpoch();
+  std::map<int, int64_t> reported;
+  for (size_t i = 0; i < loops.size(); ++i)
+  {
+    const LoopMetrics::Snapshot& loop = loops[i];
+    if (loop.busySince == 0 || now - loop.busySince < stallMicros_)
+    {
+      continue;
+    }
+    std::map<int, int64_t>::const_iterator it = reported_.find(loop.tid);
+    if (it == reported_.end() || it->second != loop.busySince)
+    {
+      dumpStack(loop.tid, loop.threadName.c_str(), now - loop.busySince);
+    }
+    reported[loop.tid] = loop.busySince;
+  }
+  reported_.swap(reported);
+}
+
+void LoopWatchdog::dumpStack(int tid, const char* threadName, int64_t stalledMicros)
+{
+  LOG << "error: LoopWatchdog EventLoop of thread " << tid << " " << threadName
+      << " has not polled for " << stalledMicros / 1000 << " ms";
+
+  MutexLockGuard lock(g_dumpMutex);
+  __atomic_store_n(&g_numFrames, -1, __ATOMIC_RELAXED);
+  if (::syscall(SYS_tgkill, ::getpid(), tid, kStackSignal) < 0)
+  {
+    LOG << "syserror: LoopWatchdog::dumpStack tgkill";
+    return;
+  }
+  int numFrames = -1;
+  for (int i = 0; i < 100 && numFrames < 0; ++i)
+  {
+    ::usleep(1000);
+    numFrames = __atomic_load_n(&g_numFrames, __ATOMIC_ACQUIRE);
+  }
+  if (numFrames < 0)
+  {
+    LOG << "error: LoopWatchdog thread " << tid << " did not take its stack";
+    return;
+  }
+
+  char** symbols = ::backtrace_symbols(g_frames, numFrames);
+  // skip takeStack() and the signal trampoline
+  for (int i = 2; i < numFrames; ++i)
+  {
+    LOG << "error: LoopWatchdog   #" << i - 2 << " "
+        << (symbols ? demangleFrame(symbols[i]) : std::string("?"));
+  }
+  free(symbols);
+}
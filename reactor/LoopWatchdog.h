@@ -0,0 +1,40 @@
+#pragma once
+
+#include "../base/Condition.h"
+#include "../base/MutexLock.h"
+#include "../base/Thread.h"
+
+#include <map>
+#include <stdint.h>
+
+///
+/// Watches every EventLoop of the process from a thread of its own, and logs
+/// the stack of any loop that has not gone back to epoll_wait() for
+/// stallSeconds, once per stall.
+///
+/// The stalled thread takes its own stack in a SIGUSR2 handler that only
+/// calls backtrace(3), the watchdog thread symbolizes and logs it. Link the
+/// program with -rdynamic if function names are missing. A sleep or other
+/// call the stalled thread is blocked in may return early with EINTR.
+///
+class LoopWatchdog : noncopyable
+{
+ public:
+  explicit LoopWatchdog(double stallSeconds);
+  ~LoopWatchdog();  // stops
+
+  void start();
+  void stop();
+
+ private:
+  void threadFunc();
+  void check();
+  void dumpStack(int tid, const char* threadName, int64_t stalledMicros);
+
+  const int64_t stallMicros_;
+  bool running_;  // guarded by mutex_
+  MutexLock mutex_;
+  Condition cond_;
+  Thread thread_;
+  std::map<int, int64_t> reported_;  // tid to the busySince already logged
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "BufferPool.h"
+
+#include <stddef.h>
+
+///
+/// A C++11 allocator taking its memory from BufferPool, so objects released
+/// in an EventLoop thread are recycled by the next allocation in that thread.
+///
+/// Meant for boost::allocate_shared of objects created and destroyed in the
+/// same loop, e.g. TcpConnection, which then costs one pooled chunk for the
+/// object and its control block.
+template <typename T>
+class PoolAllocator
+{
+ public:
+  typedef T value_type;
+
+  PoolAllocator() {}
+
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U>&) {}
+
+  template <typename U>
+  struct rebind
+  {
+    typedef PoolAllocator<U> other;
+  };
+
+  T* allocate(size_t n)
+  {
+    size_t capacity = 0;
+    return reinterpret_cast<T*>(BufferPool::allocate(n * sizeof(T), &capacity));
+  }
+
+  void deallocate(T* p, size_t n)
+  {
+    BufferPool::deallocate(reinterpret_cast<char*>(p),
+                           BufferPool::chunkSize(n * sizeof(T)));
+  }
+};
+
+template <typename T, typename U>
+inline bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&)
+{ return true; }
+
+template <typename T, typename U>
+inline bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&)
+{ return false; }
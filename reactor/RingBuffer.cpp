@@ -0,0 +1,118 @@
+#include "RingBuffer.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+std::string RingBuffer::retrieveAllAsString()
+{
+  std::string str;
+  str.reserve(readableBytes());
+  struct iovec vec[2];
+  int count = peek(vec);
+  for (int i = 0; i < count; ++i)
+  {
+    str.append(static_cast<const char*>(vec[i].iov_base), vec[i].iov_len);
+  }
+  retrieveAll();
+  return str;
+}
+
+/*
+*扩容时把两段可读数据按顺序拷贝到新chunk的开头，这是ring buffer唯一需要搬移数据的地方，
+*容量按2的幂增长，所以每个字节平均只被搬移常数次。
+*/
+void RingBuffer::grow(size_t len)
+{
+  size_t readable = readableBytes();
+  size_t capacity = 0;
+  char* chunk = BufferPool::allocate(readable + len, &capacity);
+  assert((capacity & (capacity - 1)) == 0);
+  struct iovec vec[2];
+  int count = peek(vec);
+  size_t copied = 0;
+  for (int i = 0; i < count; ++i)
+  {
+    memcpy(chunk + copied, vec[i].iov_base, vec[i].iov_len);
+    copied += vec[i].iov_len;
+  }
+  release();
+  buffer_ = chunk;
+  capacity_ = capacity;
+  readerIndex_ = 0;
+  writerIndex_ = readable;
+}
+
+ssize_t RingBuffer::readFd(int fd, char* extrabuf, size_t extrabufLen, int* savedErrno)
+{
+  if (buffer_ == NULL)
+  {
+    grow(BufferPool::kMinChunk);
+  }
+  struct iovec vec[3];
+  int count = 0;
+  const size_t writable = writableBytes();
+  size_t begin = writerIndex_ & (capacity_ - 1);
+  size_t first = std::min(writable, capacity_ - begin);
+  if (first > 0)
+  {
+    vec[count].iov_base = buffer_ + begin;
+    vec[count].iov_len = first;
+    ++count;
+  }
+  if (writable > first)
+  {
+    vec[count].iov_base = buffer_;
+    vec[count].iov_len = writable - first;
+    ++count;
+  }
+  if (extrabuf != NULL)
+  {
+    vec[count].iov_base = extrabuf;
+    vec[count].iov_len = extrabufLen;
+    ++count;
+  }
+
+  const ssize_t n = ::readv(fd, vec, count);
+  if (n <= 0)
+  {
+    if (n < 0)
+    {
+      *savedErrno = errno;
+    }
+    if (readableBytes() == 0)
+    {
+      retrieveAll();
+    }
+  }
+  else if (static_cast<size_t>(n) <= writable)
+  {
+    writerIndex_ += n;
+  }
+  else
+  {
+    writerIndex_ += writable;
+    append(extrabuf, n - writable);
+  }
+  return n;
+}
+
+ssize_t RingBuffer::writeFd(int fd, int* savedErrno)
+{
+  struct iovec vec[2];
+  int count = peek(vec);
+  if (count == 0)
+  {
+    return 0;
+  }
+  const ssize_t n = ::writev(fd, vec, count);
+  if (n < 0)
+  {
+    *savedErrno = errno;
+  }
+  else
+  {
+    retrieve(n);
+  }
+  return n;
+}
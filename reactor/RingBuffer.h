@@ -0,0 +1,158 @@
+#pragma once
+
+#include "../base/noncopyable.h"
+#include "../base/StringPiece.h"
+#include "BufferPool.h"
+
+#include <algorithm>
+#include <string>
+
+#include <assert.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/// A circular variant of Buffer for streaming.
+///
+/// @code
+/// +------------------+------------------+------------------+
+/// |  readable (tail) |     writable     |  readable (head) |
+/// +------------------+------------------+------------------+
+/// 0                                                  capacity
+/// @endcode
+///
+/// Readable bytes may wrap around the end of the storage, so they are never
+/// moved to make room, peek() describes them as up to two iovecs for
+/// writev(2). Like Buffer, the storage is a BufferPool chunk held only
+/// while the buffer is not empty; it grows by copying into a bigger chunk.
+class RingBuffer : noncopyable
+{
+ public:
+  RingBuffer()
+    : buffer_(NULL),
+      capacity_(0),
+      readerIndex_(0),
+      writerIndex_(0)
+  {
+  }
+
+  ~RingBuffer()
+  {
+    release();
+  }
+
+  void swap(RingBuffer& rhs)
+  {
+    std::swap(buffer_, rhs.buffer_);
+    std::swap(capacity_, rhs.capacity_);
+    std::swap(readerIndex_, rhs.readerIndex_);
+    std::swap(writerIndex_, rhs.writerIndex_);
+  }
+
+  size_t readableBytes() const
+  { return writerIndex_ - readerIndex_; }
+
+  size_t writableBytes() const
+  { return capacity_ - readableBytes(); }
+
+  /// Fills vec with the readable bytes in order.
+  /// @return the number of iovecs used, 0 to 2
+  int peek(struct iovec vec[2]) const
+  {
+    size_t readable = readableBytes();
+    if (readable == 0)
+    {
+      return 0;
+    }
+    size_t begin = readerIndex_ & (capacity_ - 1);
+    size_t first = std::min(readable, capacity_ - begin);
+    vec[0].iov_base = buffer_ + begin;
+    vec[0].iov_len = first;
+    if (first == readable)
+    {
+      return 1;
+    }
+    vec[1].iov_base = buffer_;
+    vec[1].iov_len = readable - first;
+    return 2;
+  }
+
+  void retrieve(size_t len)
+  {
+    assert(len <= readableBytes());
+    if (len < readableBytes())
+    {
+      readerIndex_ += len;
+    }
+    else
+    {
+      retrieveAll();
+    }
+  }
+
+  void retrieveAll()
+  {
+    readerIndex_ = 0;
+    writerIndex_ = 0;
+    release();
+  }
+
+  std::string retrieveAllAsString();
+
+  void append(const StringPiece& str)
+  {
+    append(str.data(), str.size());
+  }
+
+  void append(const char* /*restrict*/ data, size_t len)
+  {
+    ensureWritableBytes(len);
+    size_t begin = writerIndex_ & (capacity_ - 1);
+    size_t first = std::min(len, capacity_ - begin);
+    memcpy(buffer_ + begin, data, first);
+    memcpy(buffer_, data + first, len - first);
+    writerIndex_ += len;
+  }
+
+  void append(const void* /*restrict*/ data, size_t len)
+  {
+    append(static_cast<const char*>(data), len);
+  }
+
+  void ensureWritableBytes(size_t len)
+  {
+    if (writableBytes() < len)
+    {
+      grow(len);
+    }
+    assert(writableBytes() >= len);
+  }
+
+  /// Reads into the writable space, what does not fit goes to
+  /// extrabuf[0, extrabufLen), e.g. EventLoop::readScratch(), and is
+  /// appended from there; NULL reads no more than writableBytes().
+  /// @return result of readv(2), @c errno is saved
+  ssize_t readFd(int fd, char* extrabuf, size_t extrabufLen, int* savedErrno);
+
+  /// writev(2)s the readable bytes and retrieves what was written.
+  /// @return result of writev(2), @c errno is saved
+  ssize_t writeFd(int fd, int* savedErrno);
+
+ private:
+  void grow(size_t len);
+
+  void release()
+  {
+    if (buffer_)
+    {
+      BufferPool::deallocate(buffer_, capacity_);
+      buffer_ = NULL;
+      capacity_ = 0;
+    }
+  }
+
+  char* buffer_;        // a BufferPool chunk, capacity_ is a power of two
+  size_t capacity_;
+  size_t readerIndex_;  // both only grow, wrapped with capacity_ - 1
+  size_t writerIndex_;
+};
@@ -57,3 +57,9 @@ void Socket::setTcpNoDelay(bool on)
                &optval, sizeof optval);
   // FIXME CHECK
 }
+
+bool Socket::setBusyPoll(int micros)
+{
+  return ::setsockopt(sockfd_, SOL_SOCKET, SO_BUSY_POLL,
+                      &micros, sizeof micros) == 0;
+}
@@ -42,6 +42,13 @@ class Socket : boost::noncopyable
   /// 
   void setTcpNoDelay(bool on);
 
+  ///
+  /// Sets SO_BUSY_POLL, microseconds to busy poll the device queue on an
+  /// empty receive queue, raising it above net.core.busy_read needs
+  /// CAP_NET_ADMIN. Returns false on failure.
+  ///
+  bool setBusyPoll(int micros);
+
  private:
   const int sockfd_;
 };
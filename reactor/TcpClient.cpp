@@ -8,6 +8,7 @@
 #include "../base/Logging.h"
 
 #include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
 
 #include <stdio.h>  // snprintf
 
@@ -31,6 +32,11 @@ namespace detail
     loop->queueInLoop(boost::bind(&TcpConnection::connectDestroyed, conn));
   }
 
+  void setRemoveCallback(EventLoop* loop, const TcpConnectionPtr& conn)
+  {
+    conn->setCloseCallback(boost::bind(&removeConnection, loop, _1));
+  }
+
   void removeConnector(const ConnectorPtr& connector)
   {
     //connector->
@@ -41,6 +47,7 @@ TcpClient::TcpClient(EventLoop* loop,
                      const InetAddress& serverAddr)
   : loop_(loop),
     connector_(new Connector(loop, serverAddr)),
+    callbacks_(boost::make_shared<TcpConnection::Callbacks>()),
     retry_(false),
     connect_(true),
     nextConnId_(1)
@@ -64,9 +71,8 @@ TcpClient::~TcpClient()
   if (conn)
   {
     // FIXME: not 100% safe, if we are in different thread
-    CloseCallback cb = boost::bind(&detail::removeConnection, loop_, _1);
     loop_->runInLoop(
-        boost::bind(&TcpConnection::setCloseCallback, conn, cb));
+        boost::bind(&detail::setRemoveCallback, loop_, conn));
   }
   else
   {
@@ -115,16 +121,13 @@ void TcpClient::newConnection(int sockfd)
 
   InetAddress localAddr(sockets::getLocalAddr(sockfd));
   // FIXME poll with zero timeout to double confirm the new connection
-  // FIXME use make_shared if necessary
-  TcpConnectionPtr conn(new TcpConnection(loop_,
-                                          connName,
-                                          sockfd,
-                                          localAddr,
-                                          peerAddr));
-
-  conn->setConnectionCallback(connectionCallback_);
-  conn->setMessageCallback(messageCallback_);
-  conn->setWriteCompleteCallback(writeCompleteCallback_);
+  TcpConnectionPtr conn(TcpConnection::create(loop_,
+                                               connName,
+                                               sockfd,
+                                               localAddr,
+                                               peerAddr));
+
+  conn->setCallbacks(callbacks_);
   conn->setCloseCallback(
       boost::bind(&TcpClient::removeConnection, this, _1)); // FIXME: unsafe
   {
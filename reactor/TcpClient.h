@@ -28,19 +28,19 @@ class TcpClient : boost::noncopyable
   void enableRetry() { retry_ = true; }
 
   /// Set connection callback.
-  /// Not thread safe.
-  void setConnectionCallback(const ConnectionCallback& cb)
-  { connectionCallback_ = cb; }
+  /// Must be called before @c connect
+  void setConnectionCallback(ConnectionCallback cb)
+  { callbacks_->connection = std::move(cb); }
 
   /// Set message callback.
-  /// Not thread safe.
-  void setMessageCallback(const MessageCallback& cb)
-  { messageCallback_ = cb; }
+  /// Must be called before @c connect
+  void setMessageCallback(MessageCallback cb)
+  { callbacks_->message = std::move(cb); }
 
   /// Set write complete callback.
-  /// Not thread safe.
-  void setWriteCompleteCallback(const WriteCompleteCallback& cb)
-  { writeCompleteCallback_ = cb; }
+  /// Must be called before @c connect
+  void setWriteCompleteCallback(WriteCompleteCallback cb)
+  { callbacks_->writeComplete = std::move(cb); }
 
  private:
   /// Not thread safe, but in loop
@@ -50,9 +50,7 @@ class TcpClient : boost::noncopyable
 
   EventLoop* loop_;
   ConnectorPtr connector_; // avoid revealing Connector
-  ConnectionCallback connectionCallback_;
-  MessageCallback messageCallback_;
-  WriteCompleteCallback writeCompleteCallback_;
+  boost::shared_ptr<TcpConnection::Callbacks> callbacks_;
   bool retry_;   // atmoic
   bool connect_; // atomic
   // always in loop thread
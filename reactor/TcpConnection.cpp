@@ -1,14 +1,18 @@
 #include "TcpConnection.h"
 
+#include "../base/FileUtil.h"
 #include "../base/Logging.h"
-#include "Channel.h"
+#include "ConnectionTable.h"
 #include "EventLoop.h"
-#include "Socket.h"
+#include "PoolAllocator.h"
 #include "SocketsOps.h"
+#include "Trace.h"
 #include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
 
 #include <errno.h>
 #include <stdio.h>
+#include <sys/sendfile.h>
 
 using namespace std;
 
@@ -18,42 +22,83 @@ TcpConnection::TcpConnection(EventLoop* loop,
                              const InetAddress& localAddr,
                              const InetAddress& peerAddr)
   : loop_(loop),
+    localRefs_(0),
+    destroyed_(false),
     name_(nameArg),
+    serverName_(NULL),
+    id_(0),
     state_(kConnecting),
-    socket_(new Socket(sockfd)),
-    channel_(new Channel(loop, sockfd)),
+    socket_(sockfd),
+    channel_(loop, sockfd),
     localAddr_(localAddr),
-    peerAddr_(peerAddr)
+    peerAddr_(peerAddr),
+    ringOutput_(false)
 {
   if(loop_ == NULL)
     LOG << "fatal error: TcpConnection::TcpConnection loop can't be NULL";
-  LOG << "TcpConnection::ctor[" <<  name_ << "] at "
-            << " fd=" << sockfd;
-  channel_->setReadCallback(
+  LOG << "TcpConnection::ctor fd=" << sockfd;
+  channel_.setReadCallback(
       boost::bind(&TcpConnection::handleRead, this, _1));
-  channel_->setWriteCallback(
+  channel_.setWriteCallback(
       boost::bind(&TcpConnection::handleWrite, this));
-  channel_->setCloseCallback(
+  channel_.setCloseCallback(
       boost::bind(&TcpConnection::handleClose, this));
-  channel_->setErrorCallback(
+  channel_.setErrorCallback(
       boost::bind(&TcpConnection::handleError, this));
 }
 
 TcpConnection::~TcpConnection()
 {
-  LOG << "TcpConnection::dtor[" <<  name_ << "] at "
-            << " fd=" << channel_->fd();
+  LOG << "TcpConnection::dtor fd=" << channel_.fd();
   //printf("TcpConnection::~TcpConnection, TcpConnetion release");
 }
 
+/*
+*短连接场景下每个连接的创建和销毁都在它所属的IO线程中进行，
+*用allocate_shared把TcpConnection和shared_ptr的控制块放在同一块BufferPool chunk里，
+*连接关闭后chunk回到该线程的空闲链表，下一个连接直接复用，不经过malloc。
+*/
+/*
+*TcpServer的连接名"ip:port#loop.fd.generation"很少被用到(HttpServer从不使用)，
+*所以不在建连时拼接，第一次调用name()时才生成，短连接因此少一次字符串分配。
+*/
+const std::string& TcpConnection::name() const
+{
+  if (serverName_)
+  {
+    // built lazily below, a call from another thread would race with it
+    loop_->assertInLoopThread();
+  }
+  if (name_.empty() && serverName_)
+  {
+    char buf[32];
+    snprintf(buf, sizeof buf, "#%d.%d.%u",
+             ConnectionTable::loopIndexOf(id_),
+             ConnectionTable::fdOf(id_),
+             ConnectionTable::generationOf(id_));
+    name_ = *serverName_ + buf;
+  }
+  return name_;
+}
+
+TcpConnectionPtr TcpConnection::create(EventLoop* loop,
+                                       const std::string& name,
+                                       int sockfd,
+                                       const InetAddress& localAddr,
+                                       const InetAddress& peerAddr)
+{
+  return boost::allocate_shared<TcpConnection>(PoolAllocator<TcpConnection>(),
+                                               loop, name, sockfd, localAddr, peerAddr);
+}
+
 void TcpConnection::send(const std::string& message)
 {
   if (state_ == kConnected) {
     if (loop_->isInLoopThread()) {
       sendInLoop(message);
     } else {
-      loop_->runInLoop(
-          boost::bind(&TcpConnection::sendInLoop, this, message));
+      void (TcpConnection::*fp)(const std::string&) = &TcpConnection::sendInLoop;
+      loop_->runInLoop(boost::bind(fp, this, message));
     }
   }
 }
@@ -64,12 +109,45 @@ void TcpConnection::send(Buffer* buf)
   {
     if (loop_->isInLoopThread())
     {
-      sendInLoop(buf->retrieveAllAsString());
+      sendInLoop(buf->peek(), buf->readableBytes());
+      buf->retrieveAll();
+    }
+    else
+    {
+      void (TcpConnection::*fp)(const std::string&) = &TcpConnection::sendInLoop;
+      loop_->runInLoop(boost::bind(fp, this, buf->retrieveAllAsString()));
+    }
+  }
+}
+
+void TcpConnection::send(const boost::shared_ptr<const std::string>& message)
+{
+  if (state_ == kConnected)
+  {
+    if (loop_->isInLoopThread())
+    {
+      sendInLoop(message->data(), message->size());
     }
     else
     {
       loop_->runInLoop(
-          boost::bind(&TcpConnection::sendInLoop, this, buf->retrieveAllAsString()));
+          boost::bind(&TcpConnection::sendSharedInLoop, this, message));
+    }
+  }
+}
+
+void TcpConnection::sendFile(const FilePtr& file, off_t offset, size_t count)
+{
+  if (state_ == kConnected)
+  {
+    if (loop_->isInLoopThread())
+    {
+      sendFileInLoop(file, offset, count);
+    }
+    else
+    {
+      loop_->runInLoop(
+          boost::bind(&TcpConnection::sendFileInLoop, this, file, offset, count));
     }
   }
 }
@@ -80,20 +158,39 @@ void TcpConnection::send(Buffer* buf)
 *以后在handleWrite()中发送剩余的数据。
 */
 void TcpConnection::sendInLoop(const std::string& message)
+{
+  sendInLoop(message.data(), message.size());
+}
+
+void TcpConnection::sendSharedInLoop(const boost::shared_ptr<const std::string>& message)
+{
+  sendInLoop(message->data(), message->size());
+}
+
+void TcpConnection::sendInLoop(const void* data, size_t len)
 {
   loop_->assertInLoopThread();
+  const char* message = static_cast<const char*>(data);
+  if (!pendingFiles_.empty())
+  {
+    // queue behind the file, writing is already enabled
+    pendingFiles_.back().trailer.append(message, len);
+    return;
+  }
   ssize_t nwrote = 0;
   // if no thing in output queue, try writing directly
-  if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0) {
-    nwrote = ::write(channel_->fd(), message.data(), message.size());
+  if (!channel_.isWriting() && outputBytes() == 0) {
+    nwrote = ::write(channel_.fd(), message, len);
     if (nwrote >= 0) {
-      if (static_cast<size_t>(nwrote) < message.size()) {
+      loop_->metrics()->add(LoopMetrics::kBytesWritten, nwrote);
+      trace::record(trace::kSend, static_cast<uint32_t>(nwrote));
+      if (static_cast<size_t>(nwrote) < len) {
         LOG<< "trace: I am going to write more data";
       }
-    }  
-    else if (writeCompleteCallback_) {
+      else if (callbacks_->writeComplete) {
         loop_->queueInLoop(
-            boost::bind(writeCompleteCallback_, shared_from_this()));
+            boost::bind(&TcpConnection::writeCompleteInLoop, localPtr()));
+      }
     }
     else {
       nwrote = 0;
@@ -104,12 +201,85 @@ void TcpConnection::sendInLoop(const std::string& message)
   }
 
   assert(nwrote >= 0);
-  if (static_cast<size_t>(nwrote) < message.size()) {
-    outputBuffer_.append(message.data()+nwrote, message.size()-nwrote);
-    if (!channel_->isWriting()) {
-      channel_->enableWriting();
+  if (static_cast<size_t>(nwrote) < len) {
+    if (ringOutput_) {
+      outputRing_.append(message+nwrote, len-nwrote);
+    } else {
+      outputBuffer_.append(message+nwrote, len-nwrote);
+    }
+    if (!channel_.isWriting()) {
+      channel_.enableWriting();
+    }
+  }
+}
+
+/*
+*sendFileInLoop把文件区间排到outputBuffer_中已有数据之后，如果前面没有待发送的数据就直接sendfile，
+*发不完的部分等writable事件，在handleWrite()中继续发送。
+*/
+void TcpConnection::sendFileInLoop(const FilePtr& file, off_t offset, size_t count)
+{
+  loop_->assertInLoopThread();
+  PendingFile pending;
+  pending.file = file;
+  pending.offset = offset;
+  pending.remaining = count;
+  pendingFiles_.push_back(pending);
+
+  if (!channel_.isWriting() && outputBytes() == 0
+      && pendingFiles_.size() == 1)
+  {
+    writeFile();
+  }
+  if (!pendingFiles_.empty() && !channel_.isWriting())
+  {
+    channel_.enableWriting();
+  }
+}
+
+// 发送队首文件，发完返回true，并把排在它后面的数据移入outputBuffer_；文件变短时关闭连接
+bool TcpConnection::writeFile()
+{
+  assert(outputBytes() == 0);
+  PendingFile& pending = pendingFiles_.front();
+  while (pending.remaining > 0)
+  {
+    ssize_t n = ::sendfile(channel_.fd(), pending.file->fd(),
+                           &pending.offset, pending.remaining);
+    if (n > 0)
+    {
+      pending.remaining -= n;
+      loop_->metrics()->add(LoopMetrics::kBytesWritten, n);
+      trace::record(trace::kFlush, static_cast<uint32_t>(n));
+    }
+    else if (n == 0)
+    {
+      // the file shrank, the headers promised the peer more bytes than are left
+      LOG << "error: TcpConnection::writeFile file shrinks [" << name() << "]";
+      pendingFiles_.clear();
+      setState(kDisconnecting);
+      handleClose();
+      return false;
+    }
+    else
+    {
+      if (errno != EWOULDBLOCK)
+      {
+        LOG << "system error: TcpConnection::writeFile";
+      }
+      return false;
     }
   }
+  if (ringOutput_)
+  {
+    outputRing_.append(pending.trailer.peek(), pending.trailer.readableBytes());
+  }
+  else
+  {
+    outputBuffer_.swap(pending.trailer);
+  }
+  pendingFiles_.pop_front();
+  return true;
 }
 
 void TcpConnection::shutdown()
@@ -126,26 +296,56 @@ void TcpConnection::shutdown()
 void TcpConnection::shutdownInLoop()
 {
   loop_->assertInLoopThread();
-  if (!channel_->isWriting())
+  if (!channel_.isWriting())
   {
     // we are not writing
-    socket_->shutdownWrite();
+    socket_.shutdownWrite();
   }
 }
 
+void TcpConnection::writeCompleteInLoop()
+{
+  callbacks_->writeComplete(self_);
+}
+
 void TcpConnection::setTcpNoDelay(bool on)
 {
-  socket_->setTcpNoDelay(on);
+  socket_.setTcpNoDelay(on);
+}
+
+void TcpConnection::setBusyPoll(int micros)
+{
+  if (!socket_.setBusyPoll(micros))
+  {
+    LOG << "syserror: TcpConnection::setBusyPoll [" << name() << "]";
+  }
+}
+
+void TcpConnection::setRingOutputBuffer(bool on)
+{
+  loop_->assertInLoopThread();
+  assert(outputBytes() == 0 && pendingFiles_.empty());
+  ringOutput_ = on;
 }
 
+/*
+*连接建立后self_持有自身的shared_ptr，读事件、关闭和写完成回调都把self_的引用借给用户，
+*不再每次调用shared_from_this()(一次原子CAS加一次原子减)。
+*self_直到connectDestroyed()之后、并且最后一个TcpConnectionLocalPtr释放时才放开，
+*所以这些回调执行期间连接一定存活。
+*/
 void TcpConnection::connectEstablished()
 {
   loop_->assertInLoopThread();
   assert(state_ == kConnecting);
   setState(kConnected);
-  channel_->enableReading();
+  self_ = shared_from_this();
+  channel_.enableReading();
+  loop_->metrics()->add(LoopMetrics::kConnections, 1);
+  loop_->metrics()->add(LoopMetrics::kConnectionsTotal, 1);
+  trace::record(trace::kConnectionOpen, channel_.fd());
 
-  connectionCallback_(shared_from_this());
+  callbacks_->connection(self_);
 }
 
 /*
@@ -156,22 +356,64 @@ void TcpConnection::connectDestroyed()
   loop_->assertInLoopThread();
   assert(state_ == kConnected || state_ == kDisconnecting);
   setState(kDisconnected);
-  channel_->disableAll();
-  connectionCallback_(shared_from_this());
+  channel_.disableAll();
+  callbacks_->connection(self_);
+
+  loop_->removeChannel(&channel_);//EventLoop新增了removeChannel()成员函数，它会调用Poller::removeChannel()
+  loop_->metrics()->add(LoopMetrics::kConnections, -1);
+  trace::record(trace::kConnectionClose, channel_.fd());
+  destroyed_ = true;
+  if (localRefs_ == 0)
+  {
+    releaseSelf();  // may delete this
+  }
+}
 
-  loop_->removeChannel(get_pointer(channel_));//EventLoop新增了removeChannel()成员函数，它会调用Poller::removeChannel()
+void TcpConnection::releaseSelf()
+{
+  TcpConnectionPtr self;
+  self.swap(self_);
+}
+
+void intrusive_ptr_add_ref(TcpConnection* conn)
+{
+  assert(conn->loop_->isInLoopThread());
+  ++conn->localRefs_;
+}
+
+void intrusive_ptr_release(TcpConnection* conn)
+{
+  assert(conn->loop_->isInLoopThread());
+  if (--conn->localRefs_ == 0 && conn->destroyed_)
+  {
+    conn->releaseSelf();  // may delete conn
+  }
 }
 
 /*
 *TcpConnection::handleRead()会检查read的返回值，根据返回值分别调用
-*messageCallback_，handleClose()，handleError()
+*callbacks_->message，handleClose()，handleError()
+*
+*inputBuffer_为空时(最常见的情况，整个请求一次读完)，直接借用EventLoop的scratch读取，
+*callbacks_->message在scratch上原地解析，之后只把没有消费完的部分拷贝进inputBuffer_自己的chunk。
+*inputBuffer_有积压数据时，scratch充当readv的第二块缓冲区，代替栈上的64KB extrabuf。
 */
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
+  loop_->assertInLoopThread();
   int savedErrno = 0;
-  ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
+  ssize_t n = 0;
+  char* scratch = loop_->readScratch();
+  if (inputBuffer_.readableBytes() == 0) {
+    inputBuffer_.borrow(scratch, EventLoop::kReadScratchSize);
+    n = inputBuffer_.readFd(channel_.fd(), NULL, 0, &savedErrno);
+  } else {
+    n = inputBuffer_.readFd(channel_.fd(), scratch, EventLoop::kReadScratchSize, &savedErrno);
+  }
   if (n > 0) {
-    messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+    loop_->metrics()->add(LoopMetrics::kBytesRead, n);
+    callbacks_->message(self_, &inputBuffer_, receiveTime);
+    inputBuffer_.ownStorage();
   } else if (n == 0) {
     handleClose();
   } else {
@@ -184,32 +426,59 @@ void TcpConnection::handleRead(Timestamp receiveTime)
 void TcpConnection::handleWrite()
 {
   loop_->assertInLoopThread();
-  if (channel_->isWriting()) {
-    ssize_t n = ::write(channel_->fd(),
-                        outputBuffer_.peek(),
-                        outputBuffer_.readableBytes());
-    if (n > 0) {
-      outputBuffer_.retrieve(n);
-      if (outputBuffer_.readableBytes() == 0) 
+  if (channel_.isWriting()) {
+    // outputBuffer_ and pendingFiles_ are drained in the order they were sent
+    while (true)
+    {
+      if (outputBytes() > 0)
       {
-        channel_->disableWriting();
-        if (writeCompleteCallback_) {
-          loop_->queueInLoop(
-              boost::bind(writeCompleteCallback_, shared_from_this()));
+        ssize_t n = 0;
+        if (ringOutput_)
+        {
+          int savedErrno = 0;
+          n = outputRing_.writeFd(channel_.fd(), &savedErrno);
+        }
+        else
+        {
+          n = ::write(channel_.fd(),
+                      outputBuffer_.peek(),
+                      outputBuffer_.readableBytes());
+          if (n > 0)
+          {
+            outputBuffer_.retrieve(n);
+          }
         }
-        if (state_ == kDisconnecting) 
+        if (n <= 0)
         {
-          shutdownInLoop();
+          LOG << "system error: TcpConnection::handleWrite";
+          return;
         }
-      } 
-      else 
+        loop_->metrics()->add(LoopMetrics::kBytesWritten, n);
+        trace::record(trace::kFlush, static_cast<uint32_t>(n));
+        if (outputBytes() > 0)
+        {
+          LOG << "trace: I am going to write more data";
+          return;
+        }
+      }
+      if (pendingFiles_.empty())
+      {
+        break;
+      }
+      if (!writeFile())
       {
-        LOG << "trace: I am going to write more data";
+        return;
       }
-    } 
-    else 
+    }
+
+    channel_.disableWriting();
+    if (callbacks_->writeComplete) {
+      loop_->queueInLoop(
+          boost::bind(&TcpConnection::writeCompleteInLoop, localPtr()));
+    }
+    if (state_ == kDisconnecting) 
     {
-      LOG << "system error: TcpConnection::handleWrite";
+      shutdownInLoop();
     }
   } 
   else 
@@ -229,14 +498,14 @@ void TcpConnection::handleClose()
   LOG << "trace: TcpConnection::handleClose state = " << state_;
   assert(state_ == kConnected || state_ == kDisconnecting);
   // we don't close fd, leave it to dtor, so we can find leaks easily.
-  channel_->disableAll();
+  channel_.disableAll();
   // must be the last line
-  closeCallback_(shared_from_this());
+  closeCallback_(self_);
 }
 
 void TcpConnection::handleError()
 {
-  int err = sockets::getSocketError(channel_->fd());
-  LOG << "error: TcpConnection::handleError [" << name_
+  int err = sockets::getSocketError(channel_.fd());
+  LOG << "error: TcpConnection::handleError [" << name()
             << "] - SO_ERROR = " << err << " " << strerror_tl(err);
 }
\ No newline at end of file
@@ -2,18 +2,27 @@
 
 #include "Buffer.h"
 #include "Callbacks.h"
+#include "Channel.h"
 #include "InetAddress.h"
+#include "RingBuffer.h"
+#include "Socket.h"
 
 #include <boost/any.hpp>
 #include <boost/enable_shared_from_this.hpp>
+#include <boost/intrusive_ptr.hpp>
 #include <boost/noncopyable.hpp>
-#include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
 
+#include <list>
+#include <stdint.h>
+#include <sys/types.h>
 
-class Channel;
 class EventLoop;
-class Socket;
+class TcpConnection;
+
+/// A reference to a TcpConnection confined to its loop's thread,
+/// copied and released without atomic operations.
+typedef boost::intrusive_ptr<TcpConnection> TcpConnectionLocalPtr;
 
 ///
 /// TCP connection, for both client and server usage.
@@ -25,6 +34,7 @@ class TcpConnection : boost::noncopyable,
   /// Constructs a TcpConnection with a connected sockfd
   ///
   /// User should not create this object.
+  /// TcpServer and TcpClient allocate it with create().
   TcpConnection(EventLoop* loop,
                 const std::string& name,
                 int sockfd,
@@ -32,19 +42,51 @@ class TcpConnection : boost::noncopyable,
                 const InetAddress& peerAddr);
   ~TcpConnection();
 
+  /// Allocates the connection and its shared_ptr control block as one
+  /// BufferPool chunk of the calling thread, call in loop's thread.
+  static boost::shared_ptr<TcpConnection> create(EventLoop* loop,
+                                                 const std::string& name,
+                                                 int sockfd,
+                                                 const InetAddress& localAddr,
+                                                 const InetAddress& peerAddr);
+
   EventLoop* getLoop() const { return loop_; }
-  const std::string& name() const { return name_; }
+  /// For a connection of TcpServer, built on the first call and
+  /// only callable in loop's thread.
+  const std::string& name() const;
+  /// Unique within its TcpServer, 0 for a connection of TcpClient.
+  uint64_t id() const { return id_; }
   const InetAddress& localAddress() { return localAddr_; }
   const InetAddress& peerAddress() { return peerAddr_; }
   bool connected() const { return state_ == kConnected; }
+  /// True until everything sent so far has been written to the socket,
+  /// in loop's thread.
+  bool writing() const { return channel_.isWriting(); }
+
+  /// Keeps the connection alive like shared_from_this(), e.g. bound into
+  /// a functor for queueInLoop(), but with a plain counter.
+  /// Copy and destroy it only in loop's thread.
+  TcpConnectionLocalPtr localPtr() { return TcpConnectionLocalPtr(this); }
 
   //void send(const void* message, size_t len);
   // Thread safe.
   void send(const std::string& message);
   void send(Buffer* message);  // this one will swap data
+  // Shares message with other connections instead of copying it
+  // when called from another thread, e.g. a broadcast. Thread safe.
+  void send(const boost::shared_ptr<const std::string>& message);
+  // Sends [offset, offset+count) of file with sendfile(2), after all data
+  // sent before it, keeping file open until done. Thread safe.
+  void sendFile(const FilePtr& file, off_t offset, size_t count);
   // Thread safe.
   void shutdown();
   void setTcpNoDelay(bool on);
+  // SO_BUSY_POLL, see Socket::setBusyPoll(), logs a failure.
+  void setBusyPoll(int micros);
+  // Queues unsent data in a RingBuffer written with writev(2) instead of
+  // a Buffer, so streaming never moves the backlog to make room.
+  // Call in the loop thread before sending anything, e.g. in ConnectionCallback.
+  void setRingOutputBuffer(bool on);
 
   void setContext(const boost::any& context)
   { context_ = context; }
@@ -55,22 +97,35 @@ class TcpConnection : boost::noncopyable,
   boost::any* getMutableContext()
   { return &context_; }
 
-  void setConnectionCallback(const ConnectionCallback& cb)
-  { connectionCallback_ = cb; }
+  /// Not thread safe, for resuming parsing outside messageCallback_.
+  Buffer* inputBuffer()
+  { return &inputBuffer_; }
 
-  void setMessageCallback(const MessageCallback& cb)
-  { messageCallback_ = cb; }
+  /// User callbacks of a TcpServer or TcpClient,
+  /// shared by all its connections instead of copied into each one.
+  struct Callbacks
+  {
+    ConnectionCallback connection;
+    MessageCallback message;
+    WriteCompleteCallback writeComplete;
+  };
+  typedef boost::shared_ptr<const Callbacks> CallbacksPtr;
 
-  void setWriteCompleteCallback(const WriteCompleteCallback& cb)
-  { writeCompleteCallback_ = cb; }
+  /// Internal use only.
+  void setCallbacks(CallbacksPtr callbacks)
+  { callbacks_.swap(callbacks); }
 
   /// Internal use only.
-  void setCloseCallback(const CloseCallback& cb)
-  { closeCallback_ = cb; }
+  void setCloseCallback(CloseCallback cb)
+  { closeCallback_ = std::move(cb); }
+
+  /// Internal use only, the name becomes serverName#loop.fd.generation.
+  void setId(uint64_t id, const std::string* serverName)
+  { id_ = id; serverName_ = serverName; }
 
   // called when TcpServer accepts a new connection
   void connectEstablished();   // should be called only once
-  // called when TcpServer has removed me from its map
+  // called when TcpServer has removed me from its table
   void connectDestroyed();  // should be called only once
 
  private:
@@ -82,22 +137,50 @@ class TcpConnection : boost::noncopyable,
   void handleClose();
   void handleError();
   void sendInLoop(const std::string& message);
+  void sendInLoop(const void* message, size_t len);
+  void sendSharedInLoop(const boost::shared_ptr<const std::string>& message);
+  void sendFileInLoop(const FilePtr& file, off_t offset, size_t count);
+  bool writeFile();
   void shutdownInLoop();
+  void writeCompleteInLoop();
+  void releaseSelf();
+
+  friend void intrusive_ptr_add_ref(TcpConnection* conn);
+  friend void intrusive_ptr_release(TcpConnection* conn);
+  size_t outputBytes() const
+  { return ringOutput_ ? outputRing_.readableBytes() : outputBuffer_.readableBytes(); }
 
   EventLoop* loop_;
-  std::string name_;
+  // the reference passed to callbacks, from connectEstablished() until
+  // connectDestroyed() and the last TcpConnectionLocalPtr have gone
+  TcpConnectionPtr self_;
+  int localRefs_;
+  bool destroyed_;
+  mutable std::string name_;  // empty until name() if serverName_
+  const std::string* serverName_;
+  uint64_t id_;
   StateE state_;  // FIXME: use atomic variable
-  // we don't expose those classes to client.
-  boost::scoped_ptr<Socket> socket_;
-  boost::scoped_ptr<Channel> channel_;
+  // members instead of separate allocations,
+  // channel_ is destroyed before socket_ closes the fd
+  Socket socket_;
+  Channel channel_;
   InetAddress localAddr_;
   InetAddress peerAddr_;
-  ConnectionCallback connectionCallback_;
-  MessageCallback messageCallback_;
-  WriteCompleteCallback writeCompleteCallback_;
+  CallbacksPtr callbacks_;
   CloseCallback closeCallback_;
   Buffer inputBuffer_;
   Buffer outputBuffer_;
+  RingBuffer outputRing_;  // replaces outputBuffer_ if ringOutput_
+  bool ringOutput_;
+  // 待发送的文件区间，trailer保存排在该文件之后send()的数据，以保证发送顺序
+  struct PendingFile
+  {
+    FilePtr file;
+    off_t offset;
+    size_t remaining;
+    Buffer trailer;
+  };
+  std::list<PendingFile> pendingFiles_;  // unlike deque, empty costs no allocation
   boost::any context_;
 };
 
@@ -7,6 +7,7 @@
 #include "SocketsOps.h"
 
 #include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
 
 #include <stdio.h>
 
@@ -17,8 +18,9 @@ TcpServer::TcpServer(EventLoop* loop, const InetAddress& listenAddr)
     name_(listenAddr.toHostPort()),
     acceptor_(new Acceptor(loop, listenAddr)),
     threadPool_(new EventLoopThreadPool(loop)),
+    callbacks_(boost::make_shared<TcpConnection::Callbacks>()),
     started_(false),
-    nextConnId_(1)
+    nextTable_(0)
 {
   if(loop_ == NULL)
     LOG << "fatal error: TcpServer::TcpServer loop can't be NULL";
@@ -41,6 +43,13 @@ void TcpServer::start()
   if (!started_)
   {
     started_ = true;
+    threadPool_->start(threadInitCallback_);
+    std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+    assert(loops.size() <= static_cast<size_t>(ConnectionTable::kMaxLoops));
+    for (size_t i = 0; i < loops.size(); ++i)
+    {
+      tables_.push_back(new ConnectionTable(loops[i], static_cast<int>(i)));
+    }
   }
 
   if (!acceptor_->listenning())
@@ -51,53 +60,68 @@ void TcpServer::start()
 }
 
 /*
-*在新连接到达时，Acceptor会回调newConnection()，后者会创建TcpConnection对象conn，把它加入到ConnectionMap，设置好callback，
-*再调用conn->connectEstablished()，其中会回调用户提供的ConnectionCallback
+*在新连接到达时，Acceptor会回调newConnection()，它按round-robin选好IO线程后，由newConnectionInLoop()在该线程中
+*创建TcpConnection对象conn，放进该线程的ConnectionTable，设置好callback，再调用conn->connectEstablished()，
+*其中会回调用户提供的ConnectionCallback。
+*conn在它所属的IO线程中创建和销毁，所以能从该线程的BufferPool中分配、关闭后回收到同一个线程；
+*连接的登记和移除也都只在这个线程中进行，关闭连接不再需要经过acceptor所在的线程。
 */
 void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
 {
   loop_->assertInLoopThread();
-  char buf[32];
-  snprintf(buf, sizeof buf, "#%d", nextConnId_);
-  ++nextConnId_;
-  std::string connName = name_ + buf;
-
+  ConnectionTable* table = &tables_[nextTable_];
+  ++nextTable_;
+  if (nextTable_ >= tables_.size())
+  {
+    nextTable_ = 0;
+  }
   LOG << "TcpServer::newConnection [" << name_
-           << "] - new connection [" << connName
-           << "] from " << peerAddr.toHostPort();
-  InetAddress localAddr(sockets::getLocalAddr(sockfd));//sockfd是accept之后返回的连接fd
+           << "] - new connection fd=" << sockfd
+           << " from " << peerAddr.toHostPort();
   // FIXME poll with zero timeout to double confirm the new connection
-  EventLoop* ioLoop = threadPool_->getNextLoop();
+  table->getLoop()->runInLoop(
+      boost::bind(&TcpServer::newConnectionInLoop, this, table, sockfd, peerAddr));
+}
+
+void TcpServer::newConnectionInLoop(ConnectionTable* table,
+                                    int sockfd,
+                                    const InetAddress& peerAddr)
+{
+  EventLoop* ioLoop = table->getLoop();
+  ioLoop->assertInLoopThread();
+  InetAddress localAddr(sockets::getLocalAddr(sockfd));//sockfd是accept之后返回的连接fd
   TcpConnectionPtr conn(
-      new TcpConnection(ioLoop, connName, sockfd, localAddr, peerAddr));
-  connections_[connName] = conn;//每个TcpConnection对象有一个名字，这个名字是由其所属的TcpServer在创建TcpConnection对象时生成，名字是ConnectionMap的key。
-  conn->setConnectionCallback(connectionCallback_);
-  conn->setMessageCallback(messageCallback_);
-  conn->setWriteCompleteCallback(writeCompleteCallback_);
+      TcpConnection::create(ioLoop, std::string(), sockfd, localAddr, peerAddr));
+  conn->setId(table->add(sockfd, conn), &name_);//id由fd和slot的generation组成，名字在需要时才由它生成
+  conn->setCallbacks(callbacks_);
   conn->setCloseCallback(
       boost::bind(&TcpServer::removeConnection, this, _1));//TcpServer向TcpConnection注册CloseCallback，用于接收连接断开的消息
-  ioLoop->runInLoop(boost::bind(&TcpConnection::connectEstablished, conn));
+  conn->connectEstablished();
+}
+
+TcpConnectionPtr TcpServer::findConnection(uint64_t id) const
+{
+  size_t index = ConnectionTable::loopIndexOf(id);
+  if (index < tables_.size())
+  {
+    return tables_[index].get(id);
+  }
+  return TcpConnectionPtr();
 }
 
 /*
-*TcpServer::removeConnection把conn从ConnectionMap中移除。这时TcpConnection已经是命悬一线：
+*TcpServer::removeConnection把conn从它所在线程的ConnectionTable中移除。这时TcpConnection已经是命悬一线：
 *如果用户不持有TcpConnectionPtr的话，conn的引用计数已降到1。注意这里一定要用EventLoop::queueInLoop()，否则会出现生命管理问题。
-*另外注意这里用boost::bind让TcpConnection的生命期延长到connectDestoryed()的时刻
+*另外注意这里用boost::bind让TcpConnection的生命期延长到connectDestoryed()的时刻，
+*绑定的是TcpConnectionLocalPtr，它推迟self_的释放，与绑定TcpConnectionPtr效果相同而不需要原子操作
 */
 void TcpServer::removeConnection(const TcpConnectionPtr& conn)
 {
-  // FIXME: unsafe
-  loop_->runInLoop(boost::bind(&TcpServer::removeConnectionInLoop, this, conn));
-}
-
-void TcpServer::removeConnectionInLoop(const TcpConnectionPtr& conn)
-{
-  loop_->assertInLoopThread();
-  LOG << "info: TcpServer::removeConnectionInLoop [" << name_
-           << "] - connection " << conn->name();
-  size_t n = connections_.erase(conn->name());
-  assert(n == 1); (void)n;
   EventLoop* ioLoop = conn->getLoop();
+  ioLoop->assertInLoopThread();
+  LOG << "info: TcpServer::removeConnection [" << name_
+           << "] - connection id=" << conn->id();
+  tables_[ConnectionTable::loopIndexOf(conn->id())].remove(conn->id());
   ioLoop->queueInLoop(
-      boost::bind(&TcpConnection::connectDestroyed, conn));
-}
\ No newline at end of file
+      boost::bind(&TcpConnection::connectDestroyed, conn->localPtr()));
+}
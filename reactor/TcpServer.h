@@ -1,10 +1,12 @@
 #pragma once
 
 #include "Callbacks.h"
+#include "ConnectionTable.h"
+#include "EventLoopThread.h"
 #include "TcpConnection.h"
 
-#include <map>
 #include <boost/noncopyable.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
 #include <boost/scoped_ptr.hpp>
 
 class Acceptor;
@@ -16,7 +18,7 @@ class EventLoopThreadPool;
 *TcpServer的接口如下，用户只需要设置好callback，再调用start()即可
 *
 *TcpServer内部使用Acceptor来获得新连接的fd。它保存用户提供的ConnectionCallback和MessageCallback，
-*在新建TcpConnection的时候会原样传给后者。
+*所有TcpConnection共享同一份TcpConnection::Callbacks，新建连接时只增加一次引用计数，不再逐个拷贝。
 */
 class TcpServer : boost::noncopyable
 {
@@ -40,6 +42,12 @@ class TcpServer : boost::noncopyable
   ///   are assigned on a round-robin basis.
   void setThreadNum(int numThreads);
 
+  /// Runs cb in each IO loop's thread before it starts looping,
+  /// for per-loop setup such as timers.
+  /// Must be called before @c start
+  void setThreadInitCallback(const EventLoopThread::ThreadInitCallback& cb)
+  { threadInitCallback_ = cb; }
+
   /// Starts the server if it's not listenning.
   ///
   /// It's harmless to call it multiple times.
@@ -47,39 +55,42 @@ class TcpServer : boost::noncopyable
   void start();
 
   /// Set connection callback.
-  /// Not thread safe.
-  void setConnectionCallback(const ConnectionCallback& cb)
-  { connectionCallback_ = cb; }
+  /// Must be called before @c start
+  void setConnectionCallback(ConnectionCallback cb)
+  { callbacks_->connection = std::move(cb); }
 
   /// Set message callback.
-  /// Not thread safe.
-  void setMessageCallback(const MessageCallback& cb)
-  { messageCallback_ = cb; }
+  /// Must be called before @c start
+  void setMessageCallback(MessageCallback cb)
+  { callbacks_->message = std::move(cb); }
 
   /// Set write complete callback.
-  /// Not thread safe.
-  void setWriteCompleteCallback(const WriteCompleteCallback& cb)
-  { writeCompleteCallback_ = cb; }
+  /// Must be called before @c start
+  void setWriteCompleteCallback(WriteCompleteCallback cb)
+  { callbacks_->writeComplete = std::move(cb); }
+
+  /// Finds the connection with TcpConnection::id(),
+  /// empty if it has closed. Call in that connection's loop.
+  TcpConnectionPtr findConnection(uint64_t id) const;
 
  private:
   /// Not thread safe, but in loop
   void newConnection(int sockfd, const InetAddress& peerAddr);
-  /// Thread safe.
+  /// Not thread safe, but in table's loop
+  void newConnectionInLoop(ConnectionTable* table,
+                           int sockfd,
+                           const InetAddress& peerAddr);
+  /// Not thread safe, but in conn's loop
   void removeConnection(const TcpConnectionPtr& conn);
-  /// Not thread safe, but in loop
-  void removeConnectionInLoop(const TcpConnectionPtr& conn);
-
-  typedef std::map<std::string, TcpConnectionPtr> ConnectionMap;
 
   EventLoop* loop_;  // the acceptor loop
   const std::string name_;
   boost::scoped_ptr<Acceptor> acceptor_; // avoid revealing Acceptor
+  // one per IO loop, declared before threadPool_ so they outlive its threads
+  boost::ptr_vector<ConnectionTable> tables_;
   boost::scoped_ptr<EventLoopThreadPool> threadPool_;
-  ConnectionCallback connectionCallback_;
-  MessageCallback messageCallback_;
-  WriteCompleteCallback writeCompleteCallback_;
+  boost::shared_ptr<TcpConnection::Callbacks> callbacks_;
+  EventLoopThread::ThreadInitCallback threadInitCallback_;
   bool started_;
-  int nextConnId_;  // always in loop thread
-  ConnectionMap connections_;
+  size_t nextTable_;  // always in loop thread
 };
-
@@ -9,8 +9,8 @@
 class Timer : boost::noncopyable
 {
  public:
-  Timer(const TimerCallback& cb, Timestamp when, double interval)
-    : callback_(cb),
+  Timer(TimerCallback cb, Timestamp when, double interval)
+    : callback_(std::move(cb)),
       expiration_(when),
       interval_(interval),
       repeat_(interval > 0.0),
@@ -22,6 +22,7 @@ class Timer : boost::noncopyable
     callback_();
   }
 
+  const TimerCallback& callback() const { return callback_; }
   Timestamp expiration() const  { return expiration_; }
   bool repeat() const { return repeat_; }
   int64_t sequence() const { return sequence_; }
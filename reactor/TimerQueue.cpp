@@ -5,6 +5,7 @@
 #include "EventLoop.h"
 #include "Timer.h"
 #include "TimerId.h"
+#include "Trace.h"
 
 #include <boost/bind.hpp>
 #include <boost/foreach.hpp>
@@ -96,14 +97,16 @@ TimerQueue::~TimerQueue()
 *实际工作转移到IO线程，addTimerInLoop完成修改定时器列表地工作
 *这样无论在哪个线程调用addTimer都是安全的
 */
-TimerId TimerQueue::addTimer(const TimerCallback& cb,
+TimerId TimerQueue::addTimer(TimerCallback cb,
                              Timestamp when,
                              double interval)
 {
-  Timer* timer = new Timer(cb, when, interval);
+  Timer* timer = new Timer(std::move(cb), when, interval);
+  // a one-shot timer may fire and be deleted in the loop thread before runInLoop() returns
+  int64_t sequence = timer->sequence();
   loop_->runInLoop(
       boost::bind(&TimerQueue::addTimerInLoop, this, timer));
-  return TimerId(timer);
+  return TimerId(timer, sequence);
 }
 
 void TimerQueue::addTimerInLoop(Timer* timer)
@@ -115,6 +118,7 @@ void TimerQueue::addTimerInLoop(Timer* timer)
   {
     resetTimerfd(timerfd_, timer->expiration());
   }
+  loop_->metrics()->set(LoopMetrics::kTimers, static_cast<int64_t>(timers_.size()));
 }
 
 void TimerQueue::cancel(TimerId timerId)
@@ -135,6 +139,7 @@ void TimerQueue::cancelInLoop(TimerId timerId)
     assert(n == 1); (void)n;
     delete it->first; // FIXME: no delete please
     activeTimers_.erase(it);
+    loop_->metrics()->set(LoopMetrics::kTimers, static_cast<int64_t>(timers_.size()));
   }
   else if (callingExpiredTimers_)
   {
@@ -154,14 +159,32 @@ void TimerQueue::handleRead()
   callingExpiredTimers_ = true;
   cancelingTimers_.clear();
   // safe to callback outside critical section
+  const int64_t slowMicros = EventLoop::slowCallbackMicros();
+  Timestamp last(now);
   for (std::vector<Entry>::iterator it = expired.begin();
       it != expired.end(); ++it)
   {
+    trace::record(trace::kTimerBegin, static_cast<uint32_t>(it->second->sequence()));
     it->second->run();//调用过期Timer的回调函数
+    trace::record(trace::kTimerEnd, static_cast<uint32_t>(it->second->sequence()));
+    if (slowMicros > 0)
+    {
+      Timestamp end(Timestamp::now());
+      int64_t elapsed = end.microSecondsSinceEpoch() - last.microSecondsSinceEpoch();
+      if (elapsed > slowMicros)
+      {
+        LOG << "warn: TimerQueue::handleRead() slow timer " << it->second->sequence()
+            << " " << EventLoop::callbackName(it->second->callback().target_type())
+            << " took " << elapsed << " us";
+      }
+      last = end;
+    }
   }
   callingExpiredTimers_ = false;
 
   reset(expired, now);//重置Timer
+  loop_->metrics()->add(LoopMetrics::kTimersFired, static_cast<int64_t>(expired.size()));
+  loop_->metrics()->set(LoopMetrics::kTimers, static_cast<int64_t>(timers_.size()));
 }
 
 //这个函数会从timers_中移除已到期的Timer，并通过vector返回它们
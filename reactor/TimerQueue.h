@@ -25,7 +25,7 @@ class TimerQueue : boost::noncopyable
   /// repeats if interval > 0.0.
   ///
   /// Must be thread safe. Usually be called from other threads.
-  TimerId addTimer(const TimerCallback& cb,
+  TimerId addTimer(TimerCallback cb,
                    Timestamp when,
                    double interval);
 
@@ -0,0 +1,154 @@
+#include "Trace.h"
+
+#include "../base/CurrentThread.h"
+#include "../base/MutexLock.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+namespace trace
+{
+
+const char kMagic[8] = { 'W', 'S', 'T', 'R', 'A', 'C', 'E', '1' };
+
+namespace detail
+{
+bool g_enabled = false;
+__thread Ring* t_ring = NULL;
+}
+
+namespace
+{
+
+int64_t monotonicNanos()
+{
+  struct timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// rings are never freed, a dump still shows threads that have exited
+struct Registry
+{
+  Registry()
+    : baseTicks(0),
+      baseNanos(0)
+  {
+  }
+
+  MutexLock mutex;
+  std::vector<detail::Ring*> rings;
+  uint64_t baseTicks;  // both taken on the first setEnabled(true)
+  int64_t baseNanos;
+};
+
+Registry& registry()
+{
+  static Registry* registry = new Registry;
+  return *registry;
+}
+
+}  // namespace
+
+detail::Ring* detail::newRing()
+{
+  Ring* ring = new Ring;
+  ring->head = 0;
+  ring->tid = CurrentThread::tid();
+  memset(ring->threadName, 0, sizeof ring->threadName);
+  if (CurrentThread::name())
+  {
+    strncpy(ring->threadName, CurrentThread::name(), sizeof ring->threadName - 1);
+  }
+  t_ring = ring;
+
+  Registry& r = registry();
+  MutexLockGuard lock(r.mutex);
+  r.rings.push_back(ring);
+  return ring;
+}
+
+void setEnabled(bool on)
+{
+  Registry& r = registry();
+  {
+    MutexLockGuard lock(r.mutex);
+    if (on && r.baseNanos == 0)
+    {
+      r.baseTicks = detail::ticks();
+      r.baseNanos = monotonicNanos();
+    }
+  }
+  __atomic_store_n(&detail::g_enabled, on, __ATOMIC_RELAXED);
+}
+
+/*
+*TSC与CLOCK_MONOTONIC各取两次读数换算频率：第一次在首次启用时，第二次在dump时，
+*两次相隔不足10ms就等到10ms，保证换算误差在千分之一以内。
+*只在复制ring列表时持有registry的锁，等待和写文件时新线程仍可登记自己的ring。
+*/
+bool dump(const char* path)
+{
+  Registry& r = registry();
+  std::vector<detail::Ring*> rings;
+  uint64_t baseTicks = 0;
+  int64_t baseNanos = 0;
+  {
+    MutexLockGuard lock(r.mutex);
+    rings = r.rings;
+    baseTicks = r.baseTicks;
+    baseNanos = r.baseNanos;
+  }
+
+  FileHeader header;
+  memcpy(header.magic, kMagic, sizeof header.magic);
+  header.numThreads = static_cast<uint32_t>(rings.size());
+  header.reserved = 0;
+  header.baseTicks = baseTicks;
+  header.ticksPerMicro = 1000.0;
+  if (baseNanos != 0)
+  {
+    int64_t remaining;
+    while ((remaining = 10 * 1000 * 1000 - (monotonicNanos() - baseNanos)) > 0)
+    {
+      struct timespec ts = { 0, static_cast<long>(remaining) };
+      ::nanosleep(&ts, NULL);
+    }
+    uint64_t ticks = detail::ticks();
+    int64_t nanos = monotonicNanos();
+    header.ticksPerMicro = static_cast<double>(ticks - baseTicks)
+                           / static_cast<double>(nanos - baseNanos) * 1000.0;
+  }
+
+  FILE* fp = ::fopen(path, "wb");
+  if (fp == NULL)
+  {
+    return false;
+  }
+  bool ok = ::fwrite(&header, sizeof header, 1, fp) == 1;
+  std::vector<Event> events;
+  for (size_t i = 0; ok && i < rings.size(); ++i)
+  {
+    const detail::Ring* ring = rings[i];
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint64_t first = head > kRingSize ? head - kRingSize : 0;
+    events.clear();
+    for (uint64_t j = first; j < head; ++j)
+    {
+      events.push_back(ring->events[j & (kRingSize - 1)]);
+    }
+
+    ThreadHeader thread;
+    thread.tid = ring->tid;
+    thread.numEvents = static_cast<uint32_t>(events.size());
+    memcpy(thread.threadName, ring->threadName, sizeof thread.threadName);
+    ok = ::fwrite(&thread, sizeof thread, 1, fp) == 1
+         && (events.empty()
+             || ::fwrite(&events[0], sizeof events[0], events.size(), fp) == events.size());
+  }
+  return ::fclose(fp) == 0 && ok;
+}
+
+}  // namespace trace
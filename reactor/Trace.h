@@ -0,0 +1,125 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+///
+/// Binary event tracing of the reactor, off until enabled at runtime.
+///
+/// Each thread appends 16-byte events stamped with the TSC to a ring of its
+/// own, allocated on its first event, so recording takes no lock and no
+/// atomic read-modify-write: a few ns when enabled, one well predicted branch
+/// when not. dump() writes the rings of all threads, oldest events first,
+/// for bench/TraceToJson to convert to Chrome trace JSON (about:tracing,
+/// Perfetto).
+///
+namespace trace
+{
+
+  enum Type
+  {
+    kPollBegin,       // arg: timeout in ms
+    kPollEnd,         // arg: ready channels
+    kEventBegin,      // arg: fd, Channel::handleEvent()
+    kEventEnd,        // arg: fd
+    kFunctorBegin,    // arg: index in the batch of doPendingFunctors()
+    kFunctorEnd,
+    kTimerBegin,      // arg: timer sequence, low 32 bits
+    kTimerEnd,
+    kSend,            // arg: bytes written directly by send()
+    kFlush,           // arg: bytes written later from the output queue, or by sendfile()
+    kConnectionOpen,  // arg: fd
+    kConnectionClose, // arg: fd
+    kNumTypes
+  };
+
+  struct Event
+  {
+    uint64_t tsc;
+    uint32_t arg;
+    uint32_t type;
+  };
+
+  /// Events kept per thread, older ones are overwritten.
+  const size_t kRingSize = 1 << 16;
+
+  namespace detail
+  {
+    extern bool g_enabled;  // atomic
+
+    struct Ring
+    {
+      uint64_t head;  // atomic, events ever written
+      int tid;
+      char threadName[32];
+      Event events[kRingSize];
+    };
+
+    extern __thread Ring* t_ring;
+    Ring* newRing();
+
+    inline uint64_t ticks()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+      return __builtin_ia32_rdtsc();
+#else
+      struct timespec ts;
+      ::clock_gettime(CLOCK_MONOTONIC, &ts);
+      return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#endif
+    }
+  }
+
+  inline bool enabled()
+  {
+    return __atomic_load_n(&detail::g_enabled, __ATOMIC_RELAXED);
+  }
+
+  inline void record(Type type, uint32_t arg = 0)
+  {
+    if (__builtin_expect(enabled(), 0))
+    {
+      detail::Ring* ring = detail::t_ring ? detail::t_ring : detail::newRing();
+      uint64_t head = ring->head;
+      Event& e = ring->events[head & (kRingSize - 1)];
+      e.tsc = detail::ticks();
+      e.arg = arg;
+      e.type = type;
+      // publishes the event to dump() in another thread
+      __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    }
+  }
+
+  /// Starts or stops recording in all threads. Thread safe.
+  void setEnabled(bool on);
+
+  ///
+  /// Writes the rings of every thread that recorded an event to path.
+  /// Events being written meanwhile may come out torn, disable first for
+  /// an exact snapshot. Thread safe.
+  /// @return false if path cannot be written.
+  bool dump(const char* path);
+
+  ///
+  /// The file dump() writes: a FileHeader, then for each thread a
+  /// ThreadHeader followed by numEvents Events, all in host byte order.
+  struct FileHeader
+  {
+    char magic[8];          // kMagic
+    uint32_t numThreads;
+    uint32_t reserved;
+    uint64_t baseTicks;     // when tracing was enabled
+    double ticksPerMicro;
+  };
+
+  struct ThreadHeader
+  {
+    int32_t tid;
+    uint32_t numEvents;
+    char threadName[32];
+  };
+
+  extern const char kMagic[8];
+
+}
@@ -2,8 +2,12 @@
 #include "../../base/CountDownLatch.h"
 #include "../../base/CurrentThread.h"
 #include "../../base/Logging.h"
+#include "../../base/Timestamp.h"
 
+#include <memory>
+#include <vector>
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>  // usleep
 
 void print()
@@ -73,12 +77,142 @@ void test2()
   LOG << "test2 Done";
 }
 
-int main()
+void logString(const std::string& str)
 {
+  LOG << str;
+}
+
+// kHigh tasks overtake kLow ones, except for one in every kLowShare
+void test3()
+{
+  LOG << "Test ThreadPool priorities and deadlines.";
+  ThreadPool pool("PriorityPool");
+  pool.start(1);
+
+  CountDownLatch gate(1);
+  pool.run(std::bind(&CountDownLatch::wait, &gate));  // holds the only worker
+  usleep(100*1000);
+  for (int i = 0; i < 4; ++i)
+  {
+    char buf[32];
+    snprintf(buf, sizeof buf, "low %d", i);
+    pool.run(std::bind(logString, std::string(buf)), ThreadPool::kLow);
+  }
+  for (int i = 0; i < 20; ++i)
+  {
+    char buf[32];
+    snprintf(buf, sizeof buf, "high %d", i);
+    pool.run(std::bind(logString, std::string(buf)));
+  }
+  pool.run(std::bind(logString, std::string("expired")),
+           ThreadPool::kHigh, addTime(Timestamp::now(), 0.05));
+  usleep(100*1000);
+  gate.countDown();
+
+  CountDownLatch latch(1);
+  pool.run(std::bind(&CountDownLatch::countDown, &latch), ThreadPool::kLow);
+  latch.wait();
+  LOG << "test3 Done, expired " << pool.numExpired();
+  pool.stop();
+}
+
+int g_done = 0;
+int g_total = 0;
+CountDownLatch* g_allDone = NULL;
+
+void count()
+{
+  if (__atomic_add_fetch(&g_done, 1, __ATOMIC_ACQ_REL) == g_total)
+  {
+    g_allDone->countDown();
+  }
+}
+
+// every task queues two more until depth 0, from inside the pool
+void spawn(ThreadPool* pool, int depth)
+{
+  if (depth > 0)
+  {
+    pool->run(std::bind(spawn, pool, depth - 1));
+    pool->run(std::bind(spawn, pool, depth - 1));
+  }
+  count();
+}
+
+// runs tasks times in the pool, returns tasks per second
+double measure(int numThreads, const std::function<void (ThreadPool*)>& submit, int tasks)
+{
+  ThreadPool pool("BenchPool");
+  pool.start(numThreads);
+  CountDownLatch allDone(1);
+  g_done = 0;
+  g_total = tasks;
+  g_allDone = &allDone;
+  Timestamp start(Timestamp::now());
+  submit(&pool);
+  allDone.wait();
+  double seconds = timeDifference(Timestamp::now(), start);
+  pool.stop();
+  return tasks / seconds;
+}
+
+void produce(ThreadPool* pool, int producers, int tasks)
+{
+  std::vector<std::unique_ptr<Thread>> threads;
+  for (int i = 0; i < producers; ++i)
+  {
+    threads.emplace_back(new Thread([pool, producers, tasks]()
+    {
+      for (int j = 0; j < tasks / producers; ++j)
+      {
+        pool->run(count);
+      }
+    }, "producer"));
+  }
+  for (auto& thr : threads)
+  {
+    thr->start();
+  }
+  for (auto& thr : threads)
+  {
+    thr->join();
+  }
+}
+
+/*
+ * 吞吐量测试：1到64个生产者线程各自提交空任务，以及任务在池内递归产生子任务
+ * (只经过工作线程自己的队列和窃取)，输出每秒执行的任务数。
+ */
+void bench(int numThreads)
+{
+  const int kTasks = 1 << 20;
+  printf("ThreadPool with %d threads, %d empty tasks\n", numThreads, kTasks);
+  for (int producers = 1; producers <= 64; producers *= 2)
+  {
+    double rate = measure(numThreads,
+        std::bind(produce, std::placeholders::_1, producers, kTasks), kTasks);
+    printf("%2d producers  %10.0f tasks/s\n", producers, rate);
+  }
+  const int kDepth = 19;
+  double rate = measure(numThreads,
+      [kDepth](ThreadPool* pool) { pool->run(std::bind(spawn, pool, kDepth)); },
+      (1 << (kDepth + 1)) - 1);
+  printf("spawned       %10.0f tasks/s\n", rate);
+}
+
+// usage: ThreadPool_test [benchmark_threads]
+int main(int argc, char* argv[])
+{
+  if (argc > 1)
+  {
+    bench(atoi(argv[1]));
+    return 0;
+  }
   test(0);
   test(1);
   test(5);
   test(10);
   test(50);
   test2();
+  test3();
 }
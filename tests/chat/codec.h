@@ -2,9 +2,9 @@
 
 #include "../../base/Logging.h"
 #include "../../reactor/Buffer.h"
-#include "../../reactor/SocketsOps.h"
 #include "../../reactor/TcpConnection.h"
 #include <boost/bind.hpp>
+#include <boost/function.hpp>
 
 class LengthHeaderCodec : noncopyable
 {
@@ -24,10 +24,7 @@ class LengthHeaderCodec : noncopyable
   {
     while (buf->readableBytes() >= kHeaderLen) // kHeaderLen == 4
     {
-      // FIXME: use Buffer::peekInt32()
-      const void* data = buf->peek();
-      int32_t be32 = *static_cast<const int32_t*>(data); // SIGBUS
-      const int32_t len = sockets::networkToHost32(be32);
+      const int32_t len = buf->peekInt32();
       if (len > 65536 || len < 0)
       {
         LOG << "error: Invalid length " << len;
@@ -55,8 +52,7 @@ class LengthHeaderCodec : noncopyable
     Buffer buf;
     buf.append(message);
     int32_t len = static_cast<int32_t>(message.size());
-    int32_t be32 = sockets::hostToNetwork32(len);
-    buf.prepend(&be32, sizeof be32);
+    buf.prependInt32(len);
     conn->send(&buf);
   }
 
@@ -0,0 +1,157 @@
+#include "../../http/HttpServer.h"
+#include "../../http/HttpRequest.h"
+#include "../../http/HttpResponse.h"
+#include "../../base/Atomic.h"
+#include "../../base/Thread.h"
+#include "../../base/Timestamp.h"
+#include "../../reactor/EventLoop.h"
+
+#include <boost/bind.hpp>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// 统计keep-alive连接上每个HTTP请求在整个进程中引起的malloc调用次数：
+// 在可执行文件中替换malloc族函数计数，客户端只用栈上的缓冲区和系统调用，自身不分配内存
+//
+// usage: HttpAlloc_bench [numRequests]
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t n, size_t size);
+extern "C" void* __libc_realloc(void* p, size_t size);
+extern "C" void __libc_free(void* p);
+
+AtomicInt64 g_mallocs;
+
+extern "C" void* malloc(size_t size)
+{
+  g_mallocs.increment();
+  return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t n, size_t size)
+{
+  g_mallocs.increment();
+  return __libc_calloc(n, size);
+}
+
+extern "C" void* realloc(void* p, size_t size)
+{
+  g_mallocs.increment();
+  return __libc_realloc(p, size);
+}
+
+extern "C" void free(void* p)
+{
+  __libc_free(p);
+}
+
+const uint16_t kPort = 2011;
+
+// a browser-like request, several values are too long for std::string's inline buffer
+const char kRequest[] =
+  "GET /api/items/12345?fields=name,price HTTP/1.1\r\n"
+  "Host: localhost:2011\r\n"
+  "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:120.0) Gecko/20100101 Firefox/120.0\r\n"
+  "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+  "Accept-Language: en-US,en;q=0.5\r\n"
+  "Accept-Encoding: gzip, deflate\r\n"
+  "Connection: keep-alive\r\n"
+  "Cookie: session=0123456789abcdef0123456789abcdef\r\n"
+  "Cache-Control: max-age=0\r\n"
+  "\r\n";
+
+void onItem(const HttpRequest& req, const HttpRouter::Params& params, HttpResponse* resp)
+{
+  resp->setStatusCode(HttpResponse::k200Ok);
+  resp->setContentType("application/json; charset=utf-8");
+  resp->addHeader("Cache-Control", "private, max-age=60");
+  resp->setBody("{\"id\":1}");
+}
+
+// sends one request and reads its response, false on error
+bool roundTrip(int fd)
+{
+  if (::write(fd, kRequest, sizeof kRequest - 1) != static_cast<ssize_t>(sizeof kRequest - 1))
+  {
+    return false;
+  }
+  char buf[4096];
+  size_t received = 0;
+  while (true)
+  {
+    ssize_t n = ::read(fd, buf + received, sizeof buf - received);
+    if (n <= 0)
+    {
+      return false;
+    }
+    received += n;
+    const char* end = static_cast<const char*>(memmem(buf, received, "\r\n\r\n", 4));
+    if (end)
+    {
+      const char* cl = static_cast<const char*>(memmem(buf, end - buf, "Content-Length: ", 16));
+      size_t bodyLen = cl ? atoi(cl + 16) : 0;
+      if (received >= static_cast<size_t>(end + 4 - buf) + bodyLen)
+      {
+        return true;
+      }
+    }
+  }
+}
+
+void runClient(EventLoop* loop, int numRequests)
+{
+  ::sleep(1);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(kPort);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr) < 0)
+  {
+    perror("connect");
+    loop->quit();
+    return;
+  }
+  // warm up the thread caches of BufferPool and the log buffers
+  for (int i = 0; i < 1000; ++i)
+  {
+    roundTrip(fd);
+  }
+
+  int64_t before = g_mallocs.get();
+  Timestamp start(Timestamp::now());
+  int done = 0;
+  while (done < numRequests && roundTrip(fd))
+  {
+    ++done;
+  }
+  double seconds = timeDifference(Timestamp::now(), start);
+  int64_t mallocs = g_mallocs.get() - before;
+  ::close(fd);
+
+  printf("%d keep-alive requests in %.3f s, %.0f req/s, %.3f malloc calls per request\n",
+         done, seconds, done / seconds, static_cast<double>(mallocs) / done);
+  loop->quit();
+}
+
+int main(int argc, char* argv[])
+{
+  int numRequests = argc > 1 ? atoi(argv[1]) : 100000;
+  EventLoop loop;
+  HttpServer server(&loop, InetAddress(kPort));
+  server.route(HttpRequest::kGet, "/api/items/:id", onItem);
+  server.start();
+
+  Thread client(boost::bind(runClient, &loop, numRequests), "client");
+  client.start();
+  loop.loop();
+  client.join();
+}
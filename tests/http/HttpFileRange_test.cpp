@@ -0,0 +1,199 @@
+#include "../../http/HttpFileRange.h"
+#include "../../http/HttpRequest.h"
+#include "../../http/HttpResponse.h"
+#include "../../base/FileUtil.h"
+#include "../../reactor/Buffer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+
+using namespace std;
+
+// filerange::handle()对条件GET、Range和HEAD的处理。不用assert：CHECK记录失败的检查并继续，
+// 最后有失败时exit(1)
+
+int g_failures = 0;
+
+void check(bool ok, const char* what, int line)
+{
+  if (!ok)
+  {
+    fprintf(stderr, "HttpFileRange_test.cpp:%d: %s failed\n", line, what);
+    ++g_failures;
+  }
+}
+
+#define CHECK(exp) check((exp), #exp, __LINE__)
+
+const off_t kFileSize = 1000;
+FilePtr g_file;
+
+void request(const char* method, const char* headers[], HttpResponse* resp)
+{
+  HttpRequest req;
+  if (!req.setMethod(method, method + strlen(method)))
+  {
+    abort();
+  }
+  for (int i = 0; headers != NULL && headers[i] != NULL; i += 2)
+  {
+    req.addHeader(headers[i], headers[i+1]);
+  }
+  resp->setStatusCode(HttpResponse::k200Ok);
+  resp->setContentType("text/plain");
+  resp->setBodyFile(g_file, 0, kFileSize);
+  filerange::handle(req, resp);
+}
+
+// bytes the response puts on the wire, the file ranges as their length
+size_t wireBytes(const HttpResponse& resp, bool withBody, string* head)
+{
+  Buffer buf;
+  resp.appendToBuffer(&buf, withBody);
+  *head = buf.retrieveAllAsString();
+  size_t n = head->size();
+  if (withBody && resp.bodyFile())
+  {
+    for (size_t i = 0; i < resp.bodyFileRanges().size(); ++i)
+    {
+      n += resp.bodyFileRanges()[i].prefix.size() + resp.bodyFileRanges()[i].length;
+    }
+    n += resp.bodyFileTrailer().size();
+  }
+  return n;
+}
+
+bool hasHeader(const string& head, const string& line)
+{
+  return head.find("\r\n" + line + "\r\n") != string::npos;
+}
+
+void testParseRange()
+{
+  std::vector<filerange::ByteRange> ranges;
+  CHECK(filerange::parseRange("bytes=0-99", kFileSize, &ranges) == filerange::kSatisfiable);
+  CHECK(ranges.size() == 1 && ranges[0].first == 0 && ranges[0].second == 99);
+  CHECK(filerange::parseRange("bytes=-100", kFileSize, &ranges) == filerange::kSatisfiable);
+  CHECK(ranges.size() == 1 && ranges[0].first == 900 && ranges[0].second == 999);
+  CHECK(filerange::parseRange("bytes=990-", kFileSize, &ranges) == filerange::kSatisfiable);
+  CHECK(ranges.size() == 1 && ranges[0].first == 990 && ranges[0].second == 999);
+  CHECK(filerange::parseRange("bytes=0-0,10-19", kFileSize, &ranges) == filerange::kSatisfiable);
+  CHECK(ranges.size() == 2);
+  CHECK(filerange::parseRange("bytes=2000-", kFileSize, &ranges) == filerange::kUnsatisfiable);
+  CHECK(filerange::parseRange("items=0-1", kFileSize, &ranges) == filerange::kNoRange);
+  CHECK(filerange::parseRange("bytes=x-y", kFileSize, &ranges) == filerange::kNoRange);
+}
+
+void testGet()
+{
+  string head;
+  {
+    HttpResponse resp(false);
+    request("GET", NULL, &resp);
+    CHECK(resp.statusCode() == HttpResponse::k200Ok);
+    CHECK(wireBytes(resp, true, &head) == head.size() + kFileSize);
+    CHECK(hasHeader(head, "Content-Length: 1000"));
+    CHECK(hasHeader(head, "Accept-Ranges: bytes"));
+  }
+  {
+    const char* headers[] = { "Range", "bytes=100-199", NULL };
+    HttpResponse resp(false);
+    request("GET", headers, &resp);
+    CHECK(resp.statusCode() == HttpResponse::k206PartialContent);
+    CHECK(wireBytes(resp, true, &head) == head.size() + 100);
+    CHECK(hasHeader(head, "Content-Length: 100"));
+    CHECK(hasHeader(head, "Content-Range: bytes 100-199/1000"));
+  }
+  {
+    const char* headers[] = { "Range", "bytes=0-9,20-29", NULL };
+    HttpResponse resp(false);
+    request("GET", headers, &resp);
+    CHECK(resp.statusCode() == HttpResponse::k206PartialContent);
+    CHECK(resp.bodyFileRanges().size() == 2);
+    CHECK(resp.header("Content-Type").starts_with("multipart/byteranges"));
+  }
+  {
+    const char* headers[] = { "Range", "bytes=5000-", NULL };
+    HttpResponse resp(false);
+    request("GET", headers, &resp);
+    CHECK(resp.statusCode() == HttpResponse::k416RangeNotSatisfiable);
+    CHECK(!resp.bodyFile());
+  }
+  {
+    HttpResponse first(false);
+    request("GET", NULL, &first);
+    string etag = first.header("ETag").as_string();
+    const char* headers[] = { "If-None-Match", etag.c_str(), NULL };
+    HttpResponse resp(false);
+    request("GET", headers, &resp);
+    CHECK(resp.statusCode() == HttpResponse::k304NotModified);
+    CHECK(!resp.bodyFile());
+  }
+}
+
+// HEAD: the headers a GET would get, Content-Length included, and not a byte of the file
+void testHead()
+{
+  string head;
+  {
+    HttpResponse resp(false);
+    request("HEAD", NULL, &resp);
+    CHECK(resp.statusCode() == HttpResponse::k200Ok);
+    CHECK(wireBytes(resp, false, &head) == head.size());
+    CHECK(head.size() >= 4 && head.compare(head.size() - 4, 4, "\r\n\r\n") == 0);
+    CHECK(hasHeader(head, "Content-Length: 1000"));
+    CHECK(hasHeader(head, "Accept-Ranges: bytes"));
+  }
+  {
+    // Range only applies to GET
+    const char* headers[] = { "Range", "bytes=0-9,20-29", NULL };
+    HttpResponse resp(false);
+    request("HEAD", headers, &resp);
+    CHECK(resp.statusCode() == HttpResponse::k200Ok);
+    CHECK(wireBytes(resp, false, &head) == head.size());
+    CHECK(hasHeader(head, "Content-Length: 1000"));
+    CHECK(head.find("Content-Range") == string::npos);
+  }
+  {
+    HttpResponse first(false);
+    request("HEAD", NULL, &first);
+    string etag = first.header("ETag").as_string();
+    const char* headers[] = { "If-None-Match", etag.c_str(), NULL };
+    HttpResponse resp(false);
+    request("HEAD", headers, &resp);
+    CHECK(resp.statusCode() == HttpResponse::k304NotModified);
+  }
+}
+
+int main()
+{
+  char path[] = "/tmp/HttpFileRange_testXXXXXX";
+  int fd = ::mkstemp(path);
+  if (fd < 0)
+  {
+    perror("mkstemp");
+    abort();
+  }
+  string content(kFileSize, 'x');
+  if (::write(fd, content.data(), content.size()) != kFileSize)
+  {
+    abort();
+  }
+  ::close(fd);
+  g_file.reset(new ReadOnlyFile(path));
+  ::unlink(path);
+
+  testParseRange();
+  testGet();
+  testHead();
+
+  if (g_failures > 0)
+  {
+    fprintf(stderr, "%d checks failed\n", g_failures);
+    exit(1);
+  }
+  printf("all passed\n");
+}
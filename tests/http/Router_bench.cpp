@@ -0,0 +1,121 @@
+#include "../../http/HttpRouter.h"
+#include "../../http/HttpResponse.h"
+#include "../../base/Timestamp.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// 比较HttpRouter与HttpServer_test原来的if链式路由在不同路由数量下的查找耗时
+
+int g_hits = 0;
+
+void onRoute(const HttpRequest&, const HttpRouter::Params&, HttpResponse*)
+{
+  ++g_hits;
+}
+
+void makeRoutes(int numRoutes, vector<string>* patterns, vector<string>* paths)
+{
+  char pattern[128];
+  char path[128];
+  for (int i = 0; i < numRoutes; ++i)
+  {
+    switch (i % 4)
+    {
+      case 0:
+        snprintf(pattern, sizeof pattern, "/api/v1/resource%d", i);
+        snprintf(path, sizeof path, "/api/v1/resource%d", i);
+        break;
+      case 1:
+        snprintf(pattern, sizeof pattern, "/api/v1/resource%d/:id", i);
+        snprintf(path, sizeof path, "/api/v1/resource%d/12345", i);
+        break;
+      case 2:
+        snprintf(pattern, sizeof pattern, "/users%d/:uid/posts/:pid", i);
+        snprintf(path, sizeof path, "/users%d/42/posts/7", i);
+        break;
+      default:
+        snprintf(pattern, sizeof pattern, "/static%d/*filepath", i);
+        snprintf(path, sizeof path, "/static%d/css/site.css", i);
+        break;
+    }
+    patterns->push_back(pattern);
+    paths->push_back(path);
+  }
+}
+
+void benchRouter(int numRoutes, int numLookups)
+{
+  vector<string> patterns;
+  vector<string> paths;
+  makeRoutes(numRoutes, &patterns, &paths);
+
+  HttpRouter router;
+  for (size_t i = 0; i < patterns.size(); ++i)
+  {
+    bool ok = router.addRoute(HttpRequest::kGet, patterns[i], onRoute);
+    assert(ok); (void)ok;
+  }
+
+  HttpRouter::Params params;
+  int matched = 0;
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < numLookups; ++i)
+  {
+    const string& path = paths[i % paths.size()];
+    if (router.match(HttpRequest::kGet, path, &params))
+    {
+      ++matched;
+    }
+  }
+  double seconds = timeDifference(Timestamp::now(), start);
+  assert(matched == numLookups);
+
+  printf("radix  routes=%5d nodes=%5zd %8.1f ns/lookup\n",
+         numRoutes, router.numNodes(), seconds * 1e9 / numLookups);
+}
+
+// 原来的写法：逐个比较，只对静态路由有意义
+void benchLinear(int numRoutes, int numLookups)
+{
+  vector<string> patterns;
+  vector<string> paths;
+  makeRoutes(numRoutes, &patterns, &paths);
+
+  int matched = 0;
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < numLookups; ++i)
+  {
+    const string& path = paths[(i % (paths.size() / 4 + 1)) * 4 % paths.size()];
+    for (size_t j = 0; j < patterns.size(); ++j)
+    {
+      if (path == patterns[j])
+      {
+        ++matched;
+        break;
+      }
+    }
+  }
+  double seconds = timeDifference(Timestamp::now(), start);
+
+  printf("linear routes=%5d matched=%d %8.1f ns/lookup\n",
+         numRoutes, matched, seconds * 1e9 / numLookups);
+}
+
+int main(int argc, char* argv[])
+{
+  int numLookups = argc > 1 ? atoi(argv[1]) : 1000 * 1000;
+  int sizes[] = { 10, 100, 1000 };
+  for (size_t i = 0; i < sizeof sizes / sizeof sizes[0]; ++i)
+  {
+    benchRouter(sizes[i], numLookups);
+  }
+  for (size_t i = 0; i < sizeof sizes / sizeof sizes[0]; ++i)
+  {
+    benchLinear(sizes[i], numLookups / 10);
+  }
+}
@@ -0,0 +1,143 @@
+#include "../../http/HttpRouter.h"
+#include "../../http/HttpResponse.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+using namespace std;
+
+// HttpRouter的匹配规则。不用assert：CHECK记录失败的检查并继续，最后有失败时exit(1)，
+// release(NDEBUG)构建下同样有效
+
+int g_failures = 0;
+
+void check(bool ok, const char* what, int line)
+{
+  if (!ok)
+  {
+    fprintf(stderr, "Router_test.cpp:%d: %s failed\n", line, what);
+    ++g_failures;
+  }
+}
+
+#define CHECK(exp) check((exp), #exp, __LINE__)
+
+const char* g_matched = NULL;
+
+void onRoute(const char* name, const HttpRequest&, const HttpRouter::Params&, HttpResponse*)
+{
+  g_matched = name;
+}
+
+void add(HttpRouter* router, HttpRequest::Method method, const char* pattern)
+{
+  using namespace std::placeholders;
+  if (!router->addRoute(method, pattern, std::bind(onRoute, pattern, _1, _2, _3)))
+  {
+    fprintf(stderr, "addRoute %s failed\n", pattern);
+    abort();
+  }
+}
+
+// the pattern of the route matched, NULL if none
+const char* match(const HttpRouter& router,
+                  HttpRequest::Method method,
+                  const char* path,
+                  HttpRouter::Params* params)
+{
+  const HttpRouter::RouteCallback* cb = router.match(method, path, params);
+  if (cb == NULL)
+  {
+    return NULL;
+  }
+  g_matched = NULL;
+  (*cb)(HttpRequest(), *params, NULL);
+  return g_matched;
+}
+
+bool same(const char* matched, const char* pattern)
+{
+  return matched != NULL && string(matched) == pattern;
+}
+
+int main()
+{
+  HttpRouter router;
+  add(&router, HttpRequest::kGet, "/users/new");
+  add(&router, HttpRequest::kGet, "/users/:id");
+  add(&router, HttpRequest::kGet, "/users/:id/posts/:pid");
+  add(&router, HttpRequest::kPost, "/users");
+  add(&router, HttpRequest::kGet, "/files/*path");
+  add(&router, HttpRequest::kGet, "/files/readme");
+  add(&router, HttpRequest::kGet, "/a/b/c");
+  add(&router, HttpRequest::kGet, "/a/:x/d");
+  add(&router, HttpRequest::kGet, "/a/*rest");
+  add(&router, HttpRequest::kGet, "/about");
+  add(&router, HttpRequest::kGet, "/docs/");
+  add(&router, HttpRequest::kHead, "/ping");
+  add(&router, HttpRequest::kGet, "/ping");
+
+  // conflicting parameter names and misplaced wildcards are rejected
+  CHECK(!router.addRoute(HttpRequest::kGet, "/users/:uid/x", NULL));
+  CHECK(!router.addRoute(HttpRequest::kGet, "/bad/*rest/x", NULL));
+  CHECK(!router.addRoute(HttpRequest::kGet, "relative", NULL));
+
+  HttpRouter::Params params;
+
+  // static beats param beats wildcard
+  CHECK(same(match(router, HttpRequest::kGet, "/users/new", &params), "/users/new"));
+  CHECK(params.size() == 0);
+  CHECK(same(match(router, HttpRequest::kGet, "/users/42", &params), "/users/:id"));
+  CHECK(same(match(router, HttpRequest::kGet, "/files/readme", &params), "/files/readme"));
+  CHECK(same(match(router, HttpRequest::kGet, "/files/readme.txt", &params), "/files/*path"));
+  CHECK(same(match(router, HttpRequest::kGet, "/a/b/c", &params), "/a/b/c"));
+
+  // backtracking: the static /a/b/ edge fails, then :x, then *rest
+  CHECK(same(match(router, HttpRequest::kGet, "/a/b/d", &params), "/a/:x/d"));
+  CHECK(params.size() == 1 && params.get("x") == "b");
+  CHECK(same(match(router, HttpRequest::kGet, "/a/b/e", &params), "/a/*rest"));
+  CHECK(params.size() == 1 && params.get("rest") == "b/e");
+  CHECK(params.get("x").empty());
+
+  // parameter capture
+  CHECK(same(match(router, HttpRequest::kGet, "/users/42/posts/7", &params), "/users/:id/posts/:pid"));
+  CHECK(params.size() == 2);
+  CHECK(params.name(0) == "id" && params.value(0) == "42");
+  CHECK(params.name(1) == "pid" && params.value(1) == "7");
+  CHECK(same(match(router, HttpRequest::kGet, "/files/css/site.css", &params), "/files/*path"));
+  CHECK(params.get("path") == "css/site.css");
+
+  // HEAD falls back to GET, unless it has its own route
+  CHECK(same(match(router, HttpRequest::kHead, "/users/42", &params), "/users/:id"));
+  CHECK(params.get("id") == "42");
+  CHECK(match(router, HttpRequest::kHead, "/users", &params) == NULL);
+  const HttpRouter::RouteCallback* cb = router.match(HttpRequest::kHead, "/ping", &params);
+  CHECK(cb != NULL && cb != router.match(HttpRequest::kGet, "/ping", &params));
+
+  // trailing slashes are significant
+  CHECK(same(match(router, HttpRequest::kGet, "/about", &params), "/about"));
+  CHECK(match(router, HttpRequest::kGet, "/about/", &params) == NULL);
+  CHECK(same(match(router, HttpRequest::kGet, "/docs/", &params), "/docs/"));
+  CHECK(match(router, HttpRequest::kGet, "/docs", &params) == NULL);
+  CHECK(match(router, HttpRequest::kGet, "/users/42/", &params) == NULL);
+  CHECK(match(router, HttpRequest::kGet, "/users/", &params) == NULL);
+
+  // 404: no route for the path; 405: routes for the path, none for the method.
+  // Both are left to the HttpCallback, the router only reports no match.
+  CHECK(match(router, HttpRequest::kGet, "/nowhere", &params) == NULL);
+  CHECK(match(router, HttpRequest::kGet, "/", &params) == NULL);
+  CHECK(match(router, HttpRequest::kGet, "", &params) == NULL);
+  CHECK(params.size() == 0);
+  CHECK(match(router, HttpRequest::kGet, "/users", &params) == NULL);
+  CHECK(same(match(router, HttpRequest::kPost, "/users", &params), "/users"));
+  CHECK(match(router, HttpRequest::kDelete, "/users/42", &params) == NULL);
+  CHECK(match(router, HttpRequest::kInvalid, "/users/42", &params) == NULL);
+
+  if (g_failures > 0)
+  {
+    fprintf(stderr, "%d checks failed\n", g_failures);
+    exit(1);
+  }
+  printf("all passed\n");
+}
@@ -0,0 +1,163 @@
+// Measures the resident memory each idle keep-alive connection costs the
+// server: N clients connect, exchange one small message, then sit idle.
+//
+// usage: MemoryPerConnection [numConnections] [messageBytes]
+
+#include "../../base/Atomic.h"
+#include "../../base/Thread.h"
+#include "../../reactor/EventLoop.h"
+#include "../../reactor/InetAddress.h"
+#include "../../reactor/TcpServer.h"
+
+#include <boost/bind.hpp>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+const uint16_t kPort = 2008;
+
+AtomicInt32 g_connected;
+
+void onConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    g_connected.increment();
+  }
+  else
+  {
+    g_connected.decrement();
+  }
+}
+
+void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  conn->send(buf);
+}
+
+long residentKB()
+{
+  long kb = 0;
+  FILE* fp = fopen("/proc/self/status", "r");
+  if (fp)
+  {
+    char line[256];
+    while (fgets(line, sizeof line, fp))
+    {
+      if (strncmp(line, "VmRSS:", 6) == 0)
+      {
+        kb = atol(line + 6);
+        break;
+      }
+    }
+    fclose(fp);
+  }
+  return kb;
+}
+
+void raiseFdLimit(int numConnections)
+{
+  struct rlimit rl;
+  if (getrlimit(RLIMIT_NOFILE, &rl) == 0)
+  {
+    rlim_t wanted = static_cast<rlim_t>(numConnections) * 2 + 64;
+    rl.rlim_cur = wanted < rl.rlim_max ? wanted : rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+  }
+}
+
+void runClients(EventLoop* loop, int numConnections, size_t messageBytes)
+{
+  sleep(1);
+  long before = residentKB();
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(kPort);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  std::string message(messageBytes, 'x');
+  std::vector<char> reply(messageBytes);
+  std::vector<int> fds;
+  for (int i = 0; i < numConnections; ++i)
+  {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr) < 0)
+    {
+      perror("connect");
+      if (fd >= 0)
+      {
+        ::close(fd);
+      }
+      break;
+    }
+    fds.push_back(fd);
+    // one round trip, so both buffers of the connection have been used
+    if (::write(fd, message.data(), message.size()) != static_cast<ssize_t>(message.size()))
+    {
+      perror("write");
+    }
+    size_t received = 0;
+    while (received < messageBytes)
+    {
+      ssize_t n = ::read(fd, &reply[received], messageBytes - received);
+      if (n <= 0)
+      {
+        break;
+      }
+      received += n;
+    }
+  }
+  while (g_connected.get() < static_cast<int>(fds.size()))
+  {
+    usleep(1000);
+  }
+  usleep(100 * 1000);
+  long after = residentKB();
+
+  printf("connections %zu, message %zu bytes\n", fds.size(), messageBytes);
+  printf("RSS before %ld kB, after %ld kB\n", before, after);
+  if (!fds.empty())
+  {
+    printf("%.1f bytes per idle connection\n",
+           static_cast<double>(after - before) * 1024 / fds.size());
+  }
+
+  for (size_t i = 0; i < fds.size(); ++i)
+  {
+    ::close(fds[i]);
+  }
+  while (g_connected.get() > 0)
+  {
+    usleep(1000);
+  }
+  loop->quit();
+}
+
+int main(int argc, char* argv[])
+{
+  int numConnections = argc > 1 ? atoi(argv[1]) : 10000;
+  size_t messageBytes = argc > 2 ? atoi(argv[2]) : 64;
+  raiseFdLimit(numConnections);
+
+  EventLoop loop;
+  TcpServer server(&loop, InetAddress(kPort));
+  server.setConnectionCallback(onConnection);
+  server.setMessageCallback(onMessage);
+  server.start();
+
+  Thread clients(boost::bind(runClients, &loop, numConnections, messageBytes), "clients");
+  clients.start();
+  loop.loop();
+  clients.join();
+}
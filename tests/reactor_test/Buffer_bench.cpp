@@ -0,0 +1,188 @@
+#include "../../base/Thread.h"
+#include "../../base/Timestamp.h"
+#include "../../reactor/Buffer.h"
+#include "../../reactor/RingBuffer.h"
+
+#include <boost/bind.hpp>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+// 比较Buffer(腾挪压缩)与RingBuffer在流式发送下的吞吐：
+// 生产者不断append，消费者每次只取走一部分(模拟部分写)，积压的数据一直存在
+
+const size_t kChunk = 16 * 1024;
+
+// a consumer taking a varying share of the backlog, like partial writes
+size_t consumeSize(size_t step, size_t readable)
+{
+  size_t want = 3 * 1024 + (step * 7919) % (12 * 1024);
+  return want < readable ? want : readable;
+}
+
+char g_sink[64 * 1024];
+
+double benchBuffer(size_t totalBytes, size_t backlog)
+{
+  std::string chunk(kChunk, 'x');
+  Buffer buf;
+  size_t produced = 0;
+  Timestamp start(Timestamp::now());
+  for (size_t step = 0; produced < totalBytes; ++step)
+  {
+    buf.append(chunk.data(), chunk.size());
+    produced += chunk.size();
+    while (buf.readableBytes() > backlog)
+    {
+      size_t n = consumeSize(step, buf.readableBytes());
+      memcpy(g_sink, buf.peek(), n);
+      buf.retrieve(n);
+    }
+  }
+  return timeDifference(Timestamp::now(), start);
+}
+
+double benchRing(size_t totalBytes, size_t backlog)
+{
+  std::string chunk(kChunk, 'x');
+  RingBuffer buf;
+  size_t produced = 0;
+  Timestamp start(Timestamp::now());
+  for (size_t step = 0; produced < totalBytes; ++step)
+  {
+    buf.append(chunk.data(), chunk.size());
+    produced += chunk.size();
+    while (buf.readableBytes() > backlog)
+    {
+      size_t n = consumeSize(step, buf.readableBytes());
+      struct iovec vec[2];
+      int count = buf.peek(vec);
+      size_t first = std::min(n, vec[0].iov_len);
+      memcpy(g_sink, vec[0].iov_base, first);
+      if (count > 1 && n > first)
+      {
+        memcpy(g_sink + first, vec[1].iov_base, n - first);
+      }
+      buf.retrieve(n);
+    }
+  }
+  return timeDifference(Timestamp::now(), start);
+}
+
+void drain(int fd, size_t totalBytes)
+{
+  std::vector<char> buf(64 * 1024);
+  size_t received = 0;
+  while (received < totalBytes)
+  {
+    ssize_t n = ::read(fd, &buf[0], buf.size());
+    if (n <= 0)
+    {
+      break;
+    }
+    received += n;
+  }
+}
+
+void waitWritable(int fd)
+{
+  struct pollfd pfd = { fd, POLLOUT, 0 };
+  ::poll(&pfd, 1, -1);
+}
+
+// streams totalBytes through a socketpair, keeping up to backlog bytes queued
+template <typename BUFFER>
+double benchSocket(size_t totalBytes, size_t backlog, ssize_t (*flush)(BUFFER*, int))
+{
+  int fds[2];
+  if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+  {
+    perror("socketpair");
+    return 0;
+  }
+  ::fcntl(fds[0], F_SETFL, O_NONBLOCK);
+  Thread reader(boost::bind(drain, fds[1], totalBytes), "reader");
+  reader.start();
+
+  std::string chunk(kChunk, 'x');
+  BUFFER buf;
+  size_t produced = 0;
+  Timestamp start(Timestamp::now());
+  while (produced < totalBytes || buf.readableBytes() > 0)
+  {
+    if (produced < totalBytes && buf.readableBytes() < backlog)
+    {
+      buf.append(chunk.data(), chunk.size());
+      produced += chunk.size();
+    }
+    if (flush(&buf, fds[0]) < 0)
+    {
+      if (errno != EAGAIN)
+      {
+        perror("write");
+        break;
+      }
+      if (buf.readableBytes() >= backlog || produced >= totalBytes)
+      {
+        waitWritable(fds[0]);
+      }
+    }
+  }
+  reader.join();
+  double seconds = timeDifference(Timestamp::now(), start);
+  ::close(fds[0]);
+  ::close(fds[1]);
+  return seconds;
+}
+
+ssize_t flushBuffer(Buffer* buf, int fd)
+{
+  ssize_t n = ::write(fd, buf->peek(), buf->readableBytes());
+  if (n > 0)
+  {
+    buf->retrieve(n);
+  }
+  return n;
+}
+
+ssize_t flushRing(RingBuffer* buf, int fd)
+{
+  int savedErrno = 0;
+  ssize_t n = buf->writeFd(fd, &savedErrno);
+  errno = savedErrno;
+  return n;
+}
+
+int main(int argc, char* argv[])
+{
+  size_t totalMB = argc > 1 ? atoi(argv[1]) : 2048;
+  size_t totalBytes = totalMB * 1024 * 1024;
+  const size_t backlogs[] = { 64 * 1024, 256 * 1024, 1024 * 1024, 4 * 1024 * 1024 };
+
+  printf("in-memory streaming, %zu MB\n", totalMB);
+  printf("%10s %14s %14s\n", "backlog", "Buffer MB/s", "RingBuffer MB/s");
+  for (size_t i = 0; i < sizeof backlogs / sizeof backlogs[0]; ++i)
+  {
+    double b = benchBuffer(totalBytes, backlogs[i]);
+    double r = benchRing(totalBytes, backlogs[i]);
+    printf("%9zuK %14.0f %14.0f\n", backlogs[i] / 1024, totalMB / b, totalMB / r);
+  }
+
+  size_t socketMB = totalMB / 4;
+  printf("socketpair streaming, %zu MB\n", socketMB);
+  printf("%10s %14s %14s\n", "backlog", "Buffer MB/s", "RingBuffer MB/s");
+  for (size_t i = 0; i < sizeof backlogs / sizeof backlogs[0]; ++i)
+  {
+    double b = benchSocket<Buffer>(socketMB * 1024 * 1024, backlogs[i], flushBuffer);
+    double r = benchSocket<RingBuffer>(socketMB * 1024 * 1024, backlogs[i], flushRing);
+    printf("%9zuK %14.0f %14.0f\n", backlogs[i] / 1024, socketMB / b, socketMB / r);
+  }
+}
@@ -0,0 +1,146 @@
+// Connect/close churn against a TcpServer, like short-lived HTTP/1.0 clients:
+// each client thread connects, closes right away (RST, so no TIME_WAIT piles
+// up) and waits until the server has torn the connection down.
+// Reports connections per second and operator new calls per connection.
+//
+// usage: ConnectionChurn_bench [numIoThreads] [numClients] [connectionsPerClient]
+
+#include "../../base/Atomic.h"
+#include "../../base/Thread.h"
+#include "../../base/Timestamp.h"
+#include "../../reactor/EventLoop.h"
+#include "../../reactor/InetAddress.h"
+#include "../../reactor/TcpServer.h"
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+const uint16_t kPort = 2009;
+
+AtomicInt64 g_news;
+AtomicInt32 g_live;
+AtomicInt64 g_closed;
+
+void* operator new(size_t size)
+{
+  g_news.increment();
+  void* p = ::malloc(size ? size : 1);
+  if (p == NULL)
+  {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept
+{
+  ::free(p);
+}
+
+void onConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    g_live.increment();
+  }
+  else
+  {
+    g_live.decrement();
+    g_closed.increment();
+  }
+}
+
+void onMessage(const TcpConnectionPtr&, Buffer* buf, Timestamp)
+{
+  buf->retrieveAll();
+}
+
+void churn(int connections)
+{
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(kPort);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  struct linger lg = { 1, 0 };
+  for (int i = 0; i < connections; ++i)
+  {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr) < 0)
+    {
+      perror("connect");
+      ::close(fd);
+      continue;
+    }
+    ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof lg);
+    ::close(fd);
+  }
+}
+
+void waitClosed(int64_t expected)
+{
+  while (g_closed.get() < expected)
+  {
+    ::usleep(1000);
+  }
+}
+
+void runBench(EventLoop* loop, int numClients, int perClient)
+{
+  ::sleep(1);
+  // warm up the pools and the server's threads
+  churn(1000);
+  waitClosed(1000);
+
+  int64_t newsBefore = g_news.get();
+  int64_t closedBefore = g_closed.get();
+  Timestamp start(Timestamp::now());
+  boost::ptr_vector<Thread> clients;
+  for (int i = 0; i < numClients; ++i)
+  {
+    clients.push_back(new Thread(boost::bind(churn, perClient), "client"));
+    clients.back().start();
+  }
+  for (int i = 0; i < numClients; ++i)
+  {
+    clients[i].join();
+  }
+  int64_t total = static_cast<int64_t>(numClients) * perClient;
+  waitClosed(closedBefore + total);
+  double seconds = timeDifference(Timestamp::now(), start);
+  int64_t news = g_news.get() - newsBefore;
+
+  printf("%lld connections in %.3f s, %.0f conn/s, %.2f operator new per connection\n",
+         static_cast<long long>(total), seconds, total / seconds,
+         static_cast<double>(news) / total);
+  loop->quit();
+}
+
+int main(int argc, char* argv[])
+{
+  int numThreads = argc > 1 ? atoi(argv[1]) : 2;
+  int numClients = argc > 2 ? atoi(argv[2]) : 4;
+  int perClient = argc > 3 ? atoi(argv[3]) : 10000;
+
+  EventLoop loop;
+  TcpServer server(&loop, InetAddress(kPort));
+  server.setConnectionCallback(onConnection);
+  server.setMessageCallback(onMessage);
+  server.setThreadNum(numThreads);
+  server.start();
+
+  Thread bench(boost::bind(runBench, &loop, numClients, perClient), "bench");
+  bench.start();
+  loop.loop();
+  bench.join();
+}
@@ -0,0 +1,216 @@
+// Callback dispatch cost of the reactor:
+// 1. Channel::handleEvent() on a readable+writable channel, against the same
+//    dispatch through boost::function as Channel did before;
+// 2. building a Functor from typical boost::bind expressions, moving it into
+//    a pending vector and calling it, against boost::function;
+// 3. queueInLoop() from another thread, functors per second.
+// Reports nanoseconds per call and operator new calls per functor.
+//
+// usage: Dispatch_bench [iterations]
+
+#include "../../base/Atomic.h"
+#include "../../base/Thread.h"
+#include "../../base/Timestamp.h"
+#include "../../reactor/Channel.h"
+#include "../../reactor/EventLoop.h"
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/make_shared.hpp>
+
+#include <new>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <vector>
+
+AtomicInt64 g_news;
+
+void* operator new(size_t size)
+{
+  g_news.increment();
+  void* p = ::malloc(size ? size : 1);
+  if (p == NULL)
+  {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept
+{
+  ::free(p);
+}
+
+struct Handler
+{
+  Handler() : reads(0), writes(0) { }
+  void onRead(Timestamp) { ++reads; }
+  void onWrite() { ++writes; }
+  void run() { ++reads; }
+  void runArgs(int a, int b) { reads += a + b; }
+  void runString(const std::string& s) { reads += s.size(); }
+
+  int64_t reads;
+  int64_t writes;
+};
+
+typedef boost::shared_ptr<Handler> HandlerPtr;
+
+// Channel::handleEvent() as it was with boost::function callbacks
+struct LegacyChannel
+{
+  boost::function<void(Timestamp)> readCallback;
+  boost::function<void()> writeCallback;
+  boost::function<void()> errorCallback;
+  boost::function<void()> closeCallback;
+  int revents;
+  bool eventHandling;
+
+  __attribute__((noinline)) void handleEvent(Timestamp receiveTime)
+  {
+    eventHandling = true;
+    if (revents & POLLNVAL) {
+      puts("POLLNVAL");
+    }
+    if ((revents & POLLHUP) && !(revents & POLLIN)) {
+      if (closeCallback) closeCallback();
+    }
+    if (revents & (POLLERR | POLLNVAL)) {
+      if (errorCallback) errorCallback();
+    }
+    if (revents & (POLLIN | POLLPRI | POLLRDHUP)) {
+      if (readCallback) readCallback(receiveTime);
+    }
+    if (revents & POLLOUT) {
+      if (writeCallback) writeCallback();
+    }
+    eventHandling = false;
+  }
+};
+
+void benchHandleEvent(int iterations)
+{
+  EventLoop loop;
+  int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  Handler handler;
+  Timestamp now(Timestamp::now());
+
+  Channel channel(&loop, fd);
+  channel.setReadCallback(boost::bind(&Handler::onRead, &handler, _1));
+  channel.setWriteCallback(boost::bind(&Handler::onWrite, &handler));
+  channel.set_revents(POLLIN | POLLOUT);
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < iterations; ++i)
+  {
+    channel.handleEvent(now);
+  }
+  double seconds = timeDifference(Timestamp::now(), start);
+
+  LegacyChannel legacy;
+  legacy.readCallback = boost::bind(&Handler::onRead, &handler, _1);
+  legacy.writeCallback = boost::bind(&Handler::onWrite, &handler);
+  legacy.revents = POLLIN | POLLOUT;
+  start = Timestamp::now();
+  for (int i = 0; i < iterations; ++i)
+  {
+    legacy.handleEvent(now);
+  }
+  double legacySeconds = timeDifference(Timestamp::now(), start);
+
+  printf("Channel::handleEvent   Function %6.2f ns  boost::function %6.2f ns\n",
+         seconds * 1e9 / iterations, legacySeconds * 1e9 / iterations);
+  ::close(fd);
+}
+
+// builds, queues and runs functors the way queueInLoop() and doPendingFunctors() do
+template<typename Functor, typename Bind>
+void queueAndRun(int iterations, const Bind& bind, double* nanoseconds, double* news)
+{
+  std::vector<Functor> pending;
+  std::vector<Functor> calling;
+  pending.reserve(64);
+  calling.reserve(64);
+  int64_t newsBefore = g_news.get();
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < iterations; i += 64)
+  {
+    for (int j = 0; j < 64; ++j)
+    {
+      pending.push_back(Functor(bind));
+    }
+    calling.swap(pending);
+    for (size_t j = 0; j < calling.size(); ++j)
+    {
+      calling[j]();
+    }
+    calling.clear();
+  }
+  *nanoseconds = timeDifference(Timestamp::now(), start) * 1e9 / iterations;
+  *news = static_cast<double>(g_news.get() - newsBefore) / iterations;
+}
+
+template<typename Bind>
+void benchFunctor(const char* name, int iterations, const Bind& bind)
+{
+  double ns, news, legacyNs, legacyNews;
+  queueAndRun<EventLoop::Functor>(iterations, bind, &ns, &news);
+  queueAndRun<boost::function<void()> >(iterations, bind, &legacyNs, &legacyNews);
+  printf("%-22s Function %6.2f ns %4.2f new  boost::function %6.2f ns %4.2f new  (%zu bytes)\n",
+         name, ns, news, legacyNs, legacyNews, sizeof(Bind));
+}
+
+AtomicInt64 g_done;
+
+void countDone(EventLoop* loop, int64_t total)
+{
+  if (g_done.incrementAndGet() == total)
+  {
+    loop->quit();
+  }
+}
+
+void produce(EventLoop* loop, const HandlerPtr& handler, int iterations)
+{
+  for (int i = 0; i < iterations; ++i)
+  {
+    loop->queueInLoop(boost::bind(&Handler::runArgs, handler, i, 1));
+  }
+  loop->queueInLoop(boost::bind(&countDone, loop, 1));
+}
+
+void benchQueueInLoop(int iterations)
+{
+  EventLoop loop;
+  HandlerPtr handler(boost::make_shared<Handler>());
+  g_done.getAndSet(0);
+  Thread producer(boost::bind(&produce, &loop, handler, iterations), "producer");
+  int64_t newsBefore = g_news.get();
+  Timestamp start(Timestamp::now());
+  producer.start();
+  loop.loop();
+  double seconds = timeDifference(Timestamp::now(), start);
+  producer.join();
+  printf("queueInLoop cross-thread %.0f functors/s %6.2f ns %4.2f new per functor\n",
+         iterations / seconds, seconds * 1e9 / iterations,
+         static_cast<double>(g_news.get() - newsBefore) / iterations);
+}
+
+int main(int argc, char* argv[])
+{
+  int iterations = argc > 1 ? atoi(argv[1]) : 10 * 1000 * 1000;
+  benchHandleEvent(iterations);
+
+  Handler handler;
+  HandlerPtr shared(boost::make_shared<Handler>());
+  benchFunctor("bind(this)", iterations, boost::bind(&Handler::run, &handler));
+  benchFunctor("bind(shared_ptr)", iterations, boost::bind(&Handler::run, shared));
+  benchFunctor("bind(shared_ptr,a,b)", iterations, boost::bind(&Handler::runArgs, shared, 1, 2));
+  benchFunctor("bind(this,string)", iterations,
+               boost::bind(&Handler::runString, &handler, std::string("message")));
+
+  benchQueueInLoop(iterations / 10);
+}
@@ -0,0 +1,130 @@
+// Per-event cost of EPoller with many registered fds:
+// numFds eventfd channels are registered for reading, numReady of them are
+// kept readable (level triggered, never drained), and the loop dispatches
+// their events until numEvents have been handled. A second pass toggles
+// EPOLLOUT on every ready channel, so each event also goes through
+// updateChannel(). Reports nanoseconds per event of the whole loop iteration.
+// The open files limit is raised to numFds if the hard limit allows it.
+//
+// usage: EPoller_bench [numFds [numReady [numEvents]]]
+
+#include "../../base/Timestamp.h"
+#include "../../reactor/Channel.h"
+#include "../../reactor/EventLoop.h"
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <vector>
+
+EventLoop* g_loop;
+int64_t g_events;
+int64_t g_numEvents;
+bool g_toggle;
+
+void onRead(Channel* channel, Timestamp)
+{
+  if (g_toggle)
+  {
+    if (channel->isWriting())
+    {
+      channel->disableWriting();
+    }
+    else
+    {
+      channel->enableWriting();
+    }
+  }
+  if (++g_events == g_numEvents)
+  {
+    g_loop->quit();
+  }
+}
+
+int raiseFdLimit(int wanted)
+{
+  struct rlimit rl;
+  ::getrlimit(RLIMIT_NOFILE, &rl);
+  if (rl.rlim_cur < static_cast<rlim_t>(wanted))
+  {
+    rl.rlim_cur = rl.rlim_max = wanted;
+    if (::setrlimit(RLIMIT_NOFILE, &rl) < 0)
+    {
+      ::getrlimit(RLIMIT_NOFILE, &rl);
+      rl.rlim_cur = rl.rlim_max;
+      ::setrlimit(RLIMIT_NOFILE, &rl);
+    }
+  }
+  return static_cast<int>(rl.rlim_cur);
+}
+
+double run(EventLoop* loop, bool toggle, int64_t numEvents)
+{
+  g_events = 0;
+  g_numEvents = numEvents;
+  g_toggle = toggle;
+  Timestamp start(Timestamp::now());
+  loop->loop();
+  return timeDifference(Timestamp::now(), start) * 1e9 / numEvents;
+}
+
+int main(int argc, char* argv[])
+{
+  int numFds = argc > 1 ? atoi(argv[1]) : 100000;
+  int numReady = argc > 2 ? atoi(argv[2]) : 1000;
+  int64_t numEvents = argc > 3 ? atoll(argv[3]) : 10 * 1000 * 1000;
+
+  int limit = raiseFdLimit(numFds + 64);
+  if (numFds > limit - 64)
+  {
+    numFds = limit - 64;
+  }
+  if (numReady > numFds)
+  {
+    numReady = numFds;
+  }
+
+  EventLoop loop;
+  g_loop = &loop;
+  std::vector<int> fds;
+  boost::ptr_vector<Channel> channels;
+  for (int i = 0; i < numFds; ++i)
+  {
+    int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd < 0)
+    {
+      perror("eventfd");
+      return 1;
+    }
+    fds.push_back(fd);
+    Channel* channel = new Channel(&loop, fd);
+    channels.push_back(channel);
+    channel->setReadCallback(boost::bind(&onRead, channel, _1));
+    channel->enableReading();
+  }
+  // spread the ready ones over the whole fd range
+  for (int i = 0; i < numReady; ++i)
+  {
+    uint64_t one = 1;
+    ssize_t n = ::write(fds[static_cast<int64_t>(i) * numFds / numReady], &one, sizeof one);
+    (void)n;
+  }
+
+  double dispatch = run(&loop, false, numEvents);
+  double update = run(&loop, true, numEvents);
+  printf("%d fds, %d ready: dispatch %.1f ns/event, with updateChannel %.1f ns/event\n",
+         numFds, numReady, dispatch, update);
+
+  for (size_t i = 0; i < channels.size(); ++i)
+  {
+    channels[i].disableAll();
+    loop.removeChannel(&channels[i]);
+    ::close(fds[i]);
+  }
+}
@@ -2,6 +2,7 @@
 #include "../../reactor/EventLoop.h"
 
 #include <stdio.h>
+#include <strings.h>
 #include <sys/timerfd.h>
 
 EventLoop* g_loop;
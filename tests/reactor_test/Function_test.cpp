@@ -0,0 +1,145 @@
+#include "../../reactor/Function.h"
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <functional>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+// Function何时为空、调用空Function抛出bad_function_call、成员函数指针和大小目标的调用。
+// CHECK记录失败的检查并继续，最后有失败时exit(1)
+
+int g_failures = 0;
+
+void check(bool ok, const char* what, int line)
+{
+  if (!ok)
+  {
+    fprintf(stderr, "Function_test.cpp:%d: %s failed\n", line, what);
+    ++g_failures;
+  }
+}
+
+#define CHECK(exp) check(static_cast<bool>(exp), #exp, __LINE__)
+
+int twice(int x)
+{
+  return 2 * x;
+}
+
+struct Counter
+{
+  Counter() : value(0) { }
+  int add(int n) { value += n; return value; }
+  int value;
+};
+
+// true if calling f throws bad_function_call
+template<typename F>
+bool throwsBadCall(const F& f)
+{
+  try
+  {
+    f(1);
+  }
+  catch (const std::bad_function_call&)
+  {
+    return true;
+  }
+  return false;
+}
+
+void testEmpty()
+{
+  Function<int(int)> f;
+  CHECK(!f);
+  CHECK(throwsBadCall(f));
+  CHECK(!Function<int(int)>(nullptr));
+
+  int (*fp)(int) = NULL;
+  CHECK(!Function<int(int)>(fp));
+  fp = twice;
+  CHECK(Function<int(int)>(fp));
+  CHECK(Function<int(int)>(fp)(3) == 6);
+
+  // an empty wrapper makes an empty Function, so `if (cb)` guards still work
+  boost::function<int(int)> bf;
+  CHECK(!Function<int(int)>(bf));
+  bf = twice;
+  CHECK(Function<int(int)>(bf));
+  CHECK(Function<int(int)>(bf)(4) == 8);
+
+  std::function<int(int)> sf;
+  CHECK(!Function<int(int)>(sf));
+  CHECK(!Function<int(int)>(std::move(sf)));
+  sf = twice;
+  CHECK(Function<int(int)>(sf));
+  CHECK(Function<int(int)>(sf)(5) == 10);
+
+  // an empty Function of another signature
+  Function<long(int)> other;
+  CHECK(!Function<int(int)>(std::move(other)));
+
+  int (Counter::*pm)(int) = NULL;
+  CHECK(!(Function<int(Counter*, int)>(pm)));
+
+  Function<int(int)> assigned = twice;
+  CHECK(assigned);
+  assigned = boost::function<int(int)>();
+  CHECK(!assigned);
+  CHECK(throwsBadCall(assigned));
+}
+
+void testMemberFunction()
+{
+  Counter counter;
+  Function<int(Counter*, int)> byPointer(&Counter::add);
+  CHECK(byPointer);
+  CHECK(byPointer(&counter, 2) == 2);
+
+  Function<int(Counter&, int)> byReference = &Counter::add;
+  CHECK(byReference(counter, 3) == 5);
+
+  boost::shared_ptr<Counter> shared(new Counter);
+  Function<int(const boost::shared_ptr<Counter>&, int)> bySharedPtr(&Counter::add);
+  CHECK(bySharedPtr(shared, 7) == 7);
+  CHECK(counter.value == 5 && shared->value == 7);
+}
+
+void testTargets()
+{
+  // small targets are stored inline, large ones on the heap, both move
+  Counter counter;
+  Function<int(int)> small(boost::bind(&Counter::add, &counter, _1));
+  CHECK(small(1) == 1);
+
+  std::string big(1000, 'x');
+  char padding[Function<int(int)>::kInlineSize * 2] = { 0 };
+  Function<int(int)> large([big, padding](int n) { return static_cast<int>(big.size()) + padding[0] + n; });
+  CHECK(large(1) == 1001);
+
+  Function<int(int)> moved(std::move(large));
+  CHECK(!large);
+  CHECK(moved(2) == 1002);
+  small.swap(moved);
+  CHECK(small(0) == 1000 && moved(1) == 2);
+  moved = nullptr;
+  CHECK(!moved);
+}
+
+int main()
+{
+  testEmpty();
+  testMemberFunction();
+  testTargets();
+
+  if (g_failures > 0)
+  {
+    fprintf(stderr, "%d checks failed\n", g_failures);
+    exit(1);
+  }
+  printf("all passed\n");
+}
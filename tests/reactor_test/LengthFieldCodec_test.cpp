@@ -0,0 +1,193 @@
+#include "../../reactor/LengthFieldCodec.h"
+#include "../../reactor/EventLoop.h"
+#include "../../reactor/InetAddress.h"
+#include "../../reactor/TcpConnection.h"
+
+#include <boost/bind.hpp>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+// LengthFieldCodec在1/2/4/8字节长度字段下的编码和往返：一帧分几次读到、一次读到多帧、
+// 超长的长度字段使连接关闭。CHECK记录失败的检查并继续，最后有失败时exit(1)
+
+int g_failures = 0;
+
+void check(bool ok, const char* what, int line)
+{
+  if (!ok)
+  {
+    fprintf(stderr, "LengthFieldCodec_test.cpp:%d: %s failed\n", line, what);
+    ++g_failures;
+  }
+}
+
+#define CHECK(exp) check((exp), #exp, __LINE__)
+
+// one codec on one end of a socketpair, the test writes to the other end
+struct Session
+{
+  explicit Session(int lengthFieldBytes)
+    : codec(boost::bind(&Session::onFrame, this, _1, _2, _3),
+            lengthFieldBytes,
+            lengthFieldBytes == 1 ? 200 : 60000),
+      peer(-1)
+  {
+  }
+
+  void onFrame(const TcpConnectionPtr&, const StringPiece& frame, Timestamp)
+  {
+    frames.push_back(frame.as_string());
+  }
+
+  LengthFieldCodec codec;
+  TcpConnectionPtr conn;
+  int peer;
+  string stream;  // the encoded frames, written in pieces
+  vector<string> sent;
+  vector<string> frames;
+};
+
+void onClose(const TcpConnectionPtr&)
+{
+}
+
+void testEncode()
+{
+  const int widths[] = { 1, 2, 4, 8 };
+  for (int i = 0; i < 4; ++i)
+  {
+    LengthFieldCodec codec(nullptr, widths[i]);
+    size_t expected = widths[i] == 1 ? 255 : widths[i] == 2 ? 65535 : 64 * 1024 * 1024;
+    CHECK(codec.maxFrameLength() == expected);
+  }
+
+  // a 300 byte message doesn't fit a 1 byte field: nothing is appended
+  LengthFieldCodec codec(nullptr, 1);
+  Buffer buf;
+  CHECK(!codec.encode(string(300, 'x'), &buf));
+  CHECK(buf.readableBytes() == 0);
+  CHECK(codec.encode(string(255, 'x'), &buf));
+  CHECK(buf.readableBytes() == 256);
+  CHECK(static_cast<uint8_t>(buf.peekInt8()) == 255);
+
+  LengthFieldCodec limited(nullptr, 4, 100);
+  buf.retrieveAll();
+  CHECK(!limited.encode(string(101, 'x'), &buf));
+  CHECK(buf.readableBytes() == 0);
+  CHECK(limited.encode(string(100, 'x'), &buf));
+  CHECK(buf.readableBytes() == 104);
+}
+
+void writePiece(Session* s, size_t offset, size_t len)
+{
+  ssize_t n = ::write(s->peer, s->stream.data() + offset, len);
+  CHECK(n == static_cast<ssize_t>(len));
+}
+
+void finish(vector<Session*>* sessions, EventLoop* loop)
+{
+  for (size_t i = 0; i < sessions->size(); ++i)
+  {
+    Session* s = (*sessions)[i];
+    CHECK(s->frames == s->sent);
+
+    // the oversized length shut the connection down: the peer reads EOF
+    char c;
+    ssize_t n = ::recv(s->peer, &c, 1, MSG_DONTWAIT);
+    CHECK(n == 0);
+
+    s->conn->connectDestroyed();
+    s->conn.reset();
+    ::close(s->peer);
+  }
+  loop->quit();
+}
+
+int main()
+{
+  testEncode();
+
+  EventLoop loop;
+  vector<Session*> sessions;
+  const int widths[] = { 1, 2, 4, 8 };
+  for (int i = 0; i < 4; ++i)
+  {
+    Session* s = new Session(widths[i]);
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+    {
+      perror("socketpair");
+      abort();
+    }
+    s->peer = fds[1];
+    s->conn = TcpConnection::create(&loop, "codec", fds[0], InetAddress(0), InetAddress(0));
+    TcpConnection::Callbacks* cbs = new TcpConnection::Callbacks;
+    cbs->connection = [](const TcpConnectionPtr&) {};
+    cbs->message = boost::bind(&LengthFieldCodec::onMessage, &s->codec, _1, _2, _3);
+    s->conn->setCallbacks(TcpConnection::CallbacksPtr(cbs));
+    s->conn->setCloseCallback(onClose);
+    s->conn->connectEstablished();
+
+    s->sent.push_back("");
+    s->sent.push_back("hello");
+    s->sent.push_back(string(s->codec.maxFrameLength(), 'y'));  // longest allowed
+    for (int j = 0; j < 20; ++j)
+    {
+      s->sent.push_back(string(j + 1, static_cast<char>('a' + j)));
+    }
+    Buffer buf;
+    for (size_t j = 0; j < s->sent.size(); ++j)
+    {
+      CHECK(s->codec.encode(s->sent[j], &buf));
+    }
+    // a length one past the limit, as a peer could send it
+    size_t tooLong = s->codec.maxFrameLength() + 1;
+    for (int j = widths[i] - 1; j >= 0; --j)
+    {
+      buf.appendInt8(static_cast<int8_t>((tooLong >> (8 * j)) & 0xff));
+    }
+    s->stream = buf.retrieveAllAsString();
+    sessions.push_back(s);
+
+    // the first frame header split in two reads, the second frame split
+    // from its header, then all the other frames in one read
+    size_t header = widths[i];  // the first frame, "", is a header only
+    size_t cuts[] = { 1, header, 2 * header, 2 * header + 2 };
+    size_t offset = 0;
+    double delay = 0.01;
+    for (size_t j = 0; j < sizeof cuts / sizeof cuts[0]; ++j)
+    {
+      if (cuts[j] == offset)
+      {
+        continue;  // a 1 byte header can't be split
+      }
+      loop.runAfter(delay, boost::bind(writePiece, s, offset, cuts[j] - offset));
+      offset = cuts[j];
+      delay += 0.01;
+    }
+    // the oversized length goes last, after every valid frame
+    size_t valid = s->stream.size() - header;
+    loop.runAfter(delay, boost::bind(writePiece, s, offset, valid - offset));
+    loop.runAfter(delay + 0.01, boost::bind(writePiece, s, valid, header));
+  }
+  loop.runAfter(0.2, boost::bind(finish, &sessions, &loop));
+  loop.loop();
+
+  for (size_t i = 0; i < sessions.size(); ++i)
+  {
+    delete sessions[i];
+  }
+  if (g_failures > 0)
+  {
+    fprintf(stderr, "%d checks failed\n", g_failures);
+    exit(1);
+  }
+  printf("all passed\n");
+}
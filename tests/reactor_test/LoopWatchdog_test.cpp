@@ -0,0 +1,58 @@
+//这个测试代码用于测试慢回调日志和LoopWatchdog：一个timer、一个functor和一个channel事件各阻塞IO线程一段时间，
+//WebServer.log中应有三条slow日志，阻塞超过阈值的那次还应有被卡住线程的调用栈
+#include "../reactor/EventLoop.h"
+#include "../reactor/LoopWatchdog.h"
+
+#include <boost/bind.hpp>
+
+#include <stdio.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+EventLoop* g_loop;
+int g_eventfd;
+
+void block(const char* what, int ms)
+{
+  printf("%s blocks for %d ms\n", what, ms);
+  ::usleep(ms * 1000);
+}
+
+void onEvent(Timestamp)
+{
+  uint64_t n;
+  ::read(g_eventfd, &n, sizeof n);
+  block("channel", 80);
+}
+
+void stuck()
+{
+  block("timer", 400);
+  g_loop->queueInLoop(boost::bind(block, "functor", 80));
+  uint64_t one = 1;
+  ::write(g_eventfd, &one, sizeof one);
+}
+
+int main()
+{
+  EventLoop::setSlowCallbackThreshold(0.05);
+  LoopWatchdog watchdog(0.2);
+  watchdog.start();
+
+  EventLoop loop;
+  g_loop = &loop;
+  g_eventfd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  Channel channel(&loop, g_eventfd);
+  channel.setReadCallback(onEvent);
+  channel.enableReading();
+
+  loop.runAfter(0.1, stuck);
+  loop.runAfter(1.0, boost::bind(&EventLoop::quit, &loop));
+  loop.loop();
+
+  channel.disableAll();
+  loop.removeChannel(&channel);
+  ::close(g_eventfd);
+  sleep(3);  // for AsyncLogging to flush
+  printf("done, see WebServer.log\n");
+}
@@ -0,0 +1,219 @@
+// Atomic refcount operations on a TcpConnection per request/response,
+// counted by a hardware watchpoint (perf_event_open(2) PERF_TYPE_BREAKPOINT)
+// on the use/weak counts of the connection's shared_ptr control block, in
+// the IO thread. Every atomic increment or decrement is one write there.
+// Modes, each on a keep-alive connection of its own:
+//   reply           the MessageCallback sends the response
+//   defer shared    it queues the reply in the loop, binding TcpConnectionPtr
+//   defer local     it queues the reply in the loop, binding TcpConnection::localPtr()
+//   write complete  as reply, with a WriteCompleteCallback on the server
+//
+// Each counted op also costs the IO thread a debug trap, so the request
+// rates only compare runs of this benchmark.
+//
+// usage: RefCount_bench [numRequests]
+
+#include "../../base/Atomic.h"
+#include "../../base/Thread.h"
+#include "../../base/Timestamp.h"
+#include "../../reactor/EventLoop.h"
+#include "../../reactor/InetAddress.h"
+#include "../../reactor/TcpServer.h"
+
+#include <boost/bind.hpp>
+
+#include <linux/hw_breakpoint.h>
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+const uint16_t kPort = 2013;
+const uint16_t kWriteCompletePort = 2014;
+
+enum Mode { kReply, kDeferShared, kDeferLocal };
+
+const char kRequest[] = "GET /ping HTTP/1.1\r\nHost: localhost\r\n\r\n";
+const std::string kResponse =
+  "HTTP/1.1 200 OK\r\nContent-Length: 4\r\nConnection: Keep-Alive\r\n\r\npong";
+
+AtomicInt32 g_mode;
+AtomicInt32 g_counterFd;
+
+// the control block of a boost::shared_ptr follows the object pointer,
+// its use and weak counts follow the vptr of sp_counted_base
+uintptr_t refCounts(const TcpConnectionPtr& conn)
+{
+  const char* pn = reinterpret_cast<const char*>(&conn) + sizeof(void*);
+  return *reinterpret_cast<const uintptr_t*>(pn) + sizeof(void*);
+}
+
+// counts writes to the refcounts by the calling thread, disabled
+int openCounter(uintptr_t address)
+{
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof attr);
+  attr.type = PERF_TYPE_BREAKPOINT;
+  attr.size = sizeof attr;
+  attr.bp_type = HW_BREAKPOINT_W;
+  attr.bp_addr = address;
+  attr.bp_len = HW_BREAKPOINT_LEN_8;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  int fd = static_cast<int>(::syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+  if (fd < 0)
+  {
+    perror("perf_event_open");
+  }
+  return fd;
+}
+
+void replyShared(const TcpConnectionPtr& conn)
+{
+  conn->send(kResponse);
+}
+
+void replyLocal(const TcpConnectionLocalPtr& conn)
+{
+  conn->send(kResponse);
+}
+
+void onConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    g_counterFd.getAndSet(openCounter(refCounts(conn)));
+  }
+}
+
+void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  while (const char* end = static_cast<const char*>(
+             memmem(buf->peek(), buf->readableBytes(), "\r\n\r\n", 4)))
+  {
+    buf->retrieveUntil(end + 4);
+    switch (g_mode.get())
+    {
+      case kReply:
+        conn->send(kResponse);
+        break;
+      case kDeferShared:
+        conn->getLoop()->queueInLoop(boost::bind(&replyShared, conn));
+        break;
+      case kDeferLocal:
+        conn->getLoop()->queueInLoop(boost::bind(&replyLocal, conn->localPtr()));
+        break;
+    }
+  }
+}
+
+void onWriteComplete(const TcpConnectionPtr&)
+{
+}
+
+bool roundTrip(int fd)
+{
+  if (::write(fd, kRequest, sizeof kRequest - 1) != static_cast<ssize_t>(sizeof kRequest - 1))
+  {
+    return false;
+  }
+  char buf[256];
+  size_t received = 0;
+  while (received < kResponse.size())
+  {
+    ssize_t n = ::read(fd, buf, sizeof buf);
+    if (n <= 0)
+    {
+      return false;
+    }
+    received += n;
+  }
+  return true;
+}
+
+void measure(const char* name, uint16_t port, Mode mode, int numRequests)
+{
+  g_mode.getAndSet(mode);
+  g_counterFd.getAndSet(-2);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr) < 0)
+  {
+    perror("connect");
+    return;
+  }
+  for (int i = 0; i < 1000; ++i)
+  {
+    roundTrip(fd);
+  }
+  int counter = g_counterFd.get();
+  if (counter < 0)
+  {
+    ::close(fd);
+    return;
+  }
+
+  ::ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+  ::ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+  Timestamp start(Timestamp::now());
+  int done = 0;
+  while (done < numRequests && roundTrip(fd))
+  {
+    ++done;
+  }
+  double seconds = timeDifference(Timestamp::now(), start);
+  ::ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+  uint64_t writes = 0;
+  if (::read(counter, &writes, sizeof writes) != sizeof writes)
+  {
+    perror("read counter");
+  }
+  ::close(counter);
+  ::close(fd);
+
+  printf("%-16s %.0f req/s, %.2f atomic refcount ops per request\n",
+         name, done / seconds, static_cast<double>(writes) / done);
+}
+
+void runClient(EventLoop* loop, int numRequests)
+{
+  ::sleep(1);
+  measure("reply", kPort, kReply, numRequests);
+  measure("defer shared", kPort, kDeferShared, numRequests);
+  measure("defer local", kPort, kDeferLocal, numRequests);
+  measure("write complete", kWriteCompletePort, kReply, numRequests);
+  loop->quit();
+}
+
+int main(int argc, char* argv[])
+{
+  int numRequests = argc > 1 ? atoi(argv[1]) : 100000;
+  EventLoop loop;
+  TcpServer server(&loop, InetAddress(kPort));
+  server.setConnectionCallback(onConnection);
+  server.setMessageCallback(onMessage);
+  server.start();
+  TcpServer writeCompleteServer(&loop, InetAddress(kWriteCompletePort));
+  writeCompleteServer.setConnectionCallback(onConnection);
+  writeCompleteServer.setMessageCallback(onMessage);
+  writeCompleteServer.setWriteCompleteCallback(onWriteComplete);
+  writeCompleteServer.start();
+
+  Thread client(boost::bind(runClient, &loop, numRequests), "client");
+  client.start();
+  loop.loop();
+  client.join();
+}